@@ -1,5 +1,8 @@
 #include "application.hpp"
-#include "../renderer/render_system.hpp"
+#include "image_file.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include "../graphics/model_loader.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -7,109 +10,426 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+// std
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
 namespace GameEngine
 {
   namespace Core
   {
 
-    Application::Application() { loadGameObjects(); }
+    Application::Application(const ApplicationConfig& config)
+        : config{config},
+          vulkanWindow{config.headless ? nullptr
+                                       : std::make_unique<Platform::VulkanWindow>(WIDTH, HEIGHT, "GhostEngine Window")}
+    {
+      if(vulkanWindow)
+        {
+          renderer = std::make_unique<Renderer::Renderer>(*vulkanWindow, vulkanDevice, config.presentation);
+        }
+      else
+        {
+          // Only pay for the extra copy per frame when the last frame is actually going to be looked at
+          bool enableReadback = !config.capturePath.empty() || !config.goldenPath.empty();
+          renderer = std::make_unique<Renderer::Renderer>(vulkanDevice, VkExtent2D{WIDTH, HEIGHT}, enableReadback,
+                                                          config.presentation);
+        }
+
+      loadEntities();
+    }
     Application::~Application() {}
 
     void Application::run()
+    {
+      reportMemoryStats();
+
+      if(config.headless) { runHeadless(); }
+      else { runWindowed(); }
+
+      if(!config.tracePath.empty()) { dumpTrace(config.tracePath); }
+    }
+
+    void Application::renderFrame(RenderSystem& renderSystem)
+    {
+      PROFILE_SCOPE("Application::frame");
+
+      updateEntities();
+
+      // Begin fram function will return a nullptr if swapchain needs to be created
+      if(auto commandBuffer = renderer->beginFrame())
+        {
+          // No camera yet: the shader writes model space straight to clip space, so the frustum is the clip volume.
+          // Culled before the pass begins, GPU culling records its compute dispatch outside of it
+          renderSystem.cullEntities(*renderer, registry, transformSystem, glm::mat4{1.0f});
+          renderer->beginSwapChainRenderPass(commandBuffer);
+          renderSystem.renderEntities(*renderer);
+          renderer->endSwapChainRenderPass(commandBuffer);
+          renderer->endFrame();
+        }
+
+      Profiler::get().endFrame();
+    }
+
+    void Application::runWindowed()
     {
       // Initalize renderSystem
-      RenderSystem renderSystem{vulkanDevice, renderer.getSwapChainRenderPass()};
+      RenderSystem renderSystem{vulkanDevice, pipelineLibrary, renderer->getSwapChainRenderPass(),
+                                renderer->getSwapChainRenderPassFormats(), config.gpuCulling, config.vertexFormat};
+      renderer->setRenderPassChangedCallback([&renderSystem](VkRenderPass renderPass,
+                                                             Graphics::RenderPassFormats renderPassFormats)
+                                             { renderSystem.setRenderPass(renderPass, renderPassFormats); });
+      reportPipelineStats();
+      reportPresentation();
+
+      auto lastStatsReport = std::chrono::steady_clock::now();
+      bool traceKeyWasDown = false;
 
-      while(!Application::vulkanWindow.shouldClose())
+      while(!vulkanWindow->shouldClose())
         {
-          // while window dows not close, poll events
-          glfwPollEvents();
+          // Hold the frame back before polling, so input is as fresh as possible when the frame is recorded
+          frameLimiter.wait();
+
+          // while window dows not close, poll events. Nothing is drawn while minimized, so sleep on the event
+          // queue instead of spinning, the entities still update a few times a second
+          if(vulkanWindow->isMinimized()) { glfwWaitEventsTimeout(MINIMIZED_WAIT_SECONDS); }
+          else { glfwPollEvents(); }
+          renderer->markInputSampled();
+
+          // Dump the trace on the key press, not every frame the key is held
+          bool traceKeyDown = glfwGetKey(vulkanWindow->getNativeHandle(), GLFW_KEY_F12) == GLFW_PRESS;
+          if(traceKeyDown && !traceKeyWasDown)
+            {
+              dumpTrace(config.tracePath.empty() ? DEFAULT_TRACE_PATH : config.tracePath);
+            }
+          traceKeyWasDown = traceKeyDown;
 
-          // Begin fram function will return a nullptr if swapchain needs to be created
-          if(auto commandBuffer = renderer.beginFrame())
+          renderFrame(renderSystem);
+
+          // No per frame vkDeviceWaitIdle: the swap chain's frame slots pace the CPU at most MAX_FRAMES_IN_FLIGHT
+          // frames ahead and resources that die mid-frame go through Renderer::deferRelease
+          auto now = std::chrono::steady_clock::now();
+          if(now - lastStatsReport >= STATS_REPORT_INTERVAL)
             {
-              renderer.beginSwapChainRenderPass(commandBuffer);
-              renderSystem.renderGameObjects(commandBuffer, gameObjects);
-              renderer.endSwapChainRenderPass(commandBuffer);
-              renderer.endFrame();
+              reportFrameStats(renderer->consumeFrameStats());
+              reportPacingStats();
+              reportPassStats();
+              reportCullingStats(renderSystem);
+              reportPipelineLibraryStats();
+              reportJobStats();
+              lastStatsReport = now;
             }
+        }
+
+      // Block CPU until GPU operations have completed so the render system's descriptors can be destroyed safely.
+      // Meshes, buffers and pipelines would be fine without it, they go through the device's DeletionQueue
+      vkDeviceWaitIdle(vulkanDevice.device());
+      renderer->setRenderPassChangedCallback(nullptr);
+    }
+
+    void Application::runHeadless()
+    {
+      RenderSystem renderSystem{vulkanDevice, pipelineLibrary, renderer->getSwapChainRenderPass(),
+                                renderer->getSwapChainRenderPassFormats(), config.gpuCulling, config.vertexFormat};
+      reportPipelineStats();
+
+      std::cout << "headless: rendering " << config.frameCount << " frames at " << WIDTH << "x" << HEIGHT << std::endl;
+
+      auto start = std::chrono::steady_clock::now();
+      for(uint32_t frame = 0; frame < config.frameCount; frame++)
+        {
+          frameLimiter.wait();
+          renderFrame(renderSystem);
+        }
+      vkDeviceWaitIdle(vulkanDevice.device());
+      double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      // Fixed length run, so report the whole thing once instead of every STATS_REPORT_INTERVAL
+      reportFrameStats(renderer->consumeFrameStats());
+      reportPacingStats();
+      reportPassStats();
+      reportCullingStats(renderSystem);
+      reportPipelineLibraryStats();
+      reportJobStats();
+      std::cout << std::fixed << std::setprecision(2) << "headless benchmark: " << config.frameCount << " frames in "
+                << totalSeconds << " s | " << (totalSeconds > 0.0 ? config.frameCount / totalSeconds : 0.0) << " fps"
+                << std::endl;
+
+      checkHeadlessOutput();
+    }
+
+    void Application::checkHeadlessOutput()
+    {
+      if(config.capturePath.empty() && config.goldenPath.empty()) { return; }
+
+      std::vector<uint8_t> rgba;
+      if(!renderer->readbackLastFrame(rgba)) { throw std::runtime_error("no headless frame available to read back!"); }
+
+      VkExtent2D extent = renderer->getExtent();
+      Image frame = imageFromRGBA(extent.width, extent.height, rgba);
+
+      if(!config.capturePath.empty())
+        {
+          writePPM(config.capturePath, frame);
+          std::cout << "captured last frame to " << config.capturePath << std::endl;
+        }
+
+      if(!config.goldenPath.empty())
+        {
+          Image golden = readPPM(config.goldenPath);
+          uint64_t mismatched = countMismatchedPixels(frame, golden, config.goldenTolerance);
+          if(mismatched > 0)
+            {
+              throw std::runtime_error("golden image mismatch against " + config.goldenPath + ": " +
+                                       std::to_string(mismatched) + " pixels differ");
+            }
+          std::cout << "golden image match: " << config.goldenPath << std::endl;
+        }
+    }
+
+    void Application::reportFrameStats(const Renderer::FrameStats& stats)
+    {
+      if(stats.frameCount == 0) { return; }
+
+      std::cout << std::fixed << std::setprecision(2) << "frames: " << stats.frameCount
+                << " | frame: " << stats.avgFrameMs << " ms | cpu: " << stats.avgCpuMs
+                << " ms | gpu wait: " << stats.avgFenceWaitMs << " ms | cpu/gpu overlap: "
+                << stats.overlapRatio * 100.0f << "%" << std::endl;
+      if(stats.maxInputLatencyMs > 0.0)
+        {
+          std::cout << "  input to present: " << stats.avgInputLatencyMs << " ms avg, " << stats.maxInputLatencyMs
+                    << " ms max" << std::endl;
+        }
+    }
+
+    void Application::reportPresentation()
+    {
+      std::cout << "present: " << Graphics::presentModeName(renderer->getPresentMode()) << " | "
+                << renderer->getImageCount() << " images | " << renderer->getFramesInFlight() << " frames in flight | ";
+      if(frameLimiter.isEnabled()) { std::cout << "cap " << frameLimiter.getFrameRateCap() << " fps" << std::endl; }
+      else { std::cout << "no cap" << std::endl; }
+    }
+
+    void Application::reportPacingStats()
+    {
+      if(!frameLimiter.isEnabled()) { return; }
 
-          // Block CPU until GPU operations have completed
-          // This way we know its save to clean up resources knowing they are no longer in use
-          vkDeviceWaitIdle(vulkanDevice.device());
+      auto stats = frameLimiter.consumeStats();
+      std::cout << std::fixed << std::setprecision(2) << "  pacing: " << stats.avgWaitMs << " ms held back per frame, "
+                << stats.lateFrames << " / " << stats.frames << " frames late" << std::endl;
+    }
+
+    void Application::reportCullingStats(const RenderSystem& renderSystem)
+    {
+      std::cout << "  culling (" << (renderSystem.isGpuCulling() ? "gpu" : "cpu") << "): "
+                << renderSystem.getLastVisibleCount() << " / " << renderSystem.getLastCandidateCount()
+                << " entities visible, " << renderSystem.getLastDrawCount() << " draws, "
+                << renderSystem.getLastTriangleCount() << " / " << renderSystem.getLastFullTriangleCount()
+                << " triangles after LOD selection" << std::endl;
+
+      // Every mesh shares the render system's format, so the float32 figure scales by the stride ratio alone
+      double vertexMegabytes = renderSystem.getLastVertexBytes() / (1024.0 * 1024.0);
+      std::cout << std::fixed << std::setprecision(2) << "  vertex fetch: " << vertexMegabytes << " MB/frame ("
+                << Graphics::vertexFormatName(renderSystem.getVertexFormat()) << "), "
+                << vertexMegabytes * Graphics::vertexFormatStride(Graphics::VertexFormat::Float32) /
+                     Graphics::vertexFormatStride(renderSystem.getVertexFormat())
+                << " MB/frame as float32" << std::endl;
+    }
+
+    void Application::reportJobStats()
+    {
+      // Busy share of each thread since the last report, the last entry is the main thread's time inside jobs
+      auto stats = JobSystem::get().consumeStats();
+      std::cout << std::fixed << std::setprecision(0) << "  jobs:";
+      for(size_t i = 0; i < stats.size(); i++)
+        {
+          std::cout << " " << (i + 1 == stats.size() ? "main" : "w" + std::to_string(i)) << " "
+                    << stats[i].utilization * 100.0 << "% (" << stats[i].jobs << ")";
+        }
+      std::cout << std::endl;
+    }
+
+    void Application::reportPassStats()
+    {
+      // Rolling window over the last Profiler::STATS_WINDOW frames, each sample is one frame's total for the pass
+      for(const auto& pass : Profiler::get().getPassStats())
+        {
+          std::cout << std::fixed << std::setprecision(3) << "  " << (pass.gpu ? "gpu " : "cpu ") << std::left
+                    << std::setw(36) << pass.name << std::right << " min " << pass.minMs << " ms | avg " << pass.avgMs
+                    << " ms | p99 " << pass.p99Ms << " ms" << std::endl;
+        }
+    }
+
+    void Application::reportMemoryStats()
+    {
+      auto& allocator = vulkanDevice.memoryAllocator();
+      std::cout << "device memory: " << allocator.getDeviceAllocationCount() << " vkAllocateMemory calls (limit "
+                << vulkanDevice.properties.limits.maxMemoryAllocationCount << ")" << std::endl;
+
+      constexpr double MB = 1024.0 * 1024.0;
+      for(const auto& heap : allocator.getHeapStats())
+        {
+          if(heap.reservedBytes == 0) { continue; }
+
+          std::cout << std::fixed << std::setprecision(2) << "  heap " << heap.heapIndex
+                    << (heap.deviceLocal ? " (device local)" : " (host)") << ": " << heap.reservedBytes / MB
+                    << " MB reserved in " << heap.blockCount << " blocks + " << heap.dedicatedCount
+                    << " dedicated | " << heap.allocationCount << " allocations | " << heap.requestedBytes / MB
+                    << " MB requested, " << heap.usedBytes / MB << " MB used | fragmentation "
+                    << heap.fragmentation * 100.0f << "%" << std::endl;
         }
     }
 
+    void Application::reportPipelineStats()
+    {
+      // Every pipeline exists once the render systems are built, so this is the startup cost of pipeline creation
+      auto stats = vulkanDevice.pipelineCache().getStats();
+      std::cout << std::fixed << std::setprecision(2) << "pipelines: " << stats.pipelinesCreated << " created in "
+                << stats.creationMs << " ms | cache hits: ";
+      if(stats.cacheHitsKnown) { std::cout << stats.cacheHits << " / " << stats.pipelinesCreated; }
+      else { std::cout << "unknown (no creation feedback)"; }
+      std::cout << " | cache file: " << (stats.loadedBytes > 0 ? "loaded" : "cold") << std::endl;
+
+      auto shaders = vulkanDevice.shaderRegistry().getStats();
+      std::cout << "  shader modules: " << shaders.modulesCreated << " created for " << shaders.loads << " loads, "
+                << shaders.liveModules << " held" << std::endl;
+    }
+
+    void Application::reportPipelineLibraryStats()
+    {
+      auto stats = pipelineLibrary.getStats();
+      std::cout << "  pipelines: " << stats.ready << " ready, " << stats.compiling << " compiling, " << stats.failed
+                << " failed | stalls avoided: " << stats.stallsAvoided << std::endl;
+    }
+
+    void Application::dumpTrace(const std::string& filepath)
+    {
+      Profiler::get().writeChromeTrace(filepath);
+      std::cout << "wrote trace to " << filepath << " (open in chrome://tracing or ui.perfetto.dev)" << std::endl;
+    }
+
     // temporary helper function, creates a 1x1x1 cube centered at offset
-    std::unique_ptr<Graphics::Mesh> createCubeModel(Graphics::VulkanDevice& device, glm::vec3 offset)
+    std::unique_ptr<Graphics::Mesh> createCubeModel(Graphics::VulkanDevice& device, glm::vec3 offset,
+                                                    Graphics::VertexFormat format)
     {
-      std::vector<Graphics::Mesh::Vertex> vertices{
+      Graphics::Mesh::Builder builder{};
 
+      // 4 unique corners per face, faces can't share corners because their colors differ
+      builder.vertices = {
         // left face (white)
         {{-.5f, -.5f, -.5f}, {.9f, .9f, .9f}},
         {{-.5f, .5f, .5f}, {.9f, .9f, .9f}},
         {{-.5f, -.5f, .5f}, {.9f, .9f, .9f}},
-        {{-.5f, -.5f, -.5f}, {.9f, .9f, .9f}},
         {{-.5f, .5f, -.5f}, {.9f, .9f, .9f}},
-        {{-.5f, .5f, .5f}, {.9f, .9f, .9f}},
 
         // right face (yellow)
         {{.5f, -.5f, -.5f}, {.8f, .8f, .1f}},
         {{.5f, .5f, .5f}, {.8f, .8f, .1f}},
         {{.5f, -.5f, .5f}, {.8f, .8f, .1f}},
-        {{.5f, -.5f, -.5f}, {.8f, .8f, .1f}},
         {{.5f, .5f, -.5f}, {.8f, .8f, .1f}},
-        {{.5f, .5f, .5f}, {.8f, .8f, .1f}},
 
         // top face (orange, remember y axis points down)
         {{-.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
         {{.5f, -.5f, .5f}, {.9f, .6f, .1f}},
         {{-.5f, -.5f, .5f}, {.9f, .6f, .1f}},
-        {{-.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
         {{.5f, -.5f, -.5f}, {.9f, .6f, .1f}},
-        {{.5f, -.5f, .5f}, {.9f, .6f, .1f}},
 
         // bottom face (red)
         {{-.5f, .5f, -.5f}, {.8f, .1f, .1f}},
         {{.5f, .5f, .5f}, {.8f, .1f, .1f}},
         {{-.5f, .5f, .5f}, {.8f, .1f, .1f}},
-        {{-.5f, .5f, -.5f}, {.8f, .1f, .1f}},
         {{.5f, .5f, -.5f}, {.8f, .1f, .1f}},
-        {{.5f, .5f, .5f}, {.8f, .1f, .1f}},
 
         // nose face (blue)
         {{-.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
         {{.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
         {{-.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
-        {{-.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
         {{.5f, -.5f, 0.5f}, {.1f, .1f, .8f}},
-        {{.5f, .5f, 0.5f}, {.1f, .1f, .8f}},
 
         // tail face (green)
         {{-.5f, -.5f, -0.5f}, {.1f, .8f, .1f}},
         {{.5f, .5f, -0.5f}, {.1f, .8f, .1f}},
         {{-.5f, .5f, -0.5f}, {.1f, .8f, .1f}},
-        {{-.5f, -.5f, -0.5f}, {.1f, .8f, .1f}},
         {{.5f, -.5f, -0.5f}, {.1f, .8f, .1f}},
-        {{.5f, .5f, -0.5f}, {.1f, .8f, .1f}},
-
       };
-      for(auto& v : vertices) { v.position += offset; }
-      return std::make_unique<Graphics::Mesh>(device, vertices);
+      for(auto& v : builder.vertices) { v.position += offset; }
+
+      // Same two triangles per face as the old 36 vertex list: (0, 1, 2) and (0, 3, 1)
+      builder.indices = {0,  1,  2,  0,  3,  1,  4,  5,  6,  4,  7,  5,  8,  9,  10, 8,  11, 9,
+                         12, 13, 14, 12, 15, 13, 16, 17, 18, 16, 19, 17, 20, 21, 22, 20, 23, 21};
+
+      return std::make_unique<Graphics::Mesh>(device, builder, format);
     }
 
-    void Application::loadGameObjects()
+    std::unique_ptr<Graphics::Mesh> loadModel(Graphics::VulkanDevice& device, const std::string& filepath,
+                                              Graphics::VertexFormat format)
     {
-      std::shared_ptr<Graphics::Mesh> model = createCubeModel(vulkanDevice, {0.0f, 0.0f, 0.0f});
+      Graphics::ModelLoader::LoadStats stats{};
+      Graphics::Mesh::Builder builder = Graphics::ModelLoader::load(filepath, &stats);
+
+      std::cout << std::fixed << std::setprecision(2) << "loaded " << filepath << ": "
+                << stats.bytes / (1024.0 * 1024.0) << " MB in " << stats.seconds * 1000.0 << " ms ("
+                << stats.megabytesPerSecond << " MB/s) | " << stats.vertexCount << " vertices, " << stats.indexCount
+                << " indices | " << stats.threadCount << " threads" << std::endl;
 
-      auto cube = GameObject::createGameObject();
-      cube.model = model;
-      cube.transform.translation = {0.0f, 0.0f, 0.5f};
-      cube.transform.scale = {0.5f, 0.5f, 0.5f};
+      auto start = std::chrono::steady_clock::now();
+      builder.generateLods();
+      double lodMilliseconds =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-      // Add cube to list of objects
-      gameObjects.push_back(std::move(cube));
-    };
+      std::cout << std::fixed << std::setprecision(2) << "  " << builder.lods.size() << " LODs in " << lodMilliseconds
+                << " ms:";
+      for(const Graphics::Mesh::Lod& lod : builder.lods)
+        {
+          std::cout << " " << lod.indexCount / 3 << " (" << std::setprecision(4) << lod.error << ")";
+        }
+      std::cout << " triangles (error)" << std::endl;
+
+      return std::make_unique<Graphics::Mesh>(device, builder, format);
+    }
+
+    void Application::loadEntities()
+    {
+      std::shared_ptr<Graphics::Mesh> model = config.modelPath.empty()
+                                                ? createCubeModel(vulkanDevice, {0.0f, 0.0f, 0.0f}, config.vertexFormat)
+                                                : loadModel(vulkanDevice, config.modelPath, config.vertexFormat);
+
+      uint32_t stride = Graphics::vertexFormatStride(config.vertexFormat);
+      uint32_t fullStride = Graphics::vertexFormatStride(Graphics::VertexFormat::Float32);
+      std::cout << std::fixed << std::setprecision(1) << "vertex format "
+                << Graphics::vertexFormatName(config.vertexFormat) << ": " << stride << " B/vertex, "
+                << model->getVertexBufferSize() / 1024.0 << " KB vertex buffer (float32: " << fullStride
+                << " B/vertex, " << model->getVertexCount() * fullStride / 1024.0 << " KB)" << std::endl;
+
+      Entity cube = registry.create();
+      registry.emplace<MeshComponent>(cube, model);
+      registry.emplace<ColorComponent>(cube);
+
+      TransformComponent transform{};
+      transform.translation = {0.0f, 0.0f, 0.5f};
+      transform.scale = {0.5f, 0.5f, 0.5f};
+      transformSystem.add(cube, transform);
+    }
+
+    void Application::updateEntities()
+    {
+      PROFILE_SCOPE("Application::updateEntities");
+
+      // Slow spin so there is something moving on screen
+      for(Entity entity : transformSystem.entities())
+        {
+          glm::vec3 rotation = transformSystem.get(entity).rotation;
+          rotation.y = glm::mod(rotation.y + 0.0001f, glm::two_pi<float>());
+          rotation.z = glm::mod(rotation.z + 0.0001f, glm::two_pi<float>());
+          transformSystem.setRotation(entity, rotation);
+        }
+
+      // Only entities written since the last frame get their matrices rebuilt
+      transformSystem.update();
+    }
 
     // Pysics and colliston systems here
 
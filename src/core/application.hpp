@@ -1,39 +1,94 @@
 #pragma once
 
 #include "../platform/Window.hpp"
+#include "../graphics/presentation_policy.hpp"
+#include "../graphics/vertex_format.hpp"
 #include "../graphics/vulkan_device.hpp"
 #include "../renderer/renderer.hpp"
-#include "game_object.hpp"
+#include "components.hpp"
+#include "frame_limiter.hpp"
+#include "registry.hpp"
+#include "transform_system.hpp"
+#include "../renderer/render_system.hpp"
 
 // std
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace GameEngine
 {
   namespace Core
   {
+    /**
+     * @brief Startup options, filled in from the command line by main.
+     */
+    struct ApplicationConfig
+    {
+      bool headless = false;       ///< Render into an offscreen target instead of a window.
+      uint32_t frameCount = 600;   ///< Number of frames a headless run renders before exiting.
+      std::string capturePath;     ///< Write the last headless frame to this PPM file when set.
+      std::string goldenPath;      ///< Compare the last headless frame against this PPM file when set.
+      uint8_t goldenTolerance = 2; ///< Max per channel difference before a pixel counts as mismatched.
+      std::string tracePath;       ///< Write a Chrome trace here on exit when set, F12 dumps it on demand.
+      std::string modelPath;       ///< Load this .obj/.gltf/.glb instead of the built in cube when set.
+      bool gpuCulling = false;     ///< Cull in a compute pass and draw indirectly instead of culling on the CPU.
+      Graphics::VertexFormat vertexFormat = Graphics::VertexFormat::Float32; ///< How meshes store their vertices.
+      Graphics::PresentationPolicy presentation{}; ///< Present mode, queue depth and frame rate cap.
+    };
+
     class Application
     {
     public:
       static constexpr int WIDTH = 800;
       static constexpr int HEIGHT = 600;
+      static constexpr std::chrono::seconds STATS_REPORT_INTERVAL{2};
+      static constexpr const char* DEFAULT_TRACE_PATH = "trace.json";
+      static constexpr double MINIMIZED_WAIT_SECONDS = 0.1; // Longest the loop sleeps on events while minimized
 
-      Application();
+      Application(const ApplicationConfig& config = {});
       ~Application();
 
       // Copy constructors (Because the app is now managing vulkan objects we need to delete copy constructors)
       Application(const Platform::VulkanWindow&) = delete;
 
+      /**
+       * @brief Runs until the window is closed, or for config.frameCount frames when headless.
+       * @throws std::runtime_error if a headless golden image comparison fails.
+       */
       void run();
 
     private:
-      void loadGameObjects();
+      void runWindowed();
+      void runHeadless();
+      void renderFrame(RenderSystem& renderSystem);
+      void checkHeadlessOutput();
+      void loadEntities();
+      void updateEntities();
+      void reportFrameStats(const Renderer::FrameStats& stats);
+      void reportPresentation();
+      void reportPacingStats();
+      void reportPassStats();
+      void reportCullingStats(const RenderSystem& renderSystem);
+      void reportJobStats();
+      void reportMemoryStats();
+      void reportPipelineStats();
+      void reportPipelineLibraryStats();
+      void dumpTrace(const std::string& filepath);
+
+      ApplicationConfig config;
 
-      Platform::VulkanWindow vulkanWindow{WIDTH, HEIGHT, "GhostEngine Window"};
-      Graphics::VulkanDevice vulkanDevice{vulkanWindow};
-      Renderer::Renderer renderer{vulkanWindow, vulkanDevice};
+      // Window is null when headless, the device then skips surface and swap chain setup
+      std::unique_ptr<Platform::VulkanWindow> vulkanWindow;
+      Graphics::VulkanDevice vulkanDevice{vulkanWindow.get()};
+      std::unique_ptr<Renderer::Renderer> renderer;
+      Graphics::PipelineLibrary pipelineLibrary{vulkanDevice};
 
-      std::vector<GameObject> gameObjects;
+      Registry registry;
+      TransformSystem transformSystem;
+      FrameLimiter frameLimiter{config.presentation.frameRateCap};
     };
 
   } // namespace Core
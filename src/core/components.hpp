@@ -54,36 +54,21 @@ namespace GameEngine
       }
     };
 
-    class GameObject
+    /**
+     * @brief Mesh drawn for the entity, entities sharing a mesh are drawn with one instanced draw.
+     */
+    struct MeshComponent
     {
-    public:
-      using id_t = unsigned int; // This will be a unique ID
-
-      /**
-       * @breif This will create a new game object with unique ID's by incrementing the ID
-       *
-       **/
-      static GameObject createGameObject()
-      {
-        static id_t currentId = 0;
-        return GameObject{currentId++};
-      }
-
-      GameObject(const GameObject&) = delete;
-      GameObject& operator=(const GameObject&) = delete;
-      GameObject(GameObject&&) = default;
-      GameObject& operator=(GameObject&&) = default;
-
-      const id_t getId() { return id; }
-
-      std::shared_ptr<Graphics::Mesh> model{};
-      glm::vec3 color{};
-      TransformComponent transform{};
-
-    private:
-      GameObject(id_t objId) : id{objId} {};
+      std::shared_ptr<Graphics::Mesh> mesh{};
+      uint32_t lod = 0; ///< Level of detail drawn last frame, the render system starts its selection from it.
+    };
 
-      id_t id;
+    /**
+     * @brief Tint multiplied with the mesh's vertex colors.
+     */
+    struct ColorComponent
+    {
+      glm::vec3 color{1.0f, 1.0f, 1.0f};
     };
   } // namespace Core
 
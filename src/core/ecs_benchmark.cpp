@@ -0,0 +1,296 @@
+#include "ecs_benchmark.hpp"
+#include "components.hpp"
+#include "frustum_culler.hpp"
+#include "job_system.hpp"
+#include "registry.hpp"
+#include "transform_system.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    namespace
+    {
+      constexpr int PASSES = 15;
+
+      /**
+       * @brief Same members, in the same order, as the GameObject the registry replaced.
+       */
+      struct LegacyGameObject
+      {
+        unsigned int id;
+        std::shared_ptr<Graphics::Mesh> model{};
+        glm::vec3 color{1.0f, 1.0f, 1.0f};
+        TransformComponent transform{};
+      };
+
+      void spin(TransformComponent& transform)
+      {
+        transform.rotation.y = glm::mod(transform.rotation.y + 0.0001f, glm::two_pi<float>());
+        transform.rotation.z = glm::mod(transform.rotation.z + 0.0001f, glm::two_pi<float>());
+      }
+
+      /**
+       * @brief Best of PASSES runs, in milliseconds. The best run is the one least disturbed by the rest of the system.
+       */
+      template <typename Fn> double timeBest(Fn&& fn)
+      {
+        double best = 1e30;
+        for(int pass = 0; pass < PASSES; pass++)
+          {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, std::chrono::duration<double, std::milli>(elapsed).count());
+          }
+        return best;
+      }
+
+      void report(const char* name, uint32_t entityCount, double legacyMs, double registryMs)
+      {
+        std::cout << std::fixed << std::setprecision(3) << "  " << std::left << std::setw(28) << name << std::right
+                  << " vector<GameObject> " << legacyMs << " ms (" << legacyMs * 1e6 / entityCount
+                  << " ns/entity) | registry " << registryMs << " ms (" << registryMs * 1e6 / entityCount
+                  << " ns/entity) | " << std::setprecision(2) << legacyMs / registryMs << "x" << std::endl;
+      }
+    } // namespace
+
+    void runEcsBenchmark(uint32_t entityCount)
+    {
+      std::cout << "ecs benchmark: " << entityCount << " entities, best of " << PASSES << " passes" << std::endl;
+
+      std::vector<LegacyGameObject> legacy(entityCount);
+      Registry registry;
+      registry.pool<TransformComponent>().reserve(entityCount);
+      registry.pool<ColorComponent>().reserve(entityCount);
+      for(uint32_t i = 0; i < entityCount; i++)
+        {
+          glm::vec3 translation{static_cast<float>(i % 1000), static_cast<float>(i / 1000), 0.0f};
+          legacy[i].id = i;
+          legacy[i].transform.translation = translation;
+
+          Entity entity = registry.create();
+          registry.emplace<TransformComponent>(entity).translation = translation;
+          registry.emplace<ColorComponent>(entity);
+          registry.emplace<MeshComponent>(entity);
+        }
+
+      // Results go to a sink so the compiler cannot drop the loops
+      std::vector<glm::mat4> matrices(entityCount);
+      float sink = 0.0f;
+
+      double legacyMs = timeBest([&]() {
+        for(auto& obj : legacy) { spin(obj.transform); }
+      });
+      double registryMs = timeBest([&]() {
+        registry.view<TransformComponent>().each([](Entity, TransformComponent& transform) { spin(transform); });
+      });
+      report("spin (rotation only)", entityCount, legacyMs, registryMs);
+
+      legacyMs = timeBest([&]() {
+        for(size_t i = 0; i < legacy.size(); i++) { matrices[i] = legacy[i].transform.mat4(); }
+      });
+      registryMs = timeBest([&]() {
+        auto& transforms = registry.pool<TransformComponent>().data();
+        for(size_t i = 0; i < transforms.size(); i++) { matrices[i] = transforms[i].mat4(); }
+      });
+      sink += matrices[entityCount / 2][3][0];
+      report("model matrices", entityCount, legacyMs, registryMs);
+
+      legacyMs = timeBest([&]() {
+        float sum = 0.0f;
+        for(auto& obj : legacy) { sum += obj.transform.translation.x * obj.color.x; }
+        sink += sum;
+      });
+      registryMs = timeBest([&]() {
+        float sum = 0.0f;
+        registry.view<TransformComponent, ColorComponent>().each(
+          [&](Entity, TransformComponent& transform, ColorComponent& color)
+          { sum += transform.translation.x * color.color.x; });
+        sink += sum;
+      });
+      report("transform + color view", entityCount, legacyMs, registryMs);
+
+      std::cout << "  (checksum " << sink << ")" << std::endl;
+    }
+
+    void runTransformBenchmark(uint32_t entityCount)
+    {
+      std::cout << "transform benchmark: " << entityCount << " transforms, best of " << PASSES << " passes"
+                << std::endl;
+
+      std::mt19937 rng{42};
+      std::uniform_real_distribution<float> angle{-glm::two_pi<float>(), glm::two_pi<float>()};
+      std::uniform_real_distribution<float> position{-100.0f, 100.0f};
+      std::uniform_real_distribution<float> size{0.1f, 4.0f};
+
+      std::vector<TransformComponent> components(entityCount);
+      TransformSystem transforms;
+      for(uint32_t i = 0; i < entityCount; i++)
+        {
+          auto& transform = components[i];
+          transform.translation = {position(rng), position(rng), position(rng)};
+          transform.rotation = {angle(rng), angle(rng), angle(rng)};
+          transform.scale = {size(rng), size(rng), size(rng)};
+          transforms.add(i, transform);
+        }
+
+      auto msPerMillion = [entityCount](double ms) { return ms * 1e6 / entityCount; };
+
+      std::vector<glm::mat4> reference(entityCount);
+      double baselineMs = timeBest([&]() {
+        for(uint32_t i = 0; i < entityCount; i++) { reference[i] = components[i].mat4(); }
+      });
+      std::cout << std::fixed << std::setprecision(3) << "  TransformComponent::mat4 loop  " << baselineMs << " ms ("
+                << msPerMillion(baselineMs) << " ms per 1M)" << std::endl;
+
+      TransformSystem::Kernel best = TransformSystem::bestSupportedKernel();
+      for(auto kernel : {TransformSystem::Kernel::Scalar, TransformSystem::Kernel::SSE, TransformSystem::Kernel::AVX2})
+        {
+          if(static_cast<int>(kernel) > static_cast<int>(best)) { continue; }
+
+          transforms.setKernel(kernel);
+          double ms = timeBest([&]() {
+            transforms.markAllDirty();
+            transforms.update();
+          });
+
+          // Largest difference to the glm path, polynomial sin/cos should stay within a few float ulps
+          float maxError = 0.0f;
+          const auto& matrices = transforms.matrices();
+          for(uint32_t i = 0; i < entityCount; i++)
+            {
+              for(int c = 0; c < 4; c++)
+                {
+                  for(int r = 0; r < 4; r++)
+                    {
+                      maxError = std::max(maxError, std::fabs(matrices[i][c][r] - reference[i][c][r]));
+                    }
+                }
+            }
+
+          std::cout << std::fixed << std::setprecision(3) << "  " << std::left << std::setw(6)
+                    << TransformSystem::kernelName(kernel) << std::right << " all dirty           " << ms << " ms ("
+                    << msPerMillion(ms) << " ms per 1M) | " << std::setprecision(2) << baselineMs / ms
+                    << "x | max error " << std::scientific << maxError << std::defaultfloat << std::endl;
+        }
+
+      // Scattered 2% dirty, which takes the dirty run path, then a fully static frame, with the fastest kernel
+      transforms.setKernel(best);
+      std::uniform_int_distribution<uint32_t> pick{0, entityCount - 1};
+      double partialMs = 1e30;
+      for(int pass = 0; pass < PASSES; pass++)
+        {
+          // Only the update is timed, the writes stand in for gameplay code
+          for(uint32_t i = 0; i < entityCount / 50; i++)
+            {
+              transforms.setRotation(pick(rng), {angle(rng), angle(rng), angle(rng)});
+            }
+          auto start = std::chrono::steady_clock::now();
+          transforms.update();
+          auto elapsed = std::chrono::steady_clock::now() - start;
+          partialMs = std::min(partialMs, std::chrono::duration<double, std::milli>(elapsed).count());
+        }
+      double staticMs = timeBest([&]() { transforms.update(); });
+
+      std::cout << std::fixed << std::setprecision(3) << "  " << std::left << std::setw(6)
+                << TransformSystem::kernelName(best) << std::right << " 2% dirty            " << partialMs
+                << " ms | static " << staticMs << " ms" << std::endl;
+    }
+
+    void runJobBenchmark(uint32_t entityCount)
+    {
+      uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+      std::cout << "job benchmark: " << entityCount << " entities, 1 to " << maxThreads << " threads, best of "
+                << PASSES << " passes" << std::endl;
+
+      std::mt19937 rng{42};
+      std::uniform_real_distribution<float> angle{-glm::two_pi<float>(), glm::two_pi<float>()};
+      std::uniform_real_distribution<float> position{-2.0f, 2.0f};
+      std::uniform_real_distribution<float> size{0.05f, 0.5f};
+
+      TransformSystem transforms;
+      std::vector<glm::vec4> spheres(entityCount);
+      for(uint32_t i = 0; i < entityCount; i++)
+        {
+          TransformComponent transform{};
+          transform.translation = {position(rng), position(rng), position(rng)};
+          transform.rotation = {angle(rng), angle(rng), angle(rng)};
+          transform.scale = {size(rng), size(rng), size(rng)};
+          transforms.add(i, transform);
+          spheres[i] = glm::vec4{0.0f, 0.0f, 0.0f, 0.866f}; // Unit cube
+        }
+
+      FrustumCuller culler;
+      Frustum frustum = Frustum::fromViewProjection(glm::mat4{1.0f});
+      std::vector<uint32_t> visible;
+      constexpr uint32_t EMPTY_JOBS = 100000;
+
+      double baseTransformMs = 0.0;
+      double baseCullMs = 0.0;
+      for(uint32_t threads = 1; threads <= maxThreads; threads++)
+        {
+          JobSystem jobs{threads - 1};
+          transforms.setJobSystem(&jobs);
+          culler.setJobSystem(&jobs);
+
+          double transformMs = timeBest([&]() {
+            transforms.markAllDirty();
+            transforms.update();
+          });
+
+          CullInput input{};
+          input.matrices = reinterpret_cast<const float*>(transforms.matrices().data());
+          input.spheres = spheres.data();
+          input.count = entityCount;
+          double cullMs = timeBest([&]() { culler.cull(frustum, input, visible); });
+
+          // Average utilization of every thread over the transform and cull passes above
+          auto stats = jobs.consumeStats();
+          double utilization = 0.0;
+          for(const auto& worker : stats) { utilization += worker.utilization; }
+          utilization /= stats.size();
+
+          // Scheduling overhead on its own: many jobs that do nothing
+          double emptyMs = timeBest([&]() {
+            JobCounter counter;
+            for(uint32_t i = 0; i < EMPTY_JOBS; i++) { jobs.run([]() {}, &counter); }
+            jobs.wait(counter);
+          });
+
+          if(threads == 1)
+            {
+              baseTransformMs = transformMs;
+              baseCullMs = cullMs;
+            }
+
+          std::cout << std::fixed << std::setprecision(3) << "  " << std::setw(2) << threads << " threads | transforms "
+                    << transformMs << " ms (" << std::setprecision(2) << baseTransformMs / transformMs << "x) | cull "
+                    << std::setprecision(3) << cullMs << " ms (" << std::setprecision(2) << baseCullMs / cullMs
+                    << "x, " << visible.size() << " visible) | " << std::setprecision(1)
+                    << emptyMs * 1e6 / EMPTY_JOBS << " ns per empty job";
+          // With one thread the work runs inline instead of as jobs, so there is nothing to report
+          if(threads > 1) { std::cout << " | utilization " << std::setprecision(0) << utilization * 100.0 << "%"; }
+          std::cout << std::endl;
+        }
+      transforms.setJobSystem(&JobSystem::get());
+    }
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,30 @@
+#pragma once
+
+// std
+#include <cstdint>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief Times transform iteration over entityCount entities stored in the Registry against the same data stored
+     * the old way, as a std::vector of fat GameObject style structs, and prints the results.
+     *
+     * Runs entirely on the CPU, no device or window is created.
+     */
+    void runEcsBenchmark(uint32_t entityCount);
+
+    /**
+     * @brief Times TransformSystem::update over entityCount transforms with every kernel the CPU supports, plus
+     * partially dirty and static frames, against calling TransformComponent::mat4 per entity.
+     */
+    void runTransformBenchmark(uint32_t entityCount);
+
+    /**
+     * @brief Times full transform rebuilds, frustum culling and empty job throughput on a JobSystem with 1 up to
+     * hardware_concurrency threads, printing the speedup over one thread and the average thread utilization.
+     */
+    void runJobBenchmark(uint32_t entityCount);
+  } // namespace Core
+} // namespace GameEngine
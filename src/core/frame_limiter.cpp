@@ -0,0 +1,54 @@
+#include "frame_limiter.hpp"
+
+// std
+#include <thread>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    FrameLimiter::FrameLimiter(double framesPerSecond) : framesPerSecond{framesPerSecond}
+    {
+      if(framesPerSecond > 0.0)
+        {
+          period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+        }
+    }
+
+    void FrameLimiter::wait()
+    {
+      if(!isEnabled()) { return; }
+
+      auto start = Clock::now();
+      frames++;
+
+      if(deadline == Clock::time_point{} || start - deadline > period)
+        {
+          // First frame, or too far behind to catch up, so this frame starts a new schedule
+          if(deadline != Clock::time_point{}) { lateFrames++; }
+          deadline = start + period;
+          return;
+        }
+      if(start > deadline) { lateFrames++; }
+
+      if(deadline - start > SPIN_MARGIN) { std::this_thread::sleep_for(deadline - start - SPIN_MARGIN); }
+      while(Clock::now() < deadline) { std::this_thread::yield(); }
+
+      waited += Clock::now() - start;
+      deadline += period;
+    }
+
+    FrameLimiter::Stats FrameLimiter::consumeStats()
+    {
+      Stats stats{};
+      stats.frames = frames;
+      stats.lateFrames = lateFrames;
+      if(frames > 0) { stats.avgWaitMs = std::chrono::duration<double, std::milli>(waited).count() / frames; }
+
+      frames = 0;
+      lateFrames = 0;
+      waited = {};
+      return stats;
+    }
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,64 @@
+#pragma once
+
+// std
+#include <chrono>
+#include <cstdint>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief Caps the frame rate on the CPU by holding each frame back until its slot in a fixed schedule.
+     *
+     * OS sleeps overshoot by up to a scheduler tick, so wait sleeps until SPIN_MARGIN before the deadline and spins
+     * for the rest. Frames are scheduled one period after the previous deadline rather than after the previous
+     * wait, so small overshoots do not add up. A frame that misses its deadline by more than a whole period restarts
+     * the schedule instead of letting the next frames burst to catch up.
+     *
+     * Call wait right before sampling input, so the time spent waiting is not added to input latency.
+     */
+    class FrameLimiter
+    {
+    public:
+      using Clock = std::chrono::steady_clock;
+
+      // Left for spinning, covers the sleep overshoot of common schedulers
+      static constexpr std::chrono::microseconds SPIN_MARGIN{1500};
+
+      struct Stats
+      {
+        uint32_t frames = 0;
+        double avgWaitMs = 0.0;  ///< Time held back per frame, sleeping and spinning.
+        uint32_t lateFrames = 0; ///< Frames that started after their deadline.
+      };
+
+      /**
+       * @param framesPerSecond Cap, 0 or less disables the limiter.
+       */
+      explicit FrameLimiter(double framesPerSecond);
+
+      bool isEnabled() const { return period.count() > 0; }
+      double getFrameRateCap() const { return framesPerSecond; }
+
+      /**
+       * @brief Blocks until the next frame is due. Returns immediately when disabled.
+       */
+      void wait();
+
+      /**
+       * @brief Returns the statistics gathered since the previous call and resets them.
+       */
+      Stats consumeStats();
+
+    private:
+      double framesPerSecond;
+      Clock::duration period{};
+      Clock::time_point deadline{};
+
+      uint32_t frames = 0;
+      uint32_t lateFrames = 0;
+      Clock::duration waited{};
+    };
+  } // namespace Core
+} // namespace GameEngine
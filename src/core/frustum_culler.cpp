@@ -0,0 +1,282 @@
+#include "frustum_culler.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    namespace
+    {
+      bool sphereVisible(const Frustum& frustum, const float* m, const glm::vec4& sphere)
+      {
+        glm::vec3 center{m[0] * sphere.x + m[4] * sphere.y + m[8] * sphere.z + m[12],
+                         m[1] * sphere.x + m[5] * sphere.y + m[9] * sphere.z + m[13],
+                         m[2] * sphere.x + m[6] * sphere.y + m[10] * sphere.z + m[14]};
+
+        // Non uniform scale stretches the sphere into an ellipsoid, the largest axis bounds it
+        float scaleSquared = std::max({m[0] * m[0] + m[1] * m[1] + m[2] * m[2], m[4] * m[4] + m[5] * m[5] + m[6] * m[6],
+                                       m[8] * m[8] + m[9] * m[9] + m[10] * m[10]});
+        float radius = sphere.w * std::sqrt(scaleSquared);
+
+        for(const auto& plane : frustum.planes)
+          {
+            // Written so NaN matrices are culled, like the SIMD compares
+            if(!(plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w + radius >= 0.0f))
+              {
+                return false;
+              }
+          }
+        return true;
+      }
+
+      size_t cullScalar(const Frustum& frustum, const CullInput& input, size_t begin, size_t end, uint32_t* output)
+      {
+        size_t written = 0;
+        for(size_t i = begin; i < end; i++)
+          {
+            output[written] = static_cast<uint32_t>(i);
+            written += sphereVisible(frustum, input.matrices + i * input.matrixStride, input.spheres[i]) ? 1 : 0;
+          }
+        return written;
+      }
+
+#ifdef GAME_ENGINE_X86
+      // Appends base + the index of every set bit, lowest first
+      inline size_t writeMask(uint32_t mask, size_t base, uint32_t* output)
+      {
+        size_t written = 0;
+        while(mask != 0)
+          {
+            output[written++] = static_cast<uint32_t>(base + __builtin_ctz(mask));
+            mask &= mask - 1;
+          }
+        return written;
+      }
+
+      size_t cullSSE(const Frustum& frustum, const CullInput& input, size_t begin, size_t end, uint32_t* output)
+      {
+        const size_t stride = input.matrixStride;
+        size_t written = 0;
+
+        size_t i = begin;
+        for(; i + 4 <= end; i += 4)
+          {
+            // columns[j][r] holds row r of column j for objects i to i + 3
+            const float* m = input.matrices + i * stride;
+            __m128 columns[4][4];
+            for(int j = 0; j < 4; j++)
+              {
+                columns[j][0] = _mm_loadu_ps(m + 0 * stride + j * 4);
+                columns[j][1] = _mm_loadu_ps(m + 1 * stride + j * 4);
+                columns[j][2] = _mm_loadu_ps(m + 2 * stride + j * 4);
+                columns[j][3] = _mm_loadu_ps(m + 3 * stride + j * 4);
+                _MM_TRANSPOSE4_PS(columns[j][0], columns[j][1], columns[j][2], columns[j][3]);
+              }
+
+            __m128 cx = _mm_loadu_ps(&input.spheres[i + 0].x);
+            __m128 cy = _mm_loadu_ps(&input.spheres[i + 1].x);
+            __m128 cz = _mm_loadu_ps(&input.spheres[i + 2].x);
+            __m128 r = _mm_loadu_ps(&input.spheres[i + 3].x);
+            _MM_TRANSPOSE4_PS(cx, cy, cz, r);
+
+            __m128 center[3];
+            __m128 axisSquared[3];
+            for(int row = 0; row < 3; row++)
+              {
+                center[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[0][row], cx), _mm_mul_ps(columns[1][row], cy)),
+                                         _mm_add_ps(_mm_mul_ps(columns[2][row], cz), columns[3][row]));
+                axisSquared[row] =
+                  _mm_add_ps(_mm_add_ps(_mm_mul_ps(columns[row][0], columns[row][0]),
+                                        _mm_mul_ps(columns[row][1], columns[row][1])),
+                             _mm_mul_ps(columns[row][2], columns[row][2]));
+              }
+            __m128 scale = _mm_sqrt_ps(_mm_max_ps(_mm_max_ps(axisSquared[0], axisSquared[1]), axisSquared[2]));
+            __m128 radius = _mm_mul_ps(r, scale);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for(const auto& plane : frustum.planes)
+              {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), center[0]),
+                                                        _mm_mul_ps(_mm_set1_ps(plane.y), center[1])),
+                                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), center[2]),
+                                                        _mm_add_ps(_mm_set1_ps(plane.w), radius)));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+              }
+
+            written += writeMask(static_cast<uint32_t>(_mm_movemask_ps(inside)), i, output + written);
+          }
+
+        return written + cullScalar(frustum, input, i, end, output + written);
+      }
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+      // Objects k and k + 4 share a register, k in the low lane
+      AVX2_TARGET inline __m256 loadPair(const float* low, const float* high)
+      {
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+      }
+
+      // 4x4 transpose within each 128 bit lane
+      AVX2_TARGET inline void transposeLanes(__m256& r0, __m256& r1, __m256& r2, __m256& r3)
+      {
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+        __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+        r0 = _mm256_shuffle_ps(t0, t2, 0x44);
+        r1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+        r2 = _mm256_shuffle_ps(t1, t3, 0x44);
+        r3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+      }
+
+      AVX2_TARGET size_t cullAVX2(const Frustum& frustum, const CullInput& input, size_t begin, size_t end,
+                                  uint32_t* output)
+      {
+        const size_t stride = input.matrixStride;
+        size_t written = 0;
+
+        size_t i = begin;
+        for(; i + 8 <= end; i += 8)
+          {
+            // After the transposes columns[j][r] holds row r of column j for objects i to i + 7, in order
+            const float* m = input.matrices + i * stride;
+            __m256 columns[4][4];
+            for(int j = 0; j < 4; j++)
+              {
+                for(int k = 0; k < 4; k++)
+                  {
+                    columns[j][k] = loadPair(m + k * stride + j * 4, m + (k + 4) * stride + j * 4);
+                  }
+                transposeLanes(columns[j][0], columns[j][1], columns[j][2], columns[j][3]);
+              }
+
+            const glm::vec4* spheres = input.spheres + i;
+            __m256 cx = loadPair(&spheres[0].x, &spheres[4].x);
+            __m256 cy = loadPair(&spheres[1].x, &spheres[5].x);
+            __m256 cz = loadPair(&spheres[2].x, &spheres[6].x);
+            __m256 r = loadPair(&spheres[3].x, &spheres[7].x);
+            transposeLanes(cx, cy, cz, r);
+
+            __m256 center[3];
+            __m256 axisSquared[3];
+            for(int row = 0; row < 3; row++)
+              {
+                center[row] = _mm256_fmadd_ps(columns[0][row], cx,
+                                              _mm256_fmadd_ps(columns[1][row], cy,
+                                                              _mm256_fmadd_ps(columns[2][row], cz, columns[3][row])));
+                axisSquared[row] =
+                  _mm256_fmadd_ps(columns[row][0], columns[row][0],
+                                  _mm256_fmadd_ps(columns[row][1], columns[row][1],
+                                                  _mm256_mul_ps(columns[row][2], columns[row][2])));
+              }
+            __m256 scale =
+              _mm256_sqrt_ps(_mm256_max_ps(_mm256_max_ps(axisSquared[0], axisSquared[1]), axisSquared[2]));
+            __m256 radius = _mm256_mul_ps(r, scale);
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for(const auto& plane : frustum.planes)
+              {
+                __m256 distance = _mm256_fmadd_ps(
+                  _mm256_set1_ps(plane.x), center[0],
+                  _mm256_fmadd_ps(_mm256_set1_ps(plane.y), center[1],
+                                  _mm256_fmadd_ps(_mm256_set1_ps(plane.z), center[2],
+                                                  _mm256_add_ps(_mm256_set1_ps(plane.w), radius))));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+              }
+
+            written += writeMask(static_cast<uint32_t>(_mm256_movemask_ps(inside)), i, output + written);
+          }
+
+        return written + cullSSE(frustum, input, i, end, output + written);
+      }
+#endif
+    } // namespace
+
+    Frustum Frustum::fromViewProjection(const glm::mat4& viewProjection)
+    {
+      // glm is column major, row i of the matrix is element i of every column
+      auto row = [&viewProjection](int i) {
+        return glm::vec4{viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]};
+      };
+
+      Frustum frustum{};
+      frustum.planes[0] = row(3) + row(0); // Left
+      frustum.planes[1] = row(3) - row(0); // Right
+      frustum.planes[2] = row(3) + row(1); // Top, Vulkan's y points down
+      frustum.planes[3] = row(3) - row(1); // Bottom
+      frustum.planes[4] = row(2);          // Near, clip z starts at 0 rather than -w
+      frustum.planes[5] = row(3) - row(2); // Far
+
+      for(auto& plane : frustum.planes)
+        {
+          float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+          if(length > 0.0f) { plane = plane * (1.0f / length); }
+        }
+      return frustum;
+    }
+
+    FrustumCuller::FrustumCuller() : kernel{bestSupportedSimdKernel()} {}
+
+    void FrustumCuller::setKernel(Kernel requested) { kernel = supportedSimdKernel(requested); }
+
+    size_t FrustumCuller::cullRange(const Frustum& frustum, const CullInput& input, size_t begin, size_t end,
+                                    uint32_t* output) const
+    {
+      switch(kernel)
+        {
+#ifdef GAME_ENGINE_X86
+        case Kernel::AVX2: return cullAVX2(frustum, input, begin, end, output);
+        case Kernel::SSE: return cullSSE(frustum, input, begin, end, output);
+#endif
+        default: return cullScalar(frustum, input, begin, end, output);
+        }
+    }
+
+    void FrustumCuller::cull(const Frustum& frustum, const CullInput& input, std::vector<uint32_t>& visible) const
+    {
+      // Every range writes its survivors at the start of its own slice of visible, then the slices are packed
+      // together, so jobs never share an output and the result stays in input order
+      visible.resize(input.count);
+      if(input.count == 0) { return; }
+
+      if(!jobs || jobs->threadCount() == 1 || input.count < 2 * MIN_OBJECTS_PER_JOB)
+        {
+          visible.resize(cullRange(frustum, input, 0, input.count, visible.data()));
+          return;
+        }
+
+      // A few ranges per thread so idle threads can steal, each a multiple of 8 so only the last has a scalar tail
+      size_t rangeSize = std::max(MIN_OBJECTS_PER_JOB, input.count / (jobs->threadCount() * 4));
+      rangeSize = (rangeSize + 7) & ~size_t{7};
+      size_t rangeCount = (input.count + rangeSize - 1) / rangeSize;
+
+      std::vector<size_t> written(rangeCount, 0);
+      JobCounter counter;
+      for(size_t r = 0; r < rangeCount; r++)
+        {
+          jobs->run(
+            [&, r]()
+            {
+              size_t begin = r * rangeSize;
+              size_t end = std::min(begin + rangeSize, input.count);
+              written[r] = cullRange(frustum, input, begin, end, visible.data() + begin);
+            },
+            &counter);
+        }
+      jobs->wait(counter);
+
+      size_t packed = written[0];
+      for(size_t r = 1; r < rangeCount; r++)
+        {
+          const uint32_t* slice = visible.data() + r * rangeSize;
+          std::copy(slice, slice + written[r], visible.data() + packed);
+          packed += written[r];
+        }
+      visible.resize(packed);
+    }
+  } // namespace Core
+} // namespace GameEngine
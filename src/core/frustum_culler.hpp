@@ -0,0 +1,91 @@
+#pragma once
+
+#include "job_system.hpp"
+#include "simd.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief The six clip planes of a view projection, normals point inwards and are normalized.
+     */
+    struct Frustum
+    {
+      std::array<glm::vec4, 6> planes{}; ///< xyz normal, w offset: a point p is inside when dot(xyz, p) + w >= 0.
+
+      /**
+       * @brief Extracts the planes from the rows of viewProjection (Gribb/Hartmann), with Vulkan's 0 to 1 depth.
+       */
+      static Frustum fromViewProjection(const glm::mat4& viewProjection);
+    };
+
+    /**
+     * @brief Objects to cull, read in place so callers can point at matrices inside larger structs.
+     */
+    struct CullInput
+    {
+      const float* matrices = nullptr;    ///< Column major model matrix of object 0.
+      size_t matrixStride = 16;           ///< Floats from one object's matrix to the next.
+      const glm::vec4* spheres = nullptr; ///< Local bounding sphere per object, xyz center and w radius.
+      size_t count = 0;
+    };
+
+    /**
+     * @brief Tests bounding spheres against a frustum, 4 (SSE) or 8 (AVX2) objects per iteration.
+     *
+     * Every local sphere is moved to world space by its model matrix, its radius grown by the matrix's largest
+     * axis scale, and then tested against all six planes without branching. Surviving objects are written out as a
+     * compact, ascending list of indices. Large inputs are split into contiguous ranges culled as jobs.
+     */
+    class FrustumCuller
+    {
+    public:
+      using Kernel = SimdKernel;
+
+      // Below this many objects a job costs more to schedule than it saves
+      static constexpr size_t MIN_OBJECTS_PER_JOB = 16384;
+
+      FrustumCuller();
+
+      /**
+       * @brief Replaces visible with the indices of every object at least partially inside the frustum.
+       */
+      void cull(const Frustum& frustum, const CullInput& input, std::vector<uint32_t>& visible) const;
+
+      Kernel getKernel() const { return kernel; }
+
+      /**
+       * @brief Forces a kernel, mostly for benchmarking. Falls back to scalar if the CPU lacks support.
+       */
+      void setKernel(Kernel requested);
+
+      /**
+       * @brief Scheduler large inputs are split across, null culls everything on the calling thread.
+       */
+      void setJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+
+    private:
+      /**
+       * @brief Culls objects [begin, end) and writes the visible indices to output.
+       * @return Number of indices written.
+       */
+      size_t cullRange(const Frustum& frustum, const CullInput& input, size_t begin, size_t end,
+                       uint32_t* output) const;
+
+      Kernel kernel;
+      JobSystem* jobs = &JobSystem::get();
+    };
+  } // namespace Core
+} // namespace GameEngine
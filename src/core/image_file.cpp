@@ -0,0 +1,82 @@
+#include "image_file.hpp"
+
+// std
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    Image imageFromRGBA(uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba)
+    {
+      Image image;
+      image.width = width;
+      image.height = height;
+      image.pixels.resize(static_cast<size_t>(width) * height * 3);
+
+      for(size_t i = 0, pixelCount = static_cast<size_t>(width) * height; i < pixelCount; i++)
+        {
+          image.pixels[i * 3 + 0] = rgba[i * 4 + 0];
+          image.pixels[i * 3 + 1] = rgba[i * 4 + 1];
+          image.pixels[i * 3 + 2] = rgba[i * 4 + 2];
+        }
+      return image;
+    }
+
+    void writePPM(const std::string& filepath, const Image& image)
+    {
+      std::ofstream file{filepath, std::ios::binary};
+      if(!file.is_open()) { throw std::runtime_error("failed to open file: " + filepath); }
+
+      file << "P6\n" << image.width << " " << image.height << "\n255\n";
+      file.write(reinterpret_cast<const char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+      if(!file) { throw std::runtime_error("failed to write file: " + filepath); }
+    }
+
+    Image readPPM(const std::string& filepath)
+    {
+      std::ifstream file{filepath, std::ios::binary};
+      if(!file.is_open()) { throw std::runtime_error("failed to open file: " + filepath); }
+
+      std::string magic;
+      uint32_t maxValue = 0;
+      Image image;
+      file >> magic >> image.width >> image.height >> maxValue;
+      if(!file || magic != "P6" || maxValue != 255)
+        {
+          throw std::runtime_error("unsupported PPM file (expected binary P6 with max value 255): " + filepath);
+        }
+      file.get(); // Single whitespace between header and pixel data
+
+      image.pixels.resize(static_cast<size_t>(image.width) * image.height * 3);
+      file.read(reinterpret_cast<char*>(image.pixels.data()), static_cast<std::streamsize>(image.pixels.size()));
+      if(!file) { throw std::runtime_error("truncated PPM file: " + filepath); }
+      return image;
+    }
+
+    uint64_t countMismatchedPixels(const Image& a, const Image& b, uint8_t tolerance)
+    {
+      if(a.width != b.width || a.height != b.height)
+        {
+          return static_cast<uint64_t>(std::max(a.width, b.width)) * std::max(a.height, b.height);
+        }
+
+      uint64_t mismatched = 0;
+      for(size_t i = 0; i < a.pixels.size(); i += 3)
+        {
+          for(size_t c = 0; c < 3; c++)
+            {
+              if(std::abs(static_cast<int>(a.pixels[i + c]) - static_cast<int>(b.pixels[i + c])) > tolerance)
+                {
+                  mismatched++;
+                  break;
+                }
+            }
+        }
+      return mismatched;
+    }
+  } // namespace Core
+} // namespace GameEngine
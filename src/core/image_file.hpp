@@ -0,0 +1,45 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief 8 bit RGB image as stored in binary PPM (P6) files.
+     */
+    struct Image
+    {
+      uint32_t width = 0;
+      uint32_t height = 0;
+      std::vector<uint8_t> pixels; // width * height * 3 bytes, row major, top row first
+    };
+
+    /**
+     * @brief Builds an RGB image from tightly packed RGBA8 pixels, dropping alpha.
+     */
+    Image imageFromRGBA(uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba);
+
+    /**
+     * @brief Writes the image as a binary PPM file.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    void writePPM(const std::string& filepath, const Image& image);
+
+    /**
+     * @brief Reads a binary PPM file with a max value of 255.
+     * @throws std::runtime_error if the file cannot be opened or is not a supported PPM.
+     */
+    Image readPPM(const std::string& filepath);
+
+    /**
+     * @brief Counts pixels where any channel differs by more than tolerance.
+     * @return Number of mismatching pixels, or every pixel if the sizes differ.
+     */
+    uint64_t countMismatchedPixels(const Image& a, const Image& b, uint8_t tolerance);
+  } // namespace Core
+} // namespace GameEngine
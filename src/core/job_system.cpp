@@ -0,0 +1,249 @@
+#include "job_system.hpp"
+
+// std
+#include <chrono>
+#include <utility>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    namespace
+    {
+      // Which scheduler, and which of its slots, the current thread owns
+      thread_local const JobSystem* currentSystem = nullptr;
+      thread_local size_t currentWorker = 0;
+
+      uint64_t nowNs()
+      {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::steady_clock::now().time_since_epoch())
+                                       .count());
+      }
+    } // namespace
+
+    JobSystem& JobSystem::get()
+    {
+      static JobSystem instance{std::max(1u, std::thread::hardware_concurrency()) - 1};
+      return instance;
+    }
+
+    JobSystem::JobSystem(uint32_t workerCount) : statsWindowStartNs{nowNs()}
+    {
+      for(uint32_t i = 0; i <= workerCount; i++) { slots.push_back(std::make_unique<Worker>()); }
+
+      // Slots must all exist before the first worker starts stealing from them
+      for(uint32_t i = 0; i < workerCount; i++)
+        {
+          workers.push_back(slots[i].get());
+          slots[i]->thread = std::thread([this, i]() { workerLoop(i); });
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+      {
+        std::lock_guard<std::mutex> lock{sleepMutex};
+        stopping = true;
+      }
+      wakeUp.notify_all();
+      for(Worker* worker : workers) { worker->thread.join(); }
+    }
+
+    size_t JobSystem::currentSlot() const { return currentSystem == this ? currentWorker : workers.size(); }
+
+    void JobSystem::run(std::function<void()> job, JobCounter* counter)
+    {
+      if(counter) { counter->pending.fetch_add(1, std::memory_order_relaxed); }
+      push({std::move(job), counter});
+    }
+
+    void JobSystem::runBackground(std::function<void()> job, JobCounter* counter)
+    {
+      if(counter) { counter->pending.fetch_add(1, std::memory_order_relaxed); }
+      {
+        std::lock_guard<std::mutex> lock{backgroundMutex};
+        backgroundJobs.push_back({std::move(job), counter});
+      }
+      queuedJobs.fetch_add(1);
+
+      if(sleepers.load() > 0)
+        {
+          { std::lock_guard<std::mutex> lock{sleepMutex}; }
+          wakeUp.notify_one();
+        }
+    }
+
+    void JobSystem::runAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter)
+    {
+      if(counter) { counter->pending.fetch_add(1, std::memory_order_relaxed); }
+
+      {
+        std::lock_guard<std::mutex> lock{dependency.mutex};
+        if(dependency.pending.load(std::memory_order_acquire) != 0)
+          {
+            dependency.continuations.emplace_back(std::move(job), counter);
+            return;
+          }
+      }
+      push({std::move(job), counter});
+    }
+
+    void JobSystem::push(Job job)
+    {
+      Worker& slot = *slots[currentSlot()];
+      {
+        std::lock_guard<std::mutex> lock{slot.mutex};
+        slot.jobs.push_back(std::move(job));
+      }
+      queuedJobs.fetch_add(1);
+
+      // Taking the lock orders this against a worker checking queuedJobs right before it sleeps
+      if(sleepers.load() > 0)
+        {
+          { std::lock_guard<std::mutex> lock{sleepMutex}; }
+          wakeUp.notify_one();
+        }
+    }
+
+    bool JobSystem::pop(size_t self, Job& job)
+    {
+      Worker& slot = *slots[self];
+      std::lock_guard<std::mutex> lock{slot.mutex};
+      if(slot.jobs.empty()) { return false; }
+
+      // Newest first, it is the most likely to still be in cache
+      job = std::move(slot.jobs.back());
+      slot.jobs.pop_back();
+      queuedJobs.fetch_sub(1);
+      return true;
+    }
+
+    bool JobSystem::steal(size_t self, Job& job)
+    {
+      for(size_t offset = 1; offset < slots.size(); offset++)
+        {
+          Worker& victim = *slots[(self + offset) % slots.size()];
+          std::unique_lock<std::mutex> lock{victim.mutex, std::try_to_lock};
+          if(!lock.owns_lock() || victim.jobs.empty()) { continue; }
+
+          // Oldest first, it tends to be the largest remaining piece of the victim's work
+          job = std::move(victim.jobs.front());
+          victim.jobs.pop_front();
+          queuedJobs.fetch_sub(1);
+          slots[self]->jobsStolen.fetch_add(1, std::memory_order_relaxed);
+          return true;
+        }
+      return false;
+    }
+
+    bool JobSystem::popBackground(Job& job)
+    {
+      std::lock_guard<std::mutex> lock{backgroundMutex};
+      if(backgroundJobs.empty()) { return false; }
+
+      job = std::move(backgroundJobs.front());
+      backgroundJobs.pop_front();
+      queuedJobs.fetch_sub(1);
+      return true;
+    }
+
+    void JobSystem::execute(size_t self, Job& job)
+    {
+      uint64_t start = nowNs();
+      try
+        {
+          job.function();
+        }
+      catch(...)
+        {
+          if(job.counter)
+            {
+              std::lock_guard<std::mutex> lock{job.counter->mutex};
+              if(!job.counter->error) { job.counter->error = std::current_exception(); }
+            }
+        }
+      job.function = nullptr; // Release captures before the counter signals anyone
+
+      Worker& slot = *slots[self];
+      slot.busyNs.fetch_add(nowNs() - start, std::memory_order_relaxed);
+      slot.jobsRun.fetch_add(1, std::memory_order_relaxed);
+      finish(job.counter);
+    }
+
+    void JobSystem::finish(JobCounter* counter)
+    {
+      if(!counter) { return; }
+
+      // Decrementing under the lock means a waiter that saw zero and then took the lock can destroy the counter,
+      // nothing here touches it after unlocking
+      std::vector<std::pair<std::function<void()>, JobCounter*>> released;
+      {
+        std::lock_guard<std::mutex> lock{counter->mutex};
+        if(counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1) { return; }
+        released.swap(counter->continuations);
+      }
+
+      // Continuations were already counted against their own counters by runAfter
+      for(auto& [function, continuationCounter] : released) { push({std::move(function), continuationCounter}); }
+    }
+
+    void JobSystem::wait(JobCounter& counter)
+    {
+      size_t self = currentSlot();
+      while(!counter.isDone())
+        {
+          Job job;
+          if(pop(self, job) || steal(self, job)) { execute(self, job); }
+          else { std::this_thread::yield(); }
+        }
+
+      std::exception_ptr error;
+      {
+        std::lock_guard<std::mutex> lock{counter.mutex};
+        std::swap(error, counter.error);
+      }
+      if(error) { std::rethrow_exception(error); }
+    }
+
+    void JobSystem::workerLoop(size_t self)
+    {
+      currentSystem = this;
+      currentWorker = self;
+
+      while(true)
+        {
+          Job job;
+          if(pop(self, job) || steal(self, job) || popBackground(job))
+            {
+              execute(self, job);
+              continue;
+            }
+
+          std::unique_lock<std::mutex> lock{sleepMutex};
+          sleepers.fetch_add(1);
+          wakeUp.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+          sleepers.fetch_sub(1);
+          if(stopping) { return; }
+        }
+    }
+
+    std::vector<JobSystem::WorkerStats> JobSystem::consumeStats()
+    {
+      uint64_t now = nowNs();
+      double windowNs = static_cast<double>(std::max<uint64_t>(now - statsWindowStartNs, 1));
+      statsWindowStartNs = now;
+
+      std::vector<WorkerStats> stats(slots.size());
+      for(size_t i = 0; i < slots.size(); i++)
+        {
+          uint64_t busyNs = slots[i]->busyNs.exchange(0, std::memory_order_relaxed);
+          stats[i].jobs = slots[i]->jobsRun.exchange(0, std::memory_order_relaxed);
+          stats[i].steals = slots[i]->jobsStolen.exchange(0, std::memory_order_relaxed);
+          stats[i].busyMs = busyNs / 1e6;
+          stats[i].utilization = std::min(1.0, busyNs / windowNs);
+        }
+      return stats;
+    }
+  } // namespace Core
+} // namespace GameEngine
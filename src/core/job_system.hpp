@@ -0,0 +1,209 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief Tracks a group of jobs. It reaches zero once every job run against it has finished.
+     *
+     * Jobs queued with JobSystem::runAfter start once the counter reaches zero, which is how dependencies are
+     * expressed. The first exception thrown by a job is kept and rethrown by JobSystem::wait. A counter must outlive
+     * its jobs and may be reused once it is done.
+     */
+    class JobCounter
+    {
+    public:
+      JobCounter() = default;
+      JobCounter(const JobCounter&) = delete;
+      JobCounter& operator=(const JobCounter&) = delete;
+
+      /**
+       * @brief Polling only, call JobSystem::wait before destroying the counter.
+       */
+      bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+      friend class JobSystem;
+
+      std::atomic<uint32_t> pending{0};
+
+      // Guards continuations and error. The last decrement happens under it too, so a waiter that takes it after
+      // seeing zero knows the finishing job is done with the counter
+      std::mutex mutex;
+      std::vector<std::pair<std::function<void()>, JobCounter*>> continuations;
+      std::exception_ptr error;
+    };
+
+    /**
+     * @brief Work stealing job scheduler with one deque per thread.
+     *
+     * A thread pushes and pops jobs at the back of its own deque, so related work stays on one core while it is hot
+     * in cache, and idle workers steal from the front of other deques. Threads outside the pool share one extra
+     * deque. Waiting on a counter never blocks a thread that could be working: it runs queued jobs until the
+     * counter is done, so jobs may spawn and wait on jobs of their own. Workers with nothing to do sleep on a
+     * condition variable.
+     *
+     * Every thread records how many jobs it ran and stole and how long it was busy, for utilization reports.
+     */
+    class JobSystem
+    {
+    public:
+      struct WorkerStats
+      {
+        uint64_t jobs = 0;
+        uint64_t steals = 0;      ///< Jobs taken from another thread's deque.
+        double busyMs = 0.0;      ///< Time spent inside jobs, a job waiting on others also counts theirs.
+        double utilization = 0.0; ///< Busy time over the wall time of the report window, 0 to 1.
+      };
+
+      /**
+       * @brief Process wide scheduler with one worker per hardware thread besides the calling one.
+       */
+      static JobSystem& get();
+
+      /**
+       * @param workerCount Threads to start. 0 is valid: every job then runs on the thread that waits for it.
+       */
+      explicit JobSystem(uint32_t workerCount);
+      ~JobSystem();
+
+      JobSystem(const JobSystem&) = delete;
+      JobSystem& operator=(const JobSystem&) = delete;
+
+      /**
+       * @brief Threads that can execute jobs: the workers plus the thread that waits.
+       */
+      uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+      /**
+       * @brief Index in [0, threadCount()) of the calling thread, for per thread resources indexed alike.
+       *
+       * Workers get their own index, every thread outside the pool shares the last one, so per thread resources are
+       * only safe to use without locking from the workers and one outside thread.
+       */
+      uint32_t currentThreadIndex() const { return static_cast<uint32_t>(currentSlot()); }
+
+      /**
+       * @brief Queues job on the calling thread's deque and counts it against counter, which may be null.
+       */
+      void run(std::function<void()> job, JobCounter* counter = nullptr);
+
+      /**
+       * @brief Queues a long running job that only workers take, once they have nothing else to do.
+       *
+       * wait never runs background jobs, so a frame waiting on its own short jobs is never held up behind one. With
+       * no workers background jobs never run, check threadCount first.
+       */
+      void runBackground(std::function<void()> job, JobCounter* counter = nullptr);
+
+      /**
+       * @brief Queues job once dependency is done, runs it straight away if it already is.
+       */
+      void runAfter(JobCounter& dependency, std::function<void()> job, JobCounter* counter = nullptr);
+
+      /**
+       * @brief Runs queued jobs on the calling thread until counter is done.
+       * @throws Rethrows the first exception thrown by a job counted against counter.
+       */
+      void wait(JobCounter& counter);
+
+      /**
+       * @brief Calls fn(begin, end) over [0, count) in batches spread across every thread, and waits for them.
+       * @param minBatchSize Smallest batch worth a job, below that the call runs inline.
+       * @param granularity Batch boundaries are multiples of this, e.g. a SIMD width.
+       */
+      template <typename Fn> void parallelFor(size_t count, size_t minBatchSize, Fn&& fn, size_t granularity = 1);
+
+      /**
+       * @brief Per thread statistics since the previous call, the last entry is the waiting (non worker) thread.
+       */
+      std::vector<WorkerStats> consumeStats();
+
+    private:
+      struct Job
+      {
+        std::function<void()> function;
+        JobCounter* counter = nullptr;
+      };
+
+      struct Worker
+      {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        std::thread thread;
+
+        std::atomic<uint64_t> jobsRun{0};
+        std::atomic<uint64_t> jobsStolen{0};
+        std::atomic<uint64_t> busyNs{0};
+      };
+
+      void push(Job job);
+      bool pop(size_t self, Job& job);
+      bool steal(size_t self, Job& job);
+      bool popBackground(Job& job);
+      void execute(size_t self, Job& job);
+      void finish(JobCounter* counter);
+      size_t currentSlot() const;
+      void workerLoop(size_t self);
+
+      // workers.size() + 1 slots, the last one is shared by every thread outside the pool
+      std::vector<std::unique_ptr<Worker>> slots;
+      std::vector<Worker*> workers;
+
+      std::mutex backgroundMutex;
+      std::deque<Job> backgroundJobs;
+
+      std::atomic<size_t> queuedJobs{0};
+      std::atomic<uint32_t> sleepers{0};
+      std::atomic<bool> stopping{false};
+      std::mutex sleepMutex;
+      std::condition_variable wakeUp;
+      uint64_t statsWindowStartNs;
+    };
+
+    template <typename Fn> void JobSystem::parallelFor(size_t count, size_t minBatchSize, Fn&& fn, size_t granularity)
+    {
+      if(count == 0) { return; }
+      if(threadCount() == 1)
+        {
+          fn(size_t{0}, count);
+          return;
+        }
+
+      // A few batches per thread lets fast threads steal from slow ones without drowning in job overhead
+      size_t batchCount = std::min<size_t>(count / std::max<size_t>(minBatchSize, 1), threadCount() * 4);
+      if(batchCount <= 1)
+        {
+          fn(size_t{0}, count);
+          return;
+        }
+
+      size_t batchSize = (count + batchCount - 1) / batchCount;
+      batchSize = (batchSize + granularity - 1) / granularity * granularity;
+
+      JobCounter counter;
+      for(size_t begin = 0; begin < count; begin += batchSize)
+        {
+          size_t end = std::min(begin + batchSize, count);
+          run([&fn, begin, end]() { fn(begin, end); }, &counter);
+        }
+      wait(counter);
+    }
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,222 @@
+#include "json.hpp"
+
+// std
+#include <charconv>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    static const JsonValue NULL_VALUE{};
+
+    /**
+     * @brief Recursive descent parser over a string_view, builds JsonValue trees.
+     */
+    class JsonParser
+    {
+    public:
+      explicit JsonParser(std::string_view text) : text{text} {}
+
+      JsonValue parseDocument()
+      {
+        JsonValue value = parseValue();
+        skipWhitespace();
+        if(position != text.size()) { fail("unexpected trailing characters"); }
+        return value;
+      }
+
+    private:
+      [[noreturn]] void fail(const char* message) const
+      {
+        throw std::runtime_error(std::string{"json parse error at byte "} + std::to_string(position) + ": " + message);
+      }
+
+      void skipWhitespace()
+      {
+        while(position < text.size() &&
+              (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r'))
+          {
+            position++;
+          }
+      }
+
+      char peek()
+      {
+        skipWhitespace();
+        if(position >= text.size()) { fail("unexpected end of input"); }
+        return text[position];
+      }
+
+      void expect(char c)
+      {
+        if(peek() != c) { fail("unexpected character"); }
+        position++;
+      }
+
+      bool consumeLiteral(std::string_view literal)
+      {
+        if(text.substr(position, literal.size()) != literal) { return false; }
+        position += literal.size();
+        return true;
+      }
+
+      JsonValue parseValue()
+      {
+        JsonValue value;
+        char c = peek();
+        if(c == '{') { parseObject(value); }
+        else if(c == '[') { parseArray(value); }
+        else if(c == '"')
+          {
+            value.valueType = JsonValue::Type::String;
+            value.string = parseString();
+          }
+        else if(consumeLiteral("true"))
+          {
+            value.valueType = JsonValue::Type::Bool;
+            value.boolean = true;
+          }
+        else if(consumeLiteral("false")) { value.valueType = JsonValue::Type::Bool; }
+        else if(consumeLiteral("null")) { value.valueType = JsonValue::Type::Null; }
+        else
+          {
+            value.valueType = JsonValue::Type::Number;
+            value.number = parseNumber();
+          }
+        return value;
+      }
+
+      void parseObject(JsonValue& value)
+      {
+        value.valueType = JsonValue::Type::Object;
+        expect('{');
+        if(peek() == '}')
+          {
+            position++;
+            return;
+          }
+        for(;;)
+          {
+            if(peek() != '"') { fail("expected object key"); }
+            std::string key = parseString();
+            expect(':');
+            value.object.emplace_back(std::move(key), parseValue());
+
+            char c = peek();
+            position++;
+            if(c == '}') { return; }
+            if(c != ',') { fail("expected ',' or '}'"); }
+          }
+      }
+
+      void parseArray(JsonValue& value)
+      {
+        value.valueType = JsonValue::Type::Array;
+        expect('[');
+        if(peek() == ']')
+          {
+            position++;
+            return;
+          }
+        for(;;)
+          {
+            value.array.push_back(parseValue());
+
+            char c = peek();
+            position++;
+            if(c == ']') { return; }
+            if(c != ',') { fail("expected ',' or ']'"); }
+          }
+      }
+
+      std::string parseString()
+      {
+        expect('"');
+        std::string result;
+        while(position < text.size() && text[position] != '"')
+          {
+            char c = text[position++];
+            if(c != '\\')
+              {
+                result += c;
+                continue;
+              }
+            if(position >= text.size()) { break; }
+
+            char escaped = text[position++];
+            switch(escaped)
+              {
+              case 'n': result += '\n'; break;
+              case 't': result += '\t'; break;
+              case 'r': result += '\r'; break;
+              case 'b': result += '\b'; break;
+              case 'f': result += '\f'; break;
+              case 'u':
+                {
+                  // Asset names are the only place this shows up, encode the code point as UTF-8
+                  if(position + 4 > text.size()) { fail("truncated unicode escape"); }
+                  unsigned codePoint = 0;
+                  std::from_chars(text.data() + position, text.data() + position + 4, codePoint, 16);
+                  position += 4;
+                  if(codePoint < 0x80) { result += static_cast<char>(codePoint); }
+                  else if(codePoint < 0x800)
+                    {
+                      result += static_cast<char>(0xC0 | (codePoint >> 6));
+                      result += static_cast<char>(0x80 | (codePoint & 0x3F));
+                    }
+                  else
+                    {
+                      result += static_cast<char>(0xE0 | (codePoint >> 12));
+                      result += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                      result += static_cast<char>(0x80 | (codePoint & 0x3F));
+                    }
+                  break;
+                }
+              default: result += escaped; break; // \" \\ and \/
+              }
+          }
+        if(position >= text.size()) { fail("unterminated string"); }
+        position++; // closing quote
+        return result;
+      }
+
+      double parseNumber()
+      {
+        double result = 0.0;
+        auto [end, error] = std::from_chars(text.data() + position, text.data() + text.size(), result);
+        if(error != std::errc{}) { fail("invalid number"); }
+        position = static_cast<size_t>(end - text.data());
+        return result;
+      }
+
+      std::string_view text;
+      size_t position = 0;
+    };
+
+    JsonValue JsonValue::parse(std::string_view text) { return JsonParser{text}.parseDocument(); }
+
+    const JsonValue& JsonValue::operator[](std::string_view key) const
+    {
+      if(valueType != Type::Object) { return NULL_VALUE; }
+      for(const auto& [name, value] : object)
+        {
+          if(name == key) { return value; }
+        }
+      return NULL_VALUE;
+    }
+
+    const JsonValue& JsonValue::operator[](size_t index) const
+    {
+      if(valueType != Type::Array || index >= array.size()) { return NULL_VALUE; }
+      return array[index];
+    }
+
+    double JsonValue::numberOr(std::string_view key, double fallback) const
+    {
+      const JsonValue& value = (*this)[key];
+      return value.type() == Type::Number ? value.number : fallback;
+    }
+
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,79 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief Minimal JSON document tree, enough for asset manifests such as glTF.
+     *
+     * Objects keep their members in file order and are searched linearly, which is fine for the small documents
+     * this is meant for. Binary payloads are never stored in here.
+     */
+    class JsonValue
+    {
+    public:
+      enum class Type
+      {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+      };
+
+      /**
+       * @brief Parses a complete JSON document.
+       * @throws std::runtime_error with the byte offset of the first syntax error.
+       */
+      static JsonValue parse(std::string_view text);
+
+      Type type() const { return valueType; }
+      bool isNull() const { return valueType == Type::Null; }
+
+      bool asBool() const { return boolean; }
+      double asNumber() const { return number; }
+      size_t asIndex() const { return static_cast<size_t>(number); }
+      const std::string& asString() const { return string; }
+      const std::vector<JsonValue>& asArray() const { return array; }
+
+      /**
+       * @brief Member lookup on objects.
+       * @return The member, or a shared null value if it is missing or this is not an object.
+       */
+      const JsonValue& operator[](std::string_view key) const;
+
+      /**
+       * @brief Element access on arrays.
+       * @return The element, or a shared null value if it is out of range or this is not an array.
+       */
+      const JsonValue& operator[](size_t index) const;
+
+      bool has(std::string_view key) const { return !(*this)[key].isNull(); }
+      size_t size() const { return valueType == Type::Array ? array.size() : object.size(); }
+
+      /**
+       * @brief Number member with a fallback for missing keys.
+       */
+      double numberOr(std::string_view key, double fallback) const;
+
+    private:
+      friend class JsonParser;
+
+      Type valueType = Type::Null;
+      bool boolean = false;
+      double number = 0.0;
+      std::string string;
+      std::vector<JsonValue> array;
+      std::vector<std::pair<std::string, JsonValue>> object;
+    };
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,207 @@
+#include "profiler.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    // Thread id used for GPU events in the trace, picked well away from the CPU thread ids
+    static constexpr uint32_t GPU_TRACE_THREAD_ID = 1000;
+
+    static void writeJsonString(std::ostream& out, const char* text)
+    {
+      out << '"';
+      for(const char* c = text; *c != '\0'; c++)
+        {
+          if(*c == '"' || *c == '\\') { out << '\\'; }
+          out << *c;
+        }
+      out << '"';
+    }
+
+    Profiler& Profiler::get()
+    {
+      static Profiler profiler;
+      return profiler;
+    }
+
+    Profiler::Profiler() : gpuBuffer{std::make_unique<EventBuffer>()} { gpuBuffer->threadId = GPU_TRACE_THREAD_ID; }
+
+    uint64_t Profiler::nowNs()
+    {
+      return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+    }
+
+    Profiler::EventBuffer& Profiler::threadBuffer()
+    {
+      // Cached per thread so only the first scope on a thread has to register its buffer
+      thread_local EventBuffer* buffer = nullptr;
+      if(buffer == nullptr)
+        {
+          std::lock_guard<std::mutex> lock{registryMutex};
+          threadBuffers.push_back(std::make_unique<EventBuffer>());
+          buffer = threadBuffers.back().get();
+          buffer->threadId = static_cast<uint32_t>(threadBuffers.size());
+        }
+      return *buffer;
+    }
+
+    void Profiler::pushEvent(EventBuffer& buffer, const ProfileEvent& event)
+    {
+      // Single writer per buffer, the release stores publish the event to endFrame/writeChromeTrace. A reader may
+      // still be copying the event this one replaces, the odd sequence (a seqlock) makes it drop that copy
+      uint64_t head = buffer.head.load(std::memory_order_relaxed);
+      EventSlot& slot = buffer.events[head % EVENTS_PER_THREAD];
+      slot.sequence.store(2 * head + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      slot.name.store(event.name, std::memory_order_relaxed);
+      slot.startNs.store(event.startNs, std::memory_order_relaxed);
+      slot.durationNs.store(event.durationNs, std::memory_order_relaxed);
+      slot.sequence.store(2 * head + 2, std::memory_order_release);
+      buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    bool Profiler::readEvent(const EventBuffer& buffer, uint64_t index, ProfileEvent& event)
+    {
+      const EventSlot& slot = buffer.events[index % EVENTS_PER_THREAD];
+      uint64_t expected = 2 * index + 2;
+      if(slot.sequence.load(std::memory_order_acquire) != expected) { return false; }
+
+      event.name = slot.name.load(std::memory_order_relaxed);
+      event.startNs = slot.startNs.load(std::memory_order_relaxed);
+      event.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+
+      // Still the same sequence after the copy, so the writer did not touch the slot in between
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return slot.sequence.load(std::memory_order_relaxed) == expected;
+    }
+
+    void Profiler::recordCpuEvent(const char* name, uint64_t startNs, uint64_t endNs)
+    {
+      pushEvent(threadBuffer(), {name, startNs, endNs - startNs});
+    }
+
+    void Profiler::recordGpuEvent(const char* name, uint64_t startNs, uint64_t durationNs)
+    {
+      if(!isEnabled()) { return; }
+      pushEvent(*gpuBuffer, {name, startNs, durationNs});
+    }
+
+    void Profiler::collectFrameTotals(EventBuffer& buffer, bool gpu)
+    {
+      uint64_t head = buffer.head.load(std::memory_order_acquire);
+      uint64_t first = std::max(buffer.statsCursor, head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0);
+
+      ProfileEvent event;
+      for(uint64_t i = first; i < head; i++)
+        {
+          if(!readEvent(buffer, i, event)) { continue; }
+          std::string key = event.name;
+          frameTotals[key] += static_cast<double>(event.durationNs) / 1e6;
+          rollingStats[key].gpu = gpu;
+        }
+      buffer.statsCursor = head;
+    }
+
+    void Profiler::endFrame()
+    {
+      frameTotals.clear();
+      {
+        std::lock_guard<std::mutex> lock{registryMutex};
+        for(auto& buffer : threadBuffers) { collectFrameTotals(*buffer, false); }
+      }
+      collectFrameTotals(*gpuBuffer, true);
+
+      for(auto& [name, totalMs] : frameTotals)
+        {
+          RollingStat& stat = rollingStats[name];
+          stat.samples[stat.next] = totalMs;
+          stat.next = (stat.next + 1) % STATS_WINDOW;
+          stat.count = std::min(stat.count + 1, STATS_WINDOW);
+        }
+    }
+
+    std::vector<PassStats> Profiler::getPassStats() const
+    {
+      std::vector<PassStats> result;
+      std::vector<double> sorted;
+
+      for(const auto& [name, stat] : rollingStats)
+        {
+          if(stat.count == 0) { continue; }
+
+          sorted.assign(stat.samples.begin(), stat.samples.begin() + stat.count);
+          std::sort(sorted.begin(), sorted.end());
+
+          PassStats stats;
+          stats.name = name;
+          stats.gpu = stat.gpu;
+          stats.sampleCount = static_cast<uint32_t>(stat.count);
+          stats.minMs = sorted.front();
+          for(double sample : sorted) { stats.avgMs += sample; }
+          stats.avgMs /= static_cast<double>(sorted.size());
+          stats.p99Ms = sorted[std::min(sorted.size() - 1, (sorted.size() * 99) / 100)];
+          result.push_back(stats);
+        }
+
+      std::sort(result.begin(), result.end(), [](const PassStats& a, const PassStats& b) {
+        return a.gpu != b.gpu ? !a.gpu : a.name < b.name;
+      });
+      return result;
+    }
+
+    void Profiler::writeChromeTrace(const std::string& filepath) const
+    {
+      std::ofstream file{filepath};
+      if(!file.is_open()) { throw std::runtime_error("failed to open trace file: " + filepath); }
+
+      file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+      bool firstEntry = true;
+      auto writeBuffer = [&](const EventBuffer& buffer, const char* threadName) {
+        if(!firstEntry) { file << ",\n"; }
+        firstEntry = false;
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.threadId
+             << ",\"args\":{\"name\":";
+        writeJsonString(file, threadName);
+        file << "}}";
+
+        uint64_t head = buffer.head.load(std::memory_order_acquire);
+        uint64_t first = head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0;
+        ProfileEvent event;
+        for(uint64_t i = first; i < head; i++)
+          {
+            if(!readEvent(buffer, i, event)) { continue; }
+            file << ",\n{\"name\":";
+            writeJsonString(file, event.name);
+            // Chrome trace timestamps and durations are in microseconds
+            file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer.threadId
+                 << ",\"ts\":" << static_cast<double>(event.startNs) / 1000.0
+                 << ",\"dur\":" << static_cast<double>(event.durationNs) / 1000.0 << "}";
+          }
+      };
+
+      {
+        std::lock_guard<std::mutex> lock{registryMutex};
+        for(const auto& buffer : threadBuffers)
+          {
+            std::string threadName = buffer->threadId == 1 ? "Main thread" : "Thread " + std::to_string(buffer->threadId);
+            writeBuffer(*buffer, threadName.c_str());
+          }
+      }
+      writeBuffer(*gpuBuffer, "GPU");
+
+      file << "\n]}\n";
+      if(!file) { throw std::runtime_error("failed to write trace file: " + filepath); }
+    }
+
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,170 @@
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief A single timed scope. Names are expected to be string literals and are never copied.
+     */
+    struct ProfileEvent
+    {
+      const char* name;
+      uint64_t startNs;
+      uint64_t durationNs;
+    };
+
+    /**
+     * @brief Rolling statistics of one named scope, summed per frame over the last STATS_WINDOW frames.
+     */
+    struct PassStats
+    {
+      std::string name;
+      bool gpu = false;
+      uint32_t sampleCount = 0;
+      double minMs = 0.0;
+      double avgMs = 0.0;
+      double p99Ms = 0.0;
+    };
+
+    /**
+     * @brief Low overhead CPU/GPU scope profiler.
+     *
+     * Every thread writes CPU scopes into its own fixed size ring buffer, so recording a scope is two clock reads and
+     * a few stores without any locking. GPU scopes are fed in by Graphics::GpuTimer once their timestamps are
+     * available. endFrame folds the frame's events into rolling per-pass statistics and writeChromeTrace dumps every
+     * buffered event as Chrome/Perfetto trace JSON. Both are meant to be called from the main thread between frames.
+     */
+    class Profiler
+    {
+    public:
+      static constexpr size_t EVENTS_PER_THREAD = 16384; // Ring capacity, the oldest events get overwritten
+      static constexpr size_t STATS_WINDOW = 240;        // Frames kept for the rolling min/avg/p99
+
+      static Profiler& get();
+      static uint64_t nowNs();
+
+      Profiler(const Profiler&) = delete;
+      Profiler& operator=(const Profiler&) = delete;
+
+      void setEnabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+      bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+      /**
+       * @brief Records a finished CPU scope into the calling thread's ring buffer.
+       */
+      void recordCpuEvent(const char* name, uint64_t startNs, uint64_t endNs);
+
+      /**
+       * @brief Records a finished GPU scope. Timestamps must already be converted to the CPU clock.
+       */
+      void recordGpuEvent(const char* name, uint64_t startNs, uint64_t durationNs);
+
+      /**
+       * @brief Sums the events recorded since the previous call per name and pushes them into the rolling stats.
+       */
+      void endFrame();
+
+      /**
+       * @brief Returns the rolling statistics of every scope seen so far, sorted by name with CPU scopes first.
+       */
+      std::vector<PassStats> getPassStats() const;
+
+      /**
+       * @brief Writes all buffered events as a Chrome trace (chrome://tracing, ui.perfetto.dev).
+       * @throws std::runtime_error if the file cannot be written.
+       */
+      void writeChromeTrace(const std::string& filepath) const;
+
+    private:
+      // One ring entry. The owning thread may overwrite it while the main thread reads it, so every field is atomic
+      // and sequence tells readers whether what they copied is the event they wanted
+      struct EventSlot
+      {
+        std::atomic<uint64_t> sequence{0}; // 2 * index + 2 once event index is complete, odd while being written
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> startNs{0};
+        std::atomic<uint64_t> durationNs{0};
+      };
+
+      struct EventBuffer
+      {
+        uint32_t threadId = 0;
+        std::array<EventSlot, EVENTS_PER_THREAD> events;
+        std::atomic<uint64_t> head{0}; // Total events ever written, the ring index is head % EVENTS_PER_THREAD
+        uint64_t statsCursor = 0;      // First event endFrame has not folded into the stats yet
+      };
+
+      struct RollingStat
+      {
+        bool gpu = false;
+        std::array<double, STATS_WINDOW> samples{};
+        size_t count = 0;
+        size_t next = 0;
+      };
+
+      Profiler();
+
+      EventBuffer& threadBuffer();
+      static void pushEvent(EventBuffer& buffer, const ProfileEvent& event);
+
+      /**
+       * @brief Copies event index out of buffer.
+       * @return false if the writer has overwritten it, or is overwriting it, by now.
+       */
+      static bool readEvent(const EventBuffer& buffer, uint64_t index, ProfileEvent& event);
+      void collectFrameTotals(EventBuffer& buffer, bool gpu);
+
+      std::atomic<bool> enabled{true};
+
+      // Guards registration of thread buffers only, recording never takes it
+      mutable std::mutex registryMutex;
+      std::vector<std::unique_ptr<EventBuffer>> threadBuffers;
+      std::unique_ptr<EventBuffer> gpuBuffer;
+
+      std::unordered_map<std::string, double> frameTotals;
+      std::unordered_map<std::string, RollingStat> rollingStats;
+    };
+
+    /**
+     * @brief RAII marker that records the time between construction and destruction as a CPU scope.
+     */
+    class ProfileScope
+    {
+    public:
+      explicit ProfileScope(const char* name)
+          : name{name}, startNs{Profiler::get().isEnabled() ? Profiler::nowNs() : 0}
+      {
+      }
+      ~ProfileScope()
+      {
+        if(startNs != 0) { Profiler::get().recordCpuEvent(name, startNs, Profiler::nowNs()); }
+      }
+
+      ProfileScope(const ProfileScope&) = delete;
+      ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+      const char* name;
+      uint64_t startNs;
+    };
+
+  } // namespace Core
+} // namespace GameEngine
+
+#define GE_PROFILE_CONCAT_INNER(a, b) a##b
+#define GE_PROFILE_CONCAT(a, b) GE_PROFILE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing block, name must be a string literal
+#define PROFILE_SCOPE(name) ::GameEngine::Core::ProfileScope GE_PROFILE_CONCAT(profileScope, __LINE__){name}
@@ -0,0 +1,290 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief Entity handle: the low 24 bits index the registry's slots, the high 8 bits are the slot's generation.
+     *
+     * The generation is bumped whenever a slot is destroyed, so stale handles to a recycled slot are detected.
+     */
+    using Entity = uint32_t;
+
+    static constexpr Entity NULL_ENTITY = std::numeric_limits<Entity>::max();
+
+    /**
+     * @brief Type erased interface so the registry can remove a destroyed entity from every pool.
+     */
+    class ComponentPoolBase
+    {
+    public:
+      virtual ~ComponentPoolBase() = default;
+      virtual void remove(Entity entity) = 0;
+      virtual bool contains(Entity entity) const = 0;
+      virtual size_t size() const = 0;
+    };
+
+    /**
+     * @brief Sparse set storing one component type in a densely packed array.
+     *
+     * sparse maps an entity index to its position in dense/components, dense maps back. Components are kept
+     * contiguous by moving the last element into the hole on removal, so iteration never skips gaps and never
+     * chases pointers. Component order is not stable across removals.
+     */
+    template <typename T> class ComponentPool final : public ComponentPoolBase
+    {
+    public:
+      static constexpr uint32_t INVALID = std::numeric_limits<uint32_t>::max();
+
+      template <typename... Args> T& emplace(Entity entity, Args&&... args)
+      {
+        version++;
+        uint32_t index = indexOf(entity);
+        if(index >= sparse.size()) { sparse.resize(std::max<size_t>(index + 1, sparse.size() * 2), INVALID); }
+
+        // Replace instead of duplicating if the entity already has one
+        if(sparse[index] != INVALID)
+          {
+            components[sparse[index]] = T{std::forward<Args>(args)...};
+            return components[sparse[index]];
+          }
+
+        sparse[index] = static_cast<uint32_t>(dense.size());
+        dense.push_back(entity);
+        components.push_back(T{std::forward<Args>(args)...});
+        return components.back();
+      }
+
+      void remove(Entity entity) override
+      {
+        if(!contains(entity)) { return; }
+        version++;
+
+        uint32_t position = sparse[indexOf(entity)];
+        uint32_t last = static_cast<uint32_t>(dense.size() - 1);
+        if(position != last)
+          {
+            dense[position] = dense[last];
+            components[position] = std::move(components[last]);
+            sparse[indexOf(dense[position])] = position;
+          }
+        dense.pop_back();
+        components.pop_back();
+        sparse[indexOf(entity)] = INVALID;
+      }
+
+      bool contains(Entity entity) const override
+      {
+        uint32_t index = indexOf(entity);
+        return index < sparse.size() && sparse[index] != INVALID && dense[sparse[index]] == entity;
+      }
+
+      size_t size() const override { return dense.size(); }
+
+      /**
+       * @brief Bumped by every emplace and remove, so systems caching per entity data can tell when to look again.
+       *
+       * Writes through get or tryGet do not count, replace a component with emplace when others must notice.
+       */
+      uint64_t getVersion() const { return version; }
+
+      T& get(Entity entity)
+      {
+        assert(contains(entity) && "Entity does not have this component");
+        return components[sparse[indexOf(entity)]];
+      }
+
+      T* tryGet(Entity entity) { return contains(entity) ? &components[sparse[indexOf(entity)]] : nullptr; }
+
+      // Dense arrays, entities()[i] owns components()[i]
+      const std::vector<Entity>& entities() const { return dense; }
+      std::vector<T>& data() { return components; }
+
+      void reserve(size_t count)
+      {
+        dense.reserve(count);
+        components.reserve(count);
+      }
+
+    private:
+      static uint32_t indexOf(Entity entity) { return entity & 0x00FFFFFF; }
+
+      std::vector<uint32_t> sparse;
+      std::vector<Entity> dense;
+      std::vector<T> components;
+      uint64_t version = 0;
+    };
+
+    /**
+     * @brief Iterates every entity owning all of Components.
+     *
+     * Walks the dense entity array of the smallest pool and looks the entity up in the others, so the cost is bound
+     * by the rarest component. A single component view walks the component array directly.
+     */
+    template <typename... Components> class View
+    {
+    public:
+      explicit View(ComponentPool<Components>&... pools) : pools{&pools...} {}
+
+      /**
+       * @brief Calls fn(entity, Components&...) for every matching entity.
+       */
+      template <typename Fn> void each(Fn&& fn)
+      {
+        if constexpr(sizeof...(Components) == 1)
+          {
+            auto& pool = *std::get<0>(pools);
+            const auto& entities = pool.entities();
+            auto& components = pool.data();
+            for(size_t i = 0; i < entities.size(); i++) { fn(entities[i], components[i]); }
+          }
+        else
+          {
+            const std::vector<Entity>& candidates = smallestPool();
+            for(Entity entity : candidates)
+              {
+                if((std::get<ComponentPool<Components>*>(pools)->contains(entity) && ...))
+                  {
+                    fn(entity, std::get<ComponentPool<Components>*>(pools)->get(entity)...);
+                  }
+              }
+          }
+      }
+
+      /**
+       * @brief Upper bound on the number of entities each visits.
+       */
+      size_t sizeHint() const { return smallestPool().size(); }
+
+    private:
+      const std::vector<Entity>& smallestPool() const
+      {
+        const std::vector<Entity>* smallest = nullptr;
+        ((smallest = (smallest == nullptr || std::get<ComponentPool<Components>*>(pools)->size() < smallest->size())
+                       ? &std::get<ComponentPool<Components>*>(pools)->entities()
+                       : smallest),
+         ...);
+        return *smallest;
+      }
+
+      std::tuple<ComponentPool<Components>*...> pools;
+    };
+
+    /**
+     * @brief Owns entities and one ComponentPool per component type.
+     *
+     * Components are plain structs, every type lives in its own contiguous array so systems only touch the data
+     * they need. Not thread safe: structural changes (create, destroy, emplace, remove) must not overlap iteration.
+     */
+    class Registry
+    {
+    public:
+      static constexpr uint32_t INDEX_BITS = 24;
+      static constexpr uint32_t MAX_ENTITIES = 1u << INDEX_BITS;
+
+      Entity create()
+      {
+        if(!freeSlots.empty())
+          {
+            uint32_t index = freeSlots.back();
+            freeSlots.pop_back();
+            return slots[index] = makeEntity(index, generations[index]);
+          }
+
+        // The last index is never handed out, with generation 0xFF it would equal NULL_ENTITY
+        assert(slots.size() < MAX_ENTITIES - 1 && "Registry is out of entity indices");
+        uint32_t index = static_cast<uint32_t>(slots.size());
+        slots.push_back(makeEntity(index, 0));
+        generations.push_back(0);
+        return slots.back();
+      }
+
+      void destroy(Entity entity)
+      {
+        if(!valid(entity)) { return; }
+
+        for(auto& pool : pools)
+          {
+            if(pool) { pool->remove(entity); }
+          }
+
+        // Bumping the generation makes every handle still pointing at this slot stale
+        uint32_t index = entity & (MAX_ENTITIES - 1);
+        generations[index]++;
+        slots[index] = NULL_ENTITY;
+        freeSlots.push_back(index);
+      }
+
+      bool valid(Entity entity) const
+      {
+        uint32_t index = entity & (MAX_ENTITIES - 1);
+        return entity != NULL_ENTITY && index < slots.size() && slots[index] == entity;
+      }
+
+      template <typename T, typename... Args> T& emplace(Entity entity, Args&&... args)
+      {
+        assert(valid(entity) && "Cannot add a component to a destroyed entity");
+        return pool<T>().emplace(entity, std::forward<Args>(args)...);
+      }
+
+      template <typename T> void remove(Entity entity) { pool<T>().remove(entity); }
+      template <typename T> bool has(Entity entity) { return pool<T>().contains(entity); }
+      template <typename T> T& get(Entity entity) { return pool<T>().get(entity); }
+      template <typename T> T* tryGet(Entity entity) { return pool<T>().tryGet(entity); }
+
+      template <typename... Components> View<Components...> view()
+      {
+        return View<Components...>{pool<Components>()...};
+      }
+
+      /**
+       * @brief Direct access to a component type's storage, for systems that stream over the dense array.
+       */
+      template <typename T> ComponentPool<T>& pool()
+      {
+        uint32_t id = componentId<T>();
+        if(id >= pools.size()) { pools.resize(id + 1); }
+        if(!pools[id]) { pools[id] = std::make_unique<ComponentPool<T>>(); }
+        return static_cast<ComponentPool<T>&>(*pools[id]);
+      }
+
+      size_t size() const { return slots.size() - freeSlots.size(); }
+
+    private:
+      static Entity makeEntity(uint32_t index, uint8_t generation)
+      {
+        return (static_cast<uint32_t>(generation) << INDEX_BITS) | index;
+      }
+
+      // Dense ids handed out on first use of each component type
+      static uint32_t nextComponentId()
+      {
+        static uint32_t counter = 0;
+        return counter++;
+      }
+
+      template <typename T> static uint32_t componentId()
+      {
+        static const uint32_t id = nextComponentId();
+        return id;
+      }
+
+      std::vector<Entity> slots;          // Handle of the entity living in each slot, NULL_ENTITY when free
+      std::vector<uint8_t> generations;  // Wraps after 256 reuses of a slot
+      std::vector<uint32_t> freeSlots;
+      std::vector<std::unique_ptr<ComponentPoolBase>> pools;
+    };
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,33 @@
+#include "simd.hpp"
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    SimdKernel bestSupportedSimdKernel()
+    {
+#ifdef GAME_ENGINE_X86
+      if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) { return SimdKernel::AVX2; }
+      return SimdKernel::SSE;
+#else
+      return SimdKernel::Scalar;
+#endif
+    }
+
+    const char* simdKernelName(SimdKernel kernel)
+    {
+      switch(kernel)
+        {
+        case SimdKernel::AVX2: return "avx2";
+        case SimdKernel::SSE: return "sse";
+        default: return "scalar";
+        }
+    }
+
+    SimdKernel supportedSimdKernel(SimdKernel requested)
+    {
+      SimdKernel best = bestSupportedSimdKernel();
+      return static_cast<int>(requested) <= static_cast<int>(best) ? requested : SimdKernel::Scalar;
+    }
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,33 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GAME_ENGINE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief Instruction sets the hand vectorized CPU kernels are written for, ordered from slowest to fastest.
+     */
+    enum class SimdKernel
+    {
+      Scalar,
+      SSE,
+      AVX2
+    };
+
+    /**
+     * @brief Best kernel the CPU supports, AVX2 needs FMA as well.
+     */
+    SimdKernel bestSupportedSimdKernel();
+    const char* simdKernelName(SimdKernel kernel);
+
+    /**
+     * @brief Returns requested if the CPU supports it and Scalar otherwise.
+     */
+    SimdKernel supportedSimdKernel(SimdKernel requested);
+  } // namespace Core
+} // namespace GameEngine
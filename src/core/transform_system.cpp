@@ -0,0 +1,532 @@
+#include "transform_system.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    static_assert(sizeof(glm::mat4) == 16 * sizeof(float), "kernels write matrices as 16 packed floats");
+
+    namespace
+    {
+      /**
+       * @brief Raw pointers into the SoA arrays, shared by every kernel.
+       */
+      struct TransformArrays
+      {
+        const float* translationX;
+        const float* translationY;
+        const float* translationZ;
+        const float* rotationX;
+        const float* rotationY;
+        const float* rotationZ;
+        const float* scaleX;
+        const float* scaleY;
+        const float* scaleZ;
+        float* matrices; // 16 floats per entity, column major like glm
+      };
+
+      // Same math as TransformComponent::mat4, c1/s1 = Y rotation, c2/s2 = X rotation, c3/s3 = Z rotation
+      void buildScalar(const TransformArrays& arrays, size_t begin, size_t end)
+      {
+        for(size_t i = begin; i < end; i++)
+          {
+            const float c3 = std::cos(arrays.rotationZ[i]);
+            const float s3 = std::sin(arrays.rotationZ[i]);
+            const float c2 = std::cos(arrays.rotationX[i]);
+            const float s2 = std::sin(arrays.rotationX[i]);
+            const float c1 = std::cos(arrays.rotationY[i]);
+            const float s1 = std::sin(arrays.rotationY[i]);
+            const float sx = arrays.scaleX[i];
+            const float sy = arrays.scaleY[i];
+            const float sz = arrays.scaleZ[i];
+
+            float* m = arrays.matrices + i * 16;
+            m[0] = sx * (c1 * c3 + s1 * s2 * s3);
+            m[1] = sx * (c2 * s3);
+            m[2] = sx * (c1 * s2 * s3 - c3 * s1);
+            m[3] = 0.0f;
+            m[4] = sy * (c3 * s1 * s2 - c1 * s3);
+            m[5] = sy * (c2 * c3);
+            m[6] = sy * (c1 * c3 * s2 + s1 * s3);
+            m[7] = 0.0f;
+            m[8] = sz * (c2 * s1);
+            m[9] = sz * (-s2);
+            m[10] = sz * (c1 * c2);
+            m[11] = 0.0f;
+            m[12] = arrays.translationX[i];
+            m[13] = arrays.translationY[i];
+            m[14] = arrays.translationZ[i];
+            m[15] = 1.0f;
+          }
+      }
+
+#ifdef GAME_ENGINE_X86
+      // sin/cos with Cody-Waite reduction to [-pi/4, pi/4] and Cephes minimax polynomials, max error about 1 ulp
+      // for the angles transforms see. Accuracy drops past a few thousand radians, keep rotations wrapped.
+      constexpr float TWO_OVER_PI = 0.636619772367581343f;
+      constexpr float PI_OVER_2_HI = 1.5703125f;
+      constexpr float PI_OVER_2_MID = 4.837512969970703125e-4f;
+      constexpr float PI_OVER_2_LO = 7.54978995489188216e-8f;
+      constexpr float SIN_C1 = -1.6666654611e-1f;
+      constexpr float SIN_C2 = 8.3321608736e-3f;
+      constexpr float SIN_C3 = -1.9515295891e-4f;
+      constexpr float COS_C1 = 4.166664568298827e-2f;
+      constexpr float COS_C2 = -1.388731625493765e-3f;
+      constexpr float COS_C3 = 2.443315711809948e-5f;
+
+      inline void sinCos4(__m128 x, __m128& sinOut, __m128& cosOut)
+      {
+        // cvtps rounds to nearest under the default MXCSR mode
+        __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+        __m128 q = _mm_cvtepi32_ps(quadrant);
+        __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(PI_OVER_2_HI)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PI_OVER_2_MID)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PI_OVER_2_LO)));
+        __m128 r2 = _mm_mul_ps(r, r);
+
+        __m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C3), r2), _mm_set1_ps(SIN_C2));
+        sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, r2), _mm_set1_ps(SIN_C1));
+        sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, r2), r), r);
+
+        __m128 cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_C3), r2), _mm_set1_ps(COS_C2));
+        cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, r2), _mm_set1_ps(COS_C1));
+        cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, r2), r2);
+        cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+        // Odd quadrants swap sin and cos, quadrants 2 and 3 negate sin, quadrants 1 and 2 negate cos
+        __m128i one = _mm_set1_epi32(1);
+        __m128i two = _mm_set1_epi32(2);
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+        __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+        __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+
+        __m128 s = _mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly));
+        __m128 c = _mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly));
+        sinOut = _mm_xor_ps(s, sinSign);
+        cosOut = _mm_xor_ps(c, cosSign);
+      }
+
+      // Full rebuilds stream past the cache: the matrices are only read again when they are copied for upload, and
+      // skipping the read for ownership halves the memory traffic of a 64 byte per entity output
+      template <bool Stream> inline void store4(float* destination, __m128 value)
+      {
+        if constexpr(Stream) { _mm_stream_ps(destination, value); }
+        else { _mm_storeu_ps(destination, value); }
+      }
+
+      template <bool Stream> void buildSSE(const TransformArrays& arrays, size_t begin, size_t end)
+      {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+
+        size_t i = begin;
+        for(; i + 4 <= end; i += 4)
+          {
+            __m128 s1, c1, s2, c2, s3, c3;
+            sinCos4(_mm_loadu_ps(arrays.rotationY + i), s1, c1);
+            sinCos4(_mm_loadu_ps(arrays.rotationX + i), s2, c2);
+            sinCos4(_mm_loadu_ps(arrays.rotationZ + i), s3, c3);
+            __m128 sx = _mm_loadu_ps(arrays.scaleX + i);
+            __m128 sy = _mm_loadu_ps(arrays.scaleY + i);
+            __m128 sz = _mm_loadu_ps(arrays.scaleZ + i);
+
+            __m128 s1s2 = _mm_mul_ps(s1, s2);
+            __m128 c1s2 = _mm_mul_ps(c1, s2);
+
+            // columns[j][k] is element k of column j for 4 entities at once
+            __m128 columns[4][4];
+            columns[0][0] = _mm_mul_ps(sx, _mm_add_ps(_mm_mul_ps(c1, c3), _mm_mul_ps(s1s2, s3)));
+            columns[0][1] = _mm_mul_ps(sx, _mm_mul_ps(c2, s3));
+            columns[0][2] = _mm_mul_ps(sx, _mm_sub_ps(_mm_mul_ps(c1s2, s3), _mm_mul_ps(c3, s1)));
+            columns[0][3] = zero;
+            columns[1][0] = _mm_mul_ps(sy, _mm_sub_ps(_mm_mul_ps(s1s2, c3), _mm_mul_ps(c1, s3)));
+            columns[1][1] = _mm_mul_ps(sy, _mm_mul_ps(c2, c3));
+            columns[1][2] = _mm_mul_ps(sy, _mm_add_ps(_mm_mul_ps(c1s2, c3), _mm_mul_ps(s1, s3)));
+            columns[1][3] = zero;
+            columns[2][0] = _mm_mul_ps(sz, _mm_mul_ps(c2, s1));
+            columns[2][1] = _mm_sub_ps(zero, _mm_mul_ps(sz, s2));
+            columns[2][2] = _mm_mul_ps(sz, _mm_mul_ps(c1, c2));
+            columns[2][3] = zero;
+            columns[3][0] = _mm_loadu_ps(arrays.translationX + i);
+            columns[3][1] = _mm_loadu_ps(arrays.translationY + i);
+            columns[3][2] = _mm_loadu_ps(arrays.translationZ + i);
+            columns[3][3] = one;
+
+            // Transposing each column's 4 registers gives that column for entity 0, 1, 2 and 3
+            float* out = arrays.matrices + i * 16;
+            for(int j = 0; j < 4; j++)
+              {
+                __m128 e0 = columns[j][0], e1 = columns[j][1], e2 = columns[j][2], e3 = columns[j][3];
+                _MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+                store4<Stream>(out + 0 * 16 + j * 4, e0);
+                store4<Stream>(out + 1 * 16 + j * 4, e1);
+                store4<Stream>(out + 2 * 16 + j * 4, e2);
+                store4<Stream>(out + 3 * 16 + j * 4, e3);
+              }
+          }
+
+        buildScalar(arrays, i, end);
+      }
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+
+      AVX2_TARGET inline void sinCos8(__m256 x, __m256& sinOut, __m256& cosOut)
+      {
+        __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+        __m256 q = _mm256_cvtepi32_ps(quadrant);
+        __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PI_OVER_2_HI), x);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PI_OVER_2_MID), r);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PI_OVER_2_LO), r);
+        __m256 r2 = _mm256_mul_ps(r, r);
+
+        __m256 sinPoly = _mm256_fmadd_ps(_mm256_set1_ps(SIN_C3), r2, _mm256_set1_ps(SIN_C2));
+        sinPoly = _mm256_fmadd_ps(sinPoly, r2, _mm256_set1_ps(SIN_C1));
+        sinPoly = _mm256_fmadd_ps(_mm256_mul_ps(sinPoly, r2), r, r);
+
+        __m256 cosPoly = _mm256_fmadd_ps(_mm256_set1_ps(COS_C3), r2, _mm256_set1_ps(COS_C2));
+        cosPoly = _mm256_fmadd_ps(cosPoly, r2, _mm256_set1_ps(COS_C1));
+        cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, r2), r2);
+        cosPoly = _mm256_add_ps(_mm256_fnmadd_ps(r2, _mm256_set1_ps(0.5f), cosPoly), _mm256_set1_ps(1.0f));
+
+        __m256i one = _mm256_set1_epi32(1);
+        __m256i two = _mm256_set1_epi32(2);
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+        __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+        __m256 cosSign =
+          _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+
+        sinOut = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, swap), sinSign);
+        cosOut = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, swap), cosSign);
+      }
+
+      template <bool Stream> AVX2_TARGET inline void store8(float* destination, __m256 value)
+      {
+        if constexpr(Stream) { _mm256_stream_ps(destination, value); }
+        else { _mm256_storeu_ps(destination, value); }
+      }
+
+      template <bool Stream> AVX2_TARGET void buildAVX2(const TransformArrays& arrays, size_t begin, size_t end)
+      {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        size_t i = begin;
+        for(; i + 8 <= end; i += 8)
+          {
+            __m256 s1, c1, s2, c2, s3, c3;
+            sinCos8(_mm256_loadu_ps(arrays.rotationY + i), s1, c1);
+            sinCos8(_mm256_loadu_ps(arrays.rotationX + i), s2, c2);
+            sinCos8(_mm256_loadu_ps(arrays.rotationZ + i), s3, c3);
+            __m256 sx = _mm256_loadu_ps(arrays.scaleX + i);
+            __m256 sy = _mm256_loadu_ps(arrays.scaleY + i);
+            __m256 sz = _mm256_loadu_ps(arrays.scaleZ + i);
+
+            __m256 s1s2 = _mm256_mul_ps(s1, s2);
+            __m256 c1s2 = _mm256_mul_ps(c1, s2);
+
+            __m256 columns[4][4];
+            columns[0][0] = _mm256_mul_ps(sx, _mm256_fmadd_ps(s1s2, s3, _mm256_mul_ps(c1, c3)));
+            columns[0][1] = _mm256_mul_ps(sx, _mm256_mul_ps(c2, s3));
+            columns[0][2] = _mm256_mul_ps(sx, _mm256_fmsub_ps(c1s2, s3, _mm256_mul_ps(c3, s1)));
+            columns[0][3] = zero;
+            columns[1][0] = _mm256_mul_ps(sy, _mm256_fmsub_ps(s1s2, c3, _mm256_mul_ps(c1, s3)));
+            columns[1][1] = _mm256_mul_ps(sy, _mm256_mul_ps(c2, c3));
+            columns[1][2] = _mm256_mul_ps(sy, _mm256_fmadd_ps(c1s2, c3, _mm256_mul_ps(s1, s3)));
+            columns[1][3] = zero;
+            columns[2][0] = _mm256_mul_ps(sz, _mm256_mul_ps(c2, s1));
+            columns[2][1] = _mm256_sub_ps(zero, _mm256_mul_ps(sz, s2));
+            columns[2][2] = _mm256_mul_ps(sz, _mm256_mul_ps(c1, c2));
+            columns[2][3] = zero;
+            columns[3][0] = _mm256_loadu_ps(arrays.translationX + i);
+            columns[3][1] = _mm256_loadu_ps(arrays.translationY + i);
+            columns[3][2] = _mm256_loadu_ps(arrays.translationZ + i);
+            columns[3][3] = one;
+
+            // In lane 4x4 transposes: transposed[j][e] holds column j of entity e in the low lane and of entity
+            // e + 4 in the high lane
+            __m256 transposed[4][4];
+            for(int j = 0; j < 4; j++)
+              {
+                __m256 t0 = _mm256_unpacklo_ps(columns[j][0], columns[j][1]);
+                __m256 t1 = _mm256_unpackhi_ps(columns[j][0], columns[j][1]);
+                __m256 t2 = _mm256_unpacklo_ps(columns[j][2], columns[j][3]);
+                __m256 t3 = _mm256_unpackhi_ps(columns[j][2], columns[j][3]);
+                transposed[j][0] = _mm256_shuffle_ps(t0, t2, 0x44);
+                transposed[j][1] = _mm256_shuffle_ps(t0, t2, 0xEE);
+                transposed[j][2] = _mm256_shuffle_ps(t1, t3, 0x44);
+                transposed[j][3] = _mm256_shuffle_ps(t1, t3, 0xEE);
+              }
+
+            // Pair up columns 0/1 and 2/3 so every store writes a full 32 bytes of one matrix
+            float* out = arrays.matrices + i * 16;
+            for(int e = 0; e < 4; e++)
+              {
+                store8<Stream>(out + e * 16, _mm256_permute2f128_ps(transposed[0][e], transposed[1][e], 0x20));
+                store8<Stream>(out + e * 16 + 8, _mm256_permute2f128_ps(transposed[2][e], transposed[3][e], 0x20));
+                store8<Stream>(out + (e + 4) * 16, _mm256_permute2f128_ps(transposed[0][e], transposed[1][e], 0x31));
+                store8<Stream>(out + (e + 4) * 16 + 8,
+                               _mm256_permute2f128_ps(transposed[2][e], transposed[3][e], 0x31));
+              }
+          }
+
+        buildSSE<Stream>(arrays, i, end);
+      }
+#endif
+    } // namespace
+
+    TransformSystem::TransformSystem() : kernel{bestSupportedKernel()} {}
+
+    void TransformSystem::setKernel(Kernel requested) { kernel = supportedSimdKernel(requested); }
+
+    uint32_t TransformSystem::indexOf(Entity entity) const
+    {
+      uint32_t index = entity & (Registry::MAX_ENTITIES - 1);
+      assert(index < sparse.size() && sparse[index] != INVALID && dense[sparse[index]] == entity &&
+             "Entity has no transform");
+      return sparse[index];
+    }
+
+    bool TransformSystem::contains(Entity entity) const
+    {
+      uint32_t index = entity & (Registry::MAX_ENTITIES - 1);
+      return index < sparse.size() && sparse[index] != INVALID && dense[sparse[index]] == entity;
+    }
+
+    void TransformSystem::add(Entity entity, const TransformComponent& transform)
+    {
+      if(contains(entity))
+        {
+          set(entity, transform);
+          return;
+        }
+
+      uint32_t index = entity & (Registry::MAX_ENTITIES - 1);
+      if(index >= sparse.size()) { sparse.resize(std::max<size_t>(index + 1, sparse.size() * 2), INVALID); }
+      sparse[index] = static_cast<uint32_t>(dense.size());
+      dense.push_back(entity);
+
+      translationX.push_back(transform.translation.x);
+      translationY.push_back(transform.translation.y);
+      translationZ.push_back(transform.translation.z);
+      rotationX.push_back(transform.rotation.x);
+      rotationY.push_back(transform.rotation.y);
+      rotationZ.push_back(transform.rotation.z);
+      scaleX.push_back(transform.scale.x);
+      scaleY.push_back(transform.scale.y);
+      scaleZ.push_back(transform.scale.z);
+      worldMatrices.emplace_back(1.0f);
+      dirtyFlags.push_back(0);
+
+      markDirty(sparse[index]);
+    }
+
+    void TransformSystem::remove(Entity entity)
+    {
+      if(!contains(entity)) { return; }
+      recordChange(entity);
+
+      uint32_t position = indexOf(entity);
+      uint32_t last = static_cast<uint32_t>(dense.size() - 1);
+      bool movedDirty = dirtyFlags[last] != 0;
+
+      auto moveLast = [position, last](auto& array) {
+        array[position] = array[last];
+        array.pop_back();
+      };
+      sparse[entity & (Registry::MAX_ENTITIES - 1)] = INVALID;
+      if(position != last) { sparse[dense[last] & (Registry::MAX_ENTITIES - 1)] = position; }
+      moveLast(dense);
+      moveLast(translationX);
+      moveLast(translationY);
+      moveLast(translationZ);
+      moveLast(rotationX);
+      moveLast(rotationY);
+      moveLast(rotationZ);
+      moveLast(scaleX);
+      moveLast(scaleY);
+      moveLast(scaleZ);
+      moveLast(worldMatrices);
+      moveLast(dirtyFlags);
+
+      // The dirty list may still hold last, update skips indices past the end. Re-flag the moved entity at its new
+      // position so it isn't lost
+      if(position != last)
+        {
+          dirtyFlags[position] = 0;
+          if(movedDirty) { markDirty(position); }
+        }
+    }
+
+    TransformComponent TransformSystem::get(Entity entity) const
+    {
+      uint32_t i = indexOf(entity);
+      TransformComponent transform{};
+      transform.translation = {translationX[i], translationY[i], translationZ[i]};
+      transform.rotation = {rotationX[i], rotationY[i], rotationZ[i]};
+      transform.scale = {scaleX[i], scaleY[i], scaleZ[i]};
+      return transform;
+    }
+
+    void TransformSystem::set(Entity entity, const TransformComponent& transform)
+    {
+      setTranslation(entity, transform.translation);
+      setRotation(entity, transform.rotation);
+      setScale(entity, transform.scale);
+    }
+
+    void TransformSystem::setTranslation(Entity entity, glm::vec3 translation)
+    {
+      uint32_t i = indexOf(entity);
+      translationX[i] = translation.x;
+      translationY[i] = translation.y;
+      translationZ[i] = translation.z;
+      markDirty(i);
+    }
+
+    void TransformSystem::setRotation(Entity entity, glm::vec3 rotation)
+    {
+      uint32_t i = indexOf(entity);
+      rotationX[i] = rotation.x;
+      rotationY[i] = rotation.y;
+      rotationZ[i] = rotation.z;
+      markDirty(i);
+    }
+
+    void TransformSystem::setScale(Entity entity, glm::vec3 scale)
+    {
+      uint32_t i = indexOf(entity);
+      scaleX[i] = scale.x;
+      scaleY[i] = scale.y;
+      scaleZ[i] = scale.z;
+      markDirty(i);
+    }
+
+    void TransformSystem::markDirty(uint32_t index)
+    {
+      if(dirtyFlags[index]) { return; }
+      dirtyFlags[index] = 1;
+      dirtyList.push_back(index);
+    }
+
+    void TransformSystem::markAllDirty() { allDirty = true; }
+
+    void TransformSystem::recordChange(Entity entity)
+    {
+      if(everythingChanged) { return; }
+
+      // Past the full rebuild fraction the consumer is better off looking at everything than at a long list, and
+      // the list stays bounded when nobody consumes it
+      if((changedList.size() + 1) * FULL_REBUILD_FRACTION > dense.size())
+        {
+          everythingChanged = true;
+          changedList.clear();
+        }
+      else { changedList.push_back(entity); }
+    }
+
+    void TransformSystem::clearChanges()
+    {
+      changedList.clear();
+      everythingChanged = false;
+    }
+
+    void TransformSystem::rebuild(size_t begin, size_t end, bool streaming)
+    {
+      TransformArrays arrays{translationX.data(), translationY.data(), translationZ.data(),
+                             rotationX.data(),    rotationY.data(),    rotationZ.data(),
+                             scaleX.data(),       scaleY.data(),       scaleZ.data(),
+                             reinterpret_cast<float*>(worldMatrices.data())};
+
+      switch(kernel)
+        {
+#ifdef GAME_ENGINE_X86
+        case Kernel::AVX2:
+          if(streaming) { buildAVX2<true>(arrays, begin, end); }
+          else { buildAVX2<false>(arrays, begin, end); }
+          break;
+        case Kernel::SSE:
+          if(streaming) { buildSSE<true>(arrays, begin, end); }
+          else { buildSSE<false>(arrays, begin, end); }
+          break;
+#endif
+        default: buildScalar(arrays, begin, end); break;
+        }
+
+#ifdef GAME_ENGINE_X86
+      // Non-temporal stores are weakly ordered, make them visible before anyone reads the matrices
+      if(streaming) { _mm_sfence(); }
+#endif
+    }
+
+    size_t TransformSystem::update()
+    {
+      size_t count = dense.size();
+      size_t rebuilt = 0;
+
+      // Past FULL_REBUILD_FRACTION the gap merging below touches nearly everything anyway, and one streaming pass
+      // is cheaper than that plus ordering the dirty list
+      if(allDirty || dirtyList.size() * FULL_REBUILD_FRACTION > count)
+        {
+          // Every range ends on a multiple of 8 so each job runs whole AVX2 batches, and fences its own stores
+          if(jobs)
+            {
+              jobs->parallelFor(
+                count, MIN_TRANSFORMS_PER_JOB, [this](size_t begin, size_t end) { rebuild(begin, end, true); }, 8);
+            }
+          else { rebuild(0, count, true); }
+          rebuilt = count;
+          std::fill(dirtyFlags.begin(), dirtyFlags.end(), 0);
+          everythingChanged = true;
+          changedList.clear();
+        }
+      else if(!dirtyList.empty())
+        {
+          // Ordering turns neighbouring dirty entities into runs the SIMD kernels can take whole. A linear pass over
+          // the flags beats sorting once more than a few entities per thousand are dirty
+          if(dirtyList.size() * 512 > count)
+            {
+              dirtyList.clear();
+              for(uint32_t i = 0; i < count; i++)
+                {
+                  if(dirtyFlags[i]) { dirtyList.push_back(i); }
+                }
+            }
+          else
+            {
+              std::sort(dirtyList.begin(), dirtyList.end());
+              dirtyList.erase(std::unique(dirtyList.begin(), dirtyList.end()), dirtyList.end());
+              while(!dirtyList.empty() && dirtyList.back() >= count) { dirtyList.pop_back(); }
+            }
+
+          // Clean entities in small gaps are rebuilt too, recomputing an unchanged matrix is cheaper than dropping
+          // to the scalar tail for every isolated dirty entity
+          size_t run = 0;
+          while(run < dirtyList.size())
+            {
+              size_t runEnd = run + 1;
+              while(runEnd < dirtyList.size() && dirtyList[runEnd] - dirtyList[runEnd - 1] <= MAX_RUN_GAP)
+                {
+                  runEnd++;
+                }
+              rebuild(dirtyList[run], dirtyList[runEnd - 1] + 1, false);
+              rebuilt += runEnd - run;
+              run = runEnd;
+            }
+          for(uint32_t index : dirtyList)
+            {
+              dirtyFlags[index] = 0;
+              recordChange(dense[index]);
+            }
+        }
+
+      dirtyList.clear();
+      allDirty = false;
+      return rebuilt;
+    }
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "components.hpp"
+#include "job_system.hpp"
+#include "registry.hpp"
+#include "simd.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Core
+  {
+    /**
+     * @brief Minimal allocator returning 64 byte aligned storage, so every matrix starts on its own cache line.
+     */
+    template <typename T> struct CacheLineAllocator
+    {
+      using value_type = T;
+      static constexpr std::align_val_t ALIGNMENT{64};
+
+      CacheLineAllocator() = default;
+      template <typename U> CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+      T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), ALIGNMENT)); }
+      void deallocate(T* pointer, size_t) { ::operator delete(pointer, ALIGNMENT); }
+
+      template <typename U> bool operator==(const CacheLineAllocator<U>&) const { return true; }
+    };
+
+    /**
+     * @brief Owns every entity's transform in structure of arrays form and keeps a packed array of model matrices.
+     *
+     * Translation, rotation and scale live in one float array per axis so the matrix kernels can load 4 (SSE) or
+     * 8 (AVX2) entities per instruction. Writes go through the setters, which mark the entity dirty, and update only
+     * rebuilds the matrices of dirty entities, so static objects cost nothing per frame. The matrices array is indexed
+     * like entities() and can be copied straight into a GPU buffer. Full rebuilds of large sets are split across the
+     * job system.
+     *
+     * Entities whose matrix update rebuilt, and entities removed, are recorded until clearChanges, so a consumer
+     * mirroring the matrices elsewhere (RenderSystem's GPU object buffer) only copies what changed. There is one such
+     * consumer.
+     *
+     * The matrix matches TransformComponent::mat4: Translate * Ry * Rx * Rz * Scale.
+     */
+    class TransformSystem
+    {
+    public:
+      using MatrixArray = std::vector<glm::mat4, CacheLineAllocator<glm::mat4>>;
+
+      using Kernel = SimdKernel;
+
+      TransformSystem();
+
+      /**
+       * @brief Adds a transform for entity, or overwrites the existing one. The entity starts dirty.
+       */
+      void add(Entity entity, const TransformComponent& transform = {});
+      void remove(Entity entity);
+      bool contains(Entity entity) const;
+
+      TransformComponent get(Entity entity) const;
+      void set(Entity entity, const TransformComponent& transform);
+      void setTranslation(Entity entity, glm::vec3 translation);
+      void setRotation(Entity entity, glm::vec3 rotation);
+      void setScale(Entity entity, glm::vec3 scale);
+
+      /**
+       * @brief Flags every transform dirty so the next update rebuilds all matrices in one pass.
+       */
+      void markAllDirty();
+
+      /**
+       * @brief Rebuilds the model matrix of every dirty entity with the active kernel.
+       * @return Number of matrices rebuilt.
+       */
+      size_t update();
+
+      /**
+       * @brief Entities whose matrix changed or that were removed since clearChanges, possibly more than once.
+       *
+       * Empty when allChanged, which replaces the list once it would name more than a full rebuild's share.
+       */
+      const std::vector<Entity>& changedEntities() const { return changedList; }
+      bool allChanged() const { return everythingChanged; }
+      void clearChanges();
+
+      const std::vector<Entity>& entities() const { return dense; }
+      const MatrixArray& matrices() const { return worldMatrices; }
+      const glm::mat4& getMatrix(Entity entity) const { return worldMatrices[indexOf(entity)]; }
+      size_t size() const { return dense.size(); }
+
+      static Kernel bestSupportedKernel() { return bestSupportedSimdKernel(); }
+      static const char* kernelName(Kernel kernel) { return simdKernelName(kernel); }
+
+      Kernel getKernel() const { return kernel; }
+
+      /**
+       * @brief Forces a kernel, mostly for benchmarking. Falls back to scalar if the CPU lacks support.
+       */
+      void setKernel(Kernel requested);
+
+      /**
+       * @brief Scheduler full rebuilds are split across, null rebuilds on the calling thread.
+       */
+      void setJobSystem(JobSystem* jobSystem) { jobs = jobSystem; }
+
+    private:
+      static constexpr uint32_t INVALID = 0xFFFFFFFF;
+      static constexpr uint32_t MAX_RUN_GAP = 8;            // One AVX2 batch
+      static constexpr size_t FULL_REBUILD_FRACTION = 16; // Rebuild everything once 1/16 of the entities are dirty
+      static constexpr size_t MIN_TRANSFORMS_PER_JOB = 16384;
+
+      uint32_t indexOf(Entity entity) const;
+      void markDirty(uint32_t index);
+      void recordChange(Entity entity);
+      void rebuild(size_t begin, size_t end, bool streaming);
+
+      Kernel kernel;
+      JobSystem* jobs = &JobSystem::get();
+
+      // Sparse entity index -> dense index, dense arrays below are all indexed the same way
+      std::vector<uint32_t> sparse;
+      std::vector<Entity> dense;
+
+      std::vector<float> translationX, translationY, translationZ;
+      std::vector<float> rotationX, rotationY, rotationZ;
+      std::vector<float> scaleX, scaleY, scaleZ;
+      MatrixArray worldMatrices; // Cache line aligned for the streaming stores of full rebuilds
+
+      std::vector<uint8_t> dirtyFlags;
+      std::vector<uint32_t> dirtyList;
+      bool allDirty = false;
+
+      // Changes since clearChanges, for the consumer of changedEntities
+      std::vector<Entity> changedList;
+      bool everythingChanged = false;
+    };
+  } // namespace Core
+} // namespace GameEngine
@@ -0,0 +1,50 @@
+#include "compute_pipeline.hpp"
+#include "deletion_queue.hpp"
+#include "pipeline_cache.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    ComputePipeline::ComputePipeline(VulkanDevice& device, const std::string& compFilepath,
+                                     VkPipelineLayout pipelineLayout, const SpecializationConstants& specialization)
+        : vulkanDevice{device}
+    {
+      assert(pipelineLayout != VK_NULL_HANDLE && "Cannot create compute pipeline: no pipelineLayout provided");
+
+      auto compShader = vulkanDevice.shaderRegistry().load(compFilepath);
+      VkSpecializationInfo specializationInfo = specialization.info();
+
+      VkComputePipelineCreateInfo pipelineInfo{};
+      pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+      pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+      pipelineInfo.stage.module = compShader->handle();
+      pipelineInfo.stage.pName = "main";
+      pipelineInfo.stage.pSpecializationInfo = specialization.empty() ? nullptr : &specializationInfo;
+      pipelineInfo.layout = pipelineLayout;
+      pipelineInfo.basePipelineIndex = -1;
+      pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+      if(vulkanDevice.pipelineCache().createComputePipeline(pipelineInfo, &computePipeline) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to create compute pipeline");
+        }
+    }
+
+    ComputePipeline::~ComputePipeline()
+    {
+      // Command buffers still in flight may have it bound
+      vulkanDevice.deletionQueue().releasePipeline(computePipeline);
+    }
+
+    void ComputePipeline::bind(VkCommandBuffer commandBuffer)
+    {
+      vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "shader_registry.hpp"
+#include "vulkan_device.hpp"
+
+// std
+#include <string>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief A compute pipeline built from one SPIR-V shader through the device's PipelineCache.
+     *
+     * Like GraphicsPipeline it is released through the DeletionQueue, so it can be dropped while frames that
+     * dispatched it are still on the GPU.
+     */
+    class ComputePipeline
+    {
+    public:
+      /**
+       * @param compFilepath SPIR-V compute shader, loaded through the device's ShaderRegistry.
+       * @param pipelineLayout Layout the shader's descriptor sets and push constants match, owned by the caller.
+       * @param specialization constant_id values baked into the shader, the shader's defaults when empty.
+       * @throws std::runtime_error if the pipeline cannot be created.
+       */
+      ComputePipeline(VulkanDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout,
+                      const SpecializationConstants& specialization = {});
+      ~ComputePipeline();
+
+      ComputePipeline(const ComputePipeline&) = delete;
+      ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+      void bind(VkCommandBuffer commandBuffer);
+
+    private:
+      VulkanDevice& vulkanDevice;
+      VkPipeline computePipeline;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
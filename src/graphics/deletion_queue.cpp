@@ -0,0 +1,125 @@
+#include "deletion_queue.hpp"
+#include "vulkan_device.hpp"
+
+// std
+#include <type_traits>
+#include <utility>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    DeletionQueue::DeletionQueue(VulkanDevice& device) : device{device} {}
+
+    DeletionQueue::~DeletionQueue() { flush(); }
+
+    void DeletionQueue::releaseBuffer(VkBuffer buffer, const Allocation& allocation)
+    {
+      push(BufferRelease{buffer, allocation});
+    }
+
+    void DeletionQueue::releaseImage(VkImage image, const Allocation& allocation)
+    {
+      push(ImageRelease{image, allocation});
+    }
+
+    void DeletionQueue::releaseImageView(VkImageView imageView) { push(ImageViewRelease{imageView}); }
+
+    void DeletionQueue::releasePipeline(VkPipeline pipeline) { push(PipelineRelease{pipeline}); }
+
+    void DeletionQueue::releasePipelineLayout(VkPipelineLayout pipelineLayout)
+    {
+      push(PipelineLayoutRelease{pipelineLayout});
+    }
+
+    void DeletionQueue::release(std::function<void()> release) { push(std::move(release)); }
+
+    void DeletionQueue::push(Resource resource)
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      pending.push_back({0, std::move(resource)});
+    }
+
+    void DeletionQueue::endFrame(uint64_t frameValue)
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      // Releases of earlier frames are tagged already, so only the untagged tail belongs to this one
+      for(auto it = pending.rbegin(); it != pending.rend() && it->value == 0; ++it) { it->value = frameValue; }
+    }
+
+    void DeletionQueue::collect(uint64_t completedValue)
+    {
+      {
+        std::lock_guard<std::mutex> lock{mutex};
+        // Queued in submit order so we can stop at the first one still in use or not yet submitted
+        while(!pending.empty() && pending.front().value != 0 && pending.front().value <= completedValue)
+          {
+            collectScratch.push_back(std::move(pending.front().resource));
+            pending.pop_front();
+          }
+      }
+      destroyAll(collectScratch);
+    }
+
+    void DeletionQueue::flush()
+    {
+      // A callback may release more, keep going until nothing is left
+      while(true)
+        {
+          {
+            std::lock_guard<std::mutex> lock{mutex};
+            if(pending.empty()) { return; }
+            for(auto& entry : pending) { collectScratch.push_back(std::move(entry.resource)); }
+            pending.clear();
+          }
+          destroyAll(collectScratch);
+        }
+    }
+
+    void DeletionQueue::destroyAll(std::vector<Resource>& resources)
+    {
+      for(auto& resource : resources) { destroy(resource); }
+
+      std::lock_guard<std::mutex> lock{mutex};
+      destroyed += resources.size();
+      resources.clear();
+    }
+
+    void DeletionQueue::destroy(Resource& resource)
+    {
+      std::visit(
+        [this](auto& released)
+        {
+          using T = std::decay_t<decltype(released)>;
+          if constexpr(std::is_same_v<T, BufferRelease>) { device.destroyBuffer(released.buffer, released.allocation); }
+          else if constexpr(std::is_same_v<T, ImageRelease>)
+            {
+              device.destroyImage(released.image, released.allocation);
+            }
+          else if constexpr(std::is_same_v<T, ImageViewRelease>)
+            {
+              vkDestroyImageView(device.device(), released.imageView, nullptr);
+            }
+          else if constexpr(std::is_same_v<T, PipelineRelease>)
+            {
+              vkDestroyPipeline(device.device(), released.pipeline, nullptr);
+            }
+          else if constexpr(std::is_same_v<T, PipelineLayoutRelease>)
+            {
+              vkDestroyPipelineLayout(device.device(), released.pipelineLayout, nullptr);
+            }
+          else { released(); }
+        },
+        resource);
+    }
+
+    DeletionQueue::Stats DeletionQueue::getStats() const
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      Stats stats{};
+      stats.pending = static_cast<uint32_t>(pending.size());
+      stats.destroyed = destroyed;
+      return stats;
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "memory_allocator.hpp"
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <variant>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    class VulkanDevice;
+
+    /**
+     * @brief Destroys GPU resources once the frames that could still reference them have completed.
+     *
+     * A release belongs to the frame being recorded when it is made, the one the Renderer submits next. After every
+     * submit the Renderer hands endFrame the graphics timeline value that frame signals, and collect destroys
+     * everything whose value the timeline has reached. Buffers and images are stored as plain handles, so dropping a
+     * mesh costs no allocation and no stall whichever frame it happens in.
+     *
+     * Safe to release from any thread. Without a Renderer nothing is collected until flush.
+     */
+    class DeletionQueue
+    {
+    public:
+      struct Stats
+      {
+        uint32_t pending = 0;   ///< Released but still waiting for their frame to complete.
+        uint64_t destroyed = 0; ///< Destroyed since the queue was created.
+      };
+
+      explicit DeletionQueue(VulkanDevice& device);
+
+      /**
+       * @brief Destroys whatever is left, the device must be idle by then.
+       */
+      ~DeletionQueue();
+
+      DeletionQueue(const DeletionQueue&) = delete;
+      DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+      /**
+       * @brief Defers VulkanDevice::destroyBuffer.
+       */
+      void releaseBuffer(VkBuffer buffer, const Allocation& allocation);
+
+      /**
+       * @brief Defers VulkanDevice::destroyImage.
+       */
+      void releaseImage(VkImage image, const Allocation& allocation);
+
+      void releaseImageView(VkImageView imageView);
+      void releasePipeline(VkPipeline pipeline);
+      void releasePipelineLayout(VkPipelineLayout pipelineLayout);
+
+      /**
+       * @brief Defers an arbitrary callback, for resources owned by objects that destroy them themselves.
+       */
+      void release(std::function<void()> release);
+
+      /**
+       * @brief Marks the frame being recorded as submitted, later releases belong to the next one.
+       * @param frameValue Graphics timeline value signaled by the submitted frame.
+       */
+      void endFrame(uint64_t frameValue);
+
+      /**
+       * @brief Destroys everything released during frames whose timeline value is at most completedValue.
+       */
+      void collect(uint64_t completedValue);
+
+      /**
+       * @brief Destroys everything released so far. Only valid while the device is idle.
+       */
+      void flush();
+
+      Stats getStats() const;
+
+    private:
+      struct BufferRelease
+      {
+        VkBuffer buffer;
+        Allocation allocation;
+      };
+
+      struct ImageRelease
+      {
+        VkImage image;
+        Allocation allocation;
+      };
+
+      // Wrapped because non-dispatchable handles are all uint64_t on 32 bit targets
+      struct ImageViewRelease
+      {
+        VkImageView imageView;
+      };
+
+      struct PipelineRelease
+      {
+        VkPipeline pipeline;
+      };
+
+      struct PipelineLayoutRelease
+      {
+        VkPipelineLayout pipelineLayout;
+      };
+
+      using Resource = std::variant<BufferRelease, ImageRelease, ImageViewRelease, PipelineRelease,
+                                    PipelineLayoutRelease, std::function<void()>>;
+
+      struct PendingRelease
+      {
+        uint64_t value; // Timeline value that must be reached before destroying, 0 until the frame is submitted
+        Resource resource;
+      };
+
+      void push(Resource resource);
+      void destroy(Resource& resource);
+
+      /**
+       * @brief Destroys the releases taken off the queue, outside the lock so callbacks may release again.
+       */
+      void destroyAll(std::vector<Resource>& resources);
+
+      VulkanDevice& device;
+
+      mutable std::mutex mutex;
+      std::deque<PendingRelease> pending; // In submit order, the releases of the frame being recorded at the back
+      std::vector<Resource> collectScratch; // Only touched by collect and flush, called from one thread
+      uint64_t destroyed = 0;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
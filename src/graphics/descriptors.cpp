@@ -0,0 +1,136 @@
+#include "descriptors.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    // Descriptor Set Layout Builder
+    DescriptorSetLayout::Builder& DescriptorSetLayout::Builder::addBinding(uint32_t binding,
+                                                                           VkDescriptorType descriptorType,
+                                                                           VkShaderStageFlags stageFlags,
+                                                                           uint32_t count)
+    {
+      assert(bindings.count(binding) == 0 && "Binding already in use");
+      VkDescriptorSetLayoutBinding layoutBinding{};
+      layoutBinding.binding = binding;
+      layoutBinding.descriptorType = descriptorType;
+      layoutBinding.descriptorCount = count;
+      layoutBinding.stageFlags = stageFlags;
+      bindings[binding] = layoutBinding;
+      return *this;
+    }
+
+    std::unique_ptr<DescriptorSetLayout> DescriptorSetLayout::Builder::build() const
+    {
+      return std::make_unique<DescriptorSetLayout>(vulkanDevice, bindings);
+    }
+
+    // Descriptor Set Layout
+    DescriptorSetLayout::DescriptorSetLayout(VulkanDevice& device,
+                                             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+        : vulkanDevice{device}, bindings{std::move(bindings)}
+    {
+      std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+      for(const auto& [binding, layoutBinding] : this->bindings) { setLayoutBindings.push_back(layoutBinding); }
+
+      VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
+      descriptorSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+      descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
+      descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
+
+      if(vkCreateDescriptorSetLayout(vulkanDevice.device(), &descriptorSetLayoutInfo, nullptr, &descriptorSetLayout) !=
+         VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to create descriptor set layout!");
+        }
+    }
+
+    DescriptorSetLayout::~DescriptorSetLayout()
+    {
+      vkDestroyDescriptorSetLayout(vulkanDevice.device(), descriptorSetLayout, nullptr);
+    }
+
+    // Descriptor Pool Builder
+    DescriptorPool::Builder& DescriptorPool::Builder::addPoolSize(VkDescriptorType descriptorType, uint32_t count)
+    {
+      poolSizes.push_back({descriptorType, count});
+      return *this;
+    }
+
+    DescriptorPool::Builder& DescriptorPool::Builder::setMaxSets(uint32_t count)
+    {
+      maxSets = count;
+      return *this;
+    }
+
+    std::unique_ptr<DescriptorPool> DescriptorPool::Builder::build() const
+    {
+      return std::make_unique<DescriptorPool>(vulkanDevice, maxSets, poolSizes);
+    }
+
+    // Descriptor Pool
+    DescriptorPool::DescriptorPool(VulkanDevice& device, uint32_t maxSets,
+                                   const std::vector<VkDescriptorPoolSize>& poolSizes)
+        : vulkanDevice{device}
+    {
+      VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+      descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+      descriptorPoolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+      descriptorPoolInfo.pPoolSizes = poolSizes.data();
+      descriptorPoolInfo.maxSets = maxSets;
+
+      if(vkCreateDescriptorPool(vulkanDevice.device(), &descriptorPoolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to create descriptor pool!");
+        }
+    }
+
+    DescriptorPool::~DescriptorPool() { vkDestroyDescriptorPool(vulkanDevice.device(), descriptorPool, nullptr); }
+
+    VkDescriptorSet DescriptorPool::allocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayout) const
+    {
+      VkDescriptorSetAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+      allocInfo.descriptorPool = descriptorPool;
+      allocInfo.descriptorSetCount = 1;
+      allocInfo.pSetLayouts = &descriptorSetLayout;
+
+      VkDescriptorSet descriptorSet;
+      if(vkAllocateDescriptorSets(vulkanDevice.device(), &allocInfo, &descriptorSet) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to allocate descriptor set!");
+        }
+      return descriptorSet;
+    }
+
+    // Descriptor Writer
+    DescriptorWriter& DescriptorWriter::writeBuffer(uint32_t binding, const VkDescriptorBufferInfo& bufferInfo)
+    {
+      assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
+      assert(setLayout.bindings.at(binding).descriptorCount == 1 && "Binding expects multiple descriptors");
+      bufferWrites.emplace_back(binding, bufferInfo);
+      return *this;
+    }
+
+    void DescriptorWriter::overwrite(VkDescriptorSet set)
+    {
+      std::vector<VkWriteDescriptorSet> writes(bufferWrites.size());
+      for(size_t i = 0; i < bufferWrites.size(); i++)
+        {
+          const auto& [binding, bufferInfo] = bufferWrites[i];
+          writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+          writes[i].dstSet = set;
+          writes[i].dstBinding = binding;
+          writes[i].descriptorType = setLayout.bindings.at(binding).descriptorType;
+          writes[i].descriptorCount = 1;
+          writes[i].pBufferInfo = &bufferInfo;
+        }
+      vkUpdateDescriptorSets(setLayout.vulkanDevice.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0,
+                             nullptr);
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "vulkan_device.hpp"
+
+// std lib headers
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief Owns a VkDescriptorSetLayout and remembers each binding so writers can check what they write.
+     */
+    class DescriptorSetLayout
+    {
+    public:
+      class Builder
+      {
+      public:
+        Builder(VulkanDevice& device) : vulkanDevice{device} {}
+
+        Builder& addBinding(uint32_t binding, VkDescriptorType descriptorType, VkShaderStageFlags stageFlags,
+                            uint32_t count = 1);
+        std::unique_ptr<DescriptorSetLayout> build() const;
+
+      private:
+        VulkanDevice& vulkanDevice;
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+      };
+
+      DescriptorSetLayout(VulkanDevice& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+      ~DescriptorSetLayout();
+
+      DescriptorSetLayout(const DescriptorSetLayout&) = delete;
+      DescriptorSetLayout& operator=(const DescriptorSetLayout&) = delete;
+
+      VkDescriptorSetLayout getDescriptorSetLayout() const { return descriptorSetLayout; }
+
+    private:
+      VulkanDevice& vulkanDevice;
+      VkDescriptorSetLayout descriptorSetLayout;
+      std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
+
+      friend class DescriptorWriter;
+    };
+
+    /**
+     * @brief Owns a VkDescriptorPool sized up front for the sets a system allocates.
+     */
+    class DescriptorPool
+    {
+    public:
+      class Builder
+      {
+      public:
+        Builder(VulkanDevice& device) : vulkanDevice{device} {}
+
+        Builder& addPoolSize(VkDescriptorType descriptorType, uint32_t count);
+        Builder& setMaxSets(uint32_t count);
+        std::unique_ptr<DescriptorPool> build() const;
+
+      private:
+        VulkanDevice& vulkanDevice;
+        std::vector<VkDescriptorPoolSize> poolSizes{};
+        uint32_t maxSets = 1;
+      };
+
+      DescriptorPool(VulkanDevice& device, uint32_t maxSets, const std::vector<VkDescriptorPoolSize>& poolSizes);
+      ~DescriptorPool();
+
+      DescriptorPool(const DescriptorPool&) = delete;
+      DescriptorPool& operator=(const DescriptorPool&) = delete;
+
+      /**
+       * @brief Allocates one set with the given layout.
+       * @throws std::runtime_error if the pool is exhausted.
+       */
+      VkDescriptorSet allocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayout) const;
+
+    private:
+      VulkanDevice& vulkanDevice;
+      VkDescriptorPool descriptorPool;
+    };
+
+    /**
+     * @brief Collects buffer writes for one descriptor set and applies them in a single vkUpdateDescriptorSets.
+     *
+     * The VkDescriptorBufferInfo structs are copied into the writer, so callers may pass temporaries.
+     */
+    class DescriptorWriter
+    {
+    public:
+      DescriptorWriter(const DescriptorSetLayout& setLayout) : setLayout{setLayout} {}
+
+      DescriptorWriter& writeBuffer(uint32_t binding, const VkDescriptorBufferInfo& bufferInfo);
+
+      /**
+       * @brief Writes everything collected so far into set. The set must not be in use by the GPU.
+       */
+      void overwrite(VkDescriptorSet set);
+
+    private:
+      const DescriptorSetLayout& setLayout;
+      std::vector<std::pair<uint32_t, VkDescriptorBufferInfo>> bufferWrites;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,96 @@
+#include "frame_command_pools.hpp"
+#include "vulkan_device.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    FrameCommandPools::FrameCommandPools(VulkanDevice& device, uint32_t threadCount) : vulkanDevice{device}
+    {
+      assert(threadCount > 0 && "Need at least one recording thread");
+
+      VkCommandPoolCreateInfo poolInfo{};
+      poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+      poolInfo.queueFamilyIndex = vulkanDevice.findPhysicalQueueFamilies().graphicsFamily;
+      // Buffers are only ever reset with their pool, so RESET_COMMAND_BUFFER_BIT is left off
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+      for(int frame = 0; frame < RenderTarget::MAX_FRAMES_IN_FLIGHT; frame++)
+        {
+          frames[frame].resize(threadCount);
+          for(ThreadPool& threadPool : frames[frame])
+            {
+              if(vkCreateCommandPool(vulkanDevice.device(), &poolInfo, nullptr, &threadPool.pool) != VK_SUCCESS)
+                {
+                  throw std::runtime_error("failed to create frame command pool!");
+                }
+            }
+
+          VkCommandBufferAllocateInfo allocInfo{};
+          allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+          allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+          allocInfo.commandPool = frames[frame].back().pool;
+          allocInfo.commandBufferCount = 1;
+
+          if(vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, &primaries[frame]) != VK_SUCCESS)
+            {
+              throw std::runtime_error("failed to allocate command buffers!");
+            }
+        }
+    }
+
+    FrameCommandPools::~FrameCommandPools()
+    {
+      // Destroying a pool frees every command buffer allocated from it
+      for(auto& threadPools : frames)
+        {
+          for(ThreadPool& threadPool : threadPools)
+            {
+              if(threadPool.pool != VK_NULL_HANDLE)
+                {
+                  vkDestroyCommandPool(vulkanDevice.device(), threadPool.pool, nullptr);
+                }
+            }
+        }
+    }
+
+    void FrameCommandPools::reset(int frameIndex)
+    {
+      for(ThreadPool& threadPool : frames[frameIndex])
+        {
+          if(vkResetCommandPool(vulkanDevice.device(), threadPool.pool, 0) != VK_SUCCESS)
+            {
+              throw std::runtime_error("failed to reset frame command pool!");
+            }
+          threadPool.used = 0;
+        }
+    }
+
+    VkCommandBuffer FrameCommandPools::acquireSecondary(int frameIndex, uint32_t threadIndex)
+    {
+      assert(threadIndex < getThreadCount() && "Thread index out of range");
+
+      ThreadPool& threadPool = frames[frameIndex][threadIndex];
+      if(threadPool.used == threadPool.secondaries.size())
+        {
+          VkCommandBufferAllocateInfo allocInfo{};
+          allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+          allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+          allocInfo.commandPool = threadPool.pool;
+          allocInfo.commandBufferCount = 1;
+
+          VkCommandBuffer commandBuffer;
+          if(vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+            {
+              throw std::runtime_error("failed to allocate secondary command buffer!");
+            }
+          threadPool.secondaries.push_back(commandBuffer);
+        }
+      return threadPool.secondaries[threadPool.used++];
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "render_target.hpp"
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    class VulkanDevice;
+
+    /**
+     * @brief One transient command pool per frame in flight and per recording thread.
+     *
+     * A command pool may only be used by one thread at a time, so every thread that records gets a pool of its own
+     * and no locking is needed. Pools are reset wholesale with vkResetCommandPool once the frame slot's last frame
+     * has been waited on, which is much cheaper than resetting buffers one by one, and the command buffers they
+     * allocated are kept and handed out again the next time the slot comes around.
+     *
+     * The frame's primary command buffer comes from the last thread's pool, the one JobSystem gives threads outside
+     * its pool.
+     */
+    class FrameCommandPools
+    {
+    public:
+      /**
+       * @param threadCount Recording threads, indexed like JobSystem::currentThreadIndex.
+       */
+      FrameCommandPools(VulkanDevice& device, uint32_t threadCount);
+      ~FrameCommandPools();
+
+      FrameCommandPools(const FrameCommandPools&) = delete;
+      FrameCommandPools& operator=(const FrameCommandPools&) = delete;
+
+      /**
+       * @brief Resets every pool of frameIndex, the slot's last frame must have been waited on.
+       */
+      void reset(int frameIndex);
+
+      /**
+       * @brief The frame slot's primary command buffer, in the initial state after reset.
+       */
+      VkCommandBuffer getPrimary(int frameIndex) const { return primaries[frameIndex]; }
+
+      /**
+       * @brief Returns a secondary command buffer, not yet begun, from threadIndex's pool of frameIndex.
+       *
+       * Only the thread owning threadIndex may call this for a given frame slot. Buffers are valid until the slot is
+       * reset.
+       */
+      VkCommandBuffer acquireSecondary(int frameIndex, uint32_t threadIndex);
+
+      uint32_t getThreadCount() const { return static_cast<uint32_t>(frames[0].size()); }
+
+    private:
+      // Written by one thread each, padded so neighbouring threads don't share a cache line
+      struct alignas(64) ThreadPool
+      {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> secondaries; // Allocated so far, reused after every reset
+        size_t used = 0;
+      };
+
+      VulkanDevice& vulkanDevice;
+      std::array<std::vector<ThreadPool>, RenderTarget::MAX_FRAMES_IN_FLIGHT> frames;
+      std::array<VkCommandBuffer, RenderTarget::MAX_FRAMES_IN_FLIGHT> primaries{};
+    };
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,66 @@
+#include "frame_ring.hpp"
+#include "deletion_queue.hpp"
+#include "vulkan_device.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    FrameRing::FrameRing(VulkanDevice& device)
+        : vulkanDevice{device},
+          descriptorAlignment{std::max(device.properties.limits.minUniformBufferOffsetAlignment,
+                                       device.properties.limits.minStorageBufferOffsetAlignment)}
+    {
+      for(int i = 0; i < RenderTarget::MAX_FRAMES_IN_FLIGHT; i++) { begin(i, INITIAL_CAPACITY); }
+    }
+
+    FrameRing::~FrameRing()
+    {
+      for(auto& frame : frames)
+        {
+          if(frame.buffer != VK_NULL_HANDLE)
+            {
+              vulkanDevice.deletionQueue().releaseBuffer(frame.buffer, frame.allocation);
+            }
+        }
+    }
+
+    bool FrameRing::begin(int frameIndex, VkDeviceSize bytes)
+    {
+      currentFrame = frameIndex;
+      head = 0;
+
+      Frame& frame = frames[frameIndex];
+      if(bytes <= frame.capacity) { return false; }
+
+      // The slot's last frame has been waited on, so the old buffer is no longer read by the GPU
+      if(frame.buffer != VK_NULL_HANDLE) { vulkanDevice.destroyBuffer(frame.buffer, frame.allocation); }
+
+      VkDeviceSize capacity = std::max(frame.capacity * 2, INITIAL_CAPACITY);
+      while(capacity < bytes) { capacity *= 2; }
+
+      // Rewritten every frame by the CPU and read once by the GPU, so host visible memory is cheaper than staging
+      VkMemoryPropertyFlags memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      vulkanDevice.createBuffer(capacity, USAGE, memoryFlags, frame.buffer, frame.allocation);
+      frame.capacity = capacity;
+      return true;
+    }
+
+    FrameRing::Slice FrameRing::allocate(VkDeviceSize size, VkDeviceSize alignment)
+    {
+      assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+
+      Frame& frame = frames[currentFrame];
+      VkDeviceSize offset = alignUp(head, alignment);
+      if(offset + size > frame.capacity) { throw std::runtime_error("frame ring out of space!"); }
+      head = offset + size;
+
+      return {frame.buffer, offset, static_cast<uint8_t*>(frame.allocation.mapped) + offset};
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "memory_allocator.hpp"
+#include "render_target.hpp"
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <array>
+#include <cstdint>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    class VulkanDevice;
+
+    /**
+     * @brief Persistently mapped, host visible buffer per frame in flight for data rewritten every frame.
+     *
+     * begin resets the frame slot's buffer and allocate hands out ranges of it linearly, so per frame uniforms, per
+     * draw data and instance data are written with a plain memcpy and no map/unmap or allocation on the hot path.
+     * Each buffer is created with uniform, storage, vertex and indirect usage so one ring serves dynamic uniform and
+     * storage descriptors, vertex bindings at an offset and indirect draw arguments written by compute shaders. It is
+     * also a transfer source, for updates copied into persistent DEVICE_LOCAL buffers inside the frame.
+     *
+     * A frame slot's buffer is only touched after that slot's last frame has been waited on, so the GPU is never
+     * reading what the CPU writes.
+     */
+    class FrameRing
+    {
+    public:
+      static constexpr VkDeviceSize INITIAL_CAPACITY = 256 * 1024;
+      static constexpr VkBufferUsageFlags USAGE = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                                  VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+      struct Slice
+      {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0; // Also the dynamic offset when bound through a *_DYNAMIC descriptor
+        void* data = nullptr;
+      };
+
+      FrameRing(VulkanDevice& device);
+      ~FrameRing();
+
+      FrameRing(const FrameRing&) = delete;
+      FrameRing& operator=(const FrameRing&) = delete;
+
+      /**
+       * @brief Starts writing frameIndex's buffer from the beginning, growing it first if it holds fewer than bytes.
+       * @return True if the buffer was recreated, descriptors pointing at it must be rewritten.
+       */
+      bool begin(int frameIndex, VkDeviceSize bytes);
+
+      /**
+       * @brief Reserves size bytes in the current frame's buffer at the given power of two alignment.
+       * @throws std::runtime_error if the frame's buffer is full, reserve enough in begin.
+       */
+      Slice allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+      /**
+       * @brief Offset alignment that satisfies both dynamic uniform and dynamic storage descriptors on this device.
+       */
+      VkDeviceSize getDescriptorAlignment() const { return descriptorAlignment; }
+
+      VkBuffer getBuffer(int frameIndex) const { return frames[frameIndex].buffer; }
+
+      /**
+       * @brief Mapped start of frameIndex's buffer, for reading what the GPU wrote into it once its frame completed.
+       *
+       * Only valid until the next begin for that slot, which may replace the buffer.
+       */
+      const void* getMappedData(int frameIndex) const { return frames[frameIndex].allocation.mapped; }
+
+      static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+      {
+        return (value + alignment - 1) & ~(alignment - 1);
+      }
+
+    private:
+      struct Frame
+      {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        Allocation allocation{};
+        VkDeviceSize capacity = 0;
+      };
+
+      VulkanDevice& vulkanDevice;
+      VkDeviceSize descriptorAlignment;
+
+      std::array<Frame, RenderTarget::MAX_FRAMES_IN_FLIGHT> frames{};
+      int currentFrame = 0;
+      VkDeviceSize head = 0;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,110 @@
+#include "gpu_timer.hpp"
+#include "../core/profiler.hpp"
+
+// std
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+
+    GpuTimer::GpuTimer(VulkanDevice& deviceRef, uint32_t framesInFlight) : device{deviceRef}
+    {
+      // Timestamps are only meaningful if the graphics queue reports valid bits for them
+      uint32_t queueFamilyCount = 0;
+      vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, nullptr);
+      std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+      vkGetPhysicalDeviceQueueFamilyProperties(device.getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+
+      uint32_t validBits = queueFamilies[device.findPhysicalQueueFamilies().graphicsFamily].timestampValidBits;
+      supported = validBits > 0 && device.properties.limits.timestampPeriod > 0.0f;
+      if(!supported) { return; }
+
+      timestampPeriodNs = static_cast<double>(device.properties.limits.timestampPeriod);
+      timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+      frames.resize(framesInFlight);
+      for(auto& frame : frames)
+        {
+          VkQueryPoolCreateInfo poolInfo{};
+          poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+          poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+          poolInfo.queryCount = MAX_SCOPES_PER_FRAME * 2;
+
+          if(vkCreateQueryPool(device.device(), &poolInfo, nullptr, &frame.queryPool) != VK_SUCCESS)
+            {
+              throw std::runtime_error("failed to create timestamp query pool!");
+            }
+          frame.scopeNames.reserve(MAX_SCOPES_PER_FRAME);
+        }
+      results.resize(MAX_SCOPES_PER_FRAME * 2);
+    }
+
+    GpuTimer::~GpuTimer()
+    {
+      for(auto& frame : frames) { vkDestroyQueryPool(device.device(), frame.queryPool, nullptr); }
+    }
+
+    void GpuTimer::beginFrame(VkCommandBuffer commandBuffer, int frameIndex)
+    {
+      if(!supported) { return; }
+
+      currentFrame = frameIndex;
+      FrameQueries& frame = frames[currentFrame];
+      collectResults(frame);
+
+      vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, MAX_SCOPES_PER_FRAME * 2);
+      frame.cpuAnchorNs = Core::Profiler::nowNs();
+    }
+
+    uint32_t GpuTimer::beginScope(VkCommandBuffer commandBuffer, const char* name)
+    {
+      if(!supported) { return INVALID_SCOPE; }
+
+      FrameQueries& frame = frames[currentFrame];
+      if(frame.scopeNames.size() >= MAX_SCOPES_PER_FRAME) { return INVALID_SCOPE; }
+
+      uint32_t scope = static_cast<uint32_t>(frame.scopeNames.size());
+      frame.scopeNames.push_back(name);
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, scope * 2);
+      return scope;
+    }
+
+    void GpuTimer::endScope(VkCommandBuffer commandBuffer, uint32_t scope)
+    {
+      if(scope == INVALID_SCOPE) { return; }
+      vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[currentFrame].queryPool,
+                          scope * 2 + 1);
+    }
+
+    void GpuTimer::collectResults(FrameQueries& frame)
+    {
+      if(frame.scopeNames.empty()) { return; }
+
+      uint32_t queryCount = static_cast<uint32_t>(frame.scopeNames.size()) * 2;
+      VkResult result = vkGetQueryPoolResults(device.device(), frame.queryPool, 0, queryCount,
+                                              queryCount * sizeof(uint64_t), results.data(), sizeof(uint64_t),
+                                              VK_QUERY_RESULT_64_BIT);
+
+      // VK_NOT_READY means the frame was never submitted (e.g. swap chain recreation), just drop its scopes
+      if(result == VK_SUCCESS)
+        {
+          uint64_t frameStart = results[0] & timestampMask;
+          for(size_t i = 0; i < frame.scopeNames.size(); i++)
+            {
+              uint64_t begin = results[i * 2] & timestampMask;
+              uint64_t end = results[i * 2 + 1] & timestampMask;
+              if(end < begin || begin < frameStart) { continue; } // Counter wrapped, skip this sample
+
+              auto startNs = frame.cpuAnchorNs + static_cast<uint64_t>((begin - frameStart) * timestampPeriodNs);
+              auto durationNs = static_cast<uint64_t>((end - begin) * timestampPeriodNs);
+              Core::Profiler::get().recordGpuEvent(frame.scopeNames[i], startNs, durationNs);
+            }
+        }
+
+      frame.scopeNames.clear();
+    }
+
+  } // namespace Graphics
+} // namespace GameEngine
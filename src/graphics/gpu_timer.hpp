@@ -0,0 +1,73 @@
+#pragma once
+
+#include "vulkan_device.hpp"
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief Timestamp queries around GPU passes, one VkQueryPool per frame in flight.
+     *
+     * Results of a frame slot are read back the next time that slot begins, at which point its last frame has already
+     * been waited on, so reading them never stalls. Finished scopes are handed to Core::Profiler as GPU events.
+     * Without calibrated timestamps the GPU clock is anchored to the CPU time the frame started recording, so GPU
+     * events line up with the CPU track approximately while their durations are exact.
+     */
+    class GpuTimer
+    {
+    public:
+      static constexpr uint32_t MAX_SCOPES_PER_FRAME = 32;
+      static constexpr uint32_t INVALID_SCOPE = UINT32_MAX;
+
+      GpuTimer(VulkanDevice& device, uint32_t framesInFlight);
+      ~GpuTimer();
+
+      GpuTimer(const GpuTimer&) = delete;
+      GpuTimer& operator=(const GpuTimer&) = delete;
+
+      bool isSupported() const { return supported; }
+
+      /**
+       * @brief Collects the previous results of this frame slot and resets its queries.
+       *
+       * Must be recorded outside of a render pass, before any scope of the frame.
+       */
+      void beginFrame(VkCommandBuffer commandBuffer, int frameIndex);
+
+      /**
+       * @brief Writes the start timestamp of a scope.
+       * @param name String literal naming the pass.
+       * @return Scope handle for endScope, INVALID_SCOPE if timestamps are unsupported or the frame is full.
+       */
+      uint32_t beginScope(VkCommandBuffer commandBuffer, const char* name);
+      void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    private:
+      struct FrameQueries
+      {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<const char*> scopeNames;
+        uint64_t cpuAnchorNs = 0;
+      };
+
+      void collectResults(FrameQueries& frame);
+
+      VulkanDevice& device;
+      bool supported = false;
+      double timestampPeriodNs = 1.0;
+      uint64_t timestampMask = ~0ull;
+
+      std::vector<FrameQueries> frames;
+      int currentFrame = 0;
+      std::vector<uint64_t> results;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
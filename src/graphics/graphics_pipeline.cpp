@@ -1,10 +1,10 @@
 #include "graphics_pipeline.hpp"
+#include "deletion_queue.hpp"
 
 #include "mesh.hpp"
 
 // std
 #include <cassert>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 
@@ -16,33 +16,25 @@ namespace GameEngine
                                        const std::string& fragFilepath, const PipelineConfigInfo& configInfo)
         : vulkanDevice{device}
     {
-      createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+      auto vertShader = vulkanDevice.shaderRegistry().load(vertFilepath);
+      auto fragShader = vulkanDevice.shaderRegistry().load(fragFilepath);
+      createGraphicsPipeline(*vertShader, *fragShader, configInfo);
     }
 
-    GraphicsPipeline::~GraphicsPipeline()
+    GraphicsPipeline::GraphicsPipeline(VulkanDevice& device, const ShaderModule& vertShader,
+                                       const ShaderModule& fragShader, const PipelineConfigInfo& configInfo)
+        : vulkanDevice{device}
     {
-      vkDestroyShaderModule(vulkanDevice.device(), vertShaderModule, nullptr);
-      vkDestroyShaderModule(vulkanDevice.device(), fragShaderModule, nullptr);
-      vkDestroyPipeline(vulkanDevice.device(), graphicsPipeline, nullptr);
+      createGraphicsPipeline(vertShader, fragShader, configInfo);
     }
 
-    std::vector<char> GraphicsPipeline::readFile(const std::string& filepath)
+    GraphicsPipeline::~GraphicsPipeline()
     {
-      std::ifstream file{filepath, std::ios::ate | std::ios::binary};
-
-      if(!file.is_open()) { throw std::runtime_error("failed to open file: " + filepath); }
-
-      size_t fileSize = static_cast<size_t>(file.tellg());
-      std::vector<char> buffer(fileSize);
-
-      file.seekg(0);
-      file.read(buffer.data(), fileSize);
-
-      file.close();
-      return buffer;
+      // Command buffers still in flight may have it bound
+      vulkanDevice.deletionQueue().releasePipeline(graphicsPipeline);
     }
 
-    void GraphicsPipeline::createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath,
+    void GraphicsPipeline::createGraphicsPipeline(const ShaderModule& vertShader, const ShaderModule& fragShader,
                                                   const PipelineConfigInfo& configInfo)
     {
       assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
@@ -50,30 +42,29 @@ namespace GameEngine
       assert(configInfo.renderPass != VK_NULL_HANDLE &&
              "Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-      auto vertCode = readFile(vertFilepath);
-      auto fragCode = readFile(fragFilepath);
-
-      createShaderModule(vertCode, &vertShaderModule);
-      createShaderModule(fragCode, &fragShaderModule);
+      VkSpecializationInfo vertSpecialization = configInfo.vertSpecialization.info();
+      VkSpecializationInfo fragSpecialization = configInfo.fragSpecialization.info();
 
       VkPipelineShaderStageCreateInfo shaderStages[2];
       shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
       shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-      shaderStages[0].module = vertShaderModule;
+      shaderStages[0].module = vertShader.handle();
       shaderStages[0].pName = "main";
       shaderStages[0].flags = 0;
       shaderStages[0].pNext = nullptr;
-      shaderStages[0].pSpecializationInfo = nullptr;
+      shaderStages[0].pSpecializationInfo =
+        configInfo.vertSpecialization.empty() ? nullptr : &vertSpecialization;
       shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
       shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-      shaderStages[1].module = fragShaderModule;
+      shaderStages[1].module = fragShader.handle();
       shaderStages[1].pName = "main";
       shaderStages[1].flags = 0;
       shaderStages[1].pNext = nullptr;
-      shaderStages[1].pSpecializationInfo = nullptr;
+      shaderStages[1].pSpecializationInfo =
+        configInfo.fragSpecialization.empty() ? nullptr : &fragSpecialization;
 
-      auto bindingDescriptions = Mesh::Vertex::getBindingDescriptions();
-      auto attributeDescriptions = Mesh::Vertex::getAttributeDescriptions();
+      auto& bindingDescriptions = configInfo.bindingDescriptions;
+      auto& attributeDescriptions = configInfo.attributeDescriptions;
       VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
       vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
       vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -101,26 +92,12 @@ namespace GameEngine
       pipelineInfo.basePipelineIndex = -1;
       pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-      if(vkCreateGraphicsPipelines(vulkanDevice.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
-                                   &graphicsPipeline) != VK_SUCCESS)
+      if(vulkanDevice.pipelineCache().createGraphicsPipeline(pipelineInfo, &graphicsPipeline) != VK_SUCCESS)
         {
           throw std::runtime_error("failed to create graphics pipeline");
         }
     }
 
-    void GraphicsPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
-    {
-      VkShaderModuleCreateInfo createInfo{};
-      createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-      createInfo.codeSize = code.size();
-      createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-      if(vkCreateShaderModule(vulkanDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS)
-        {
-          throw std::runtime_error("failed to create shader module");
-        }
-    }
-
     void GraphicsPipeline::bind(VkCommandBuffer commandBuffer)
     {
       vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
@@ -194,6 +171,9 @@ namespace GameEngine
       configInfo.dynamicStateInfo.pDynamicStates = configInfo.dynamicStateEnables.data();
       configInfo.dynamicStateInfo.dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
       configInfo.dynamicStateInfo.flags = 0;
+
+      configInfo.bindingDescriptions = Mesh::Vertex::getBindingDescriptions();
+      configInfo.attributeDescriptions = Mesh::Vertex::getAttributeDescriptions();
     }
 
   } // namespace Graphics
@@ -3,6 +3,7 @@
 
 // TODO: Make Doxygen comments in this file
 
+#include "render_target.hpp"
 #include "vulkan_device.hpp"
 
 // std
@@ -30,8 +31,17 @@ namespace GameEngine
       std::vector<VkDynamicState> dynamicStateEnables;
       VkPipelineDynamicStateCreateInfo dynamicStateInfo;
 
+      // Defaults to Mesh::Vertex at binding 0, systems append per instance bindings after it
+      std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+      std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+      // constant_id values baked into each stage, left empty the shaders' own defaults are used
+      SpecializationConstants vertSpecialization{};
+      SpecializationConstants fragSpecialization{};
+
       VkPipelineLayout pipelineLayout = nullptr;
       VkRenderPass renderPass = nullptr;
+      RenderPassFormats renderPassFormats{}; // What renderPass is compatible with, only used to key PipelineLibrary
       uint32_t subpass = 0;
     };
 
@@ -41,6 +51,12 @@ namespace GameEngine
       GraphicsPipeline(VulkanDevice& device, const std::string& vertFilepath, const std::string& fragFilepath,
                        const PipelineConfigInfo& configInfo);
 
+      /**
+       * @brief Builds from modules the caller already loaded from the device's ShaderRegistry.
+       */
+      GraphicsPipeline(VulkanDevice& device, const ShaderModule& vertShader, const ShaderModule& fragShader,
+                       const PipelineConfigInfo& configInfo);
+
       ~GraphicsPipeline();
 
       GraphicsPipeline(const GraphicsPipeline&) = delete;
@@ -52,22 +68,12 @@ namespace GameEngine
       static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 
     private:
-      /* @breif Read in a file
-       *
-       *@param (filepath) reads in a shader file path
-       */
-      static std::vector<char> readFile(const std::string& filepath);
-
       // Helper Function
-      void createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath,
+      void createGraphicsPipeline(const ShaderModule& vertShader, const ShaderModule& fragShader,
                                   const PipelineConfigInfo& configInfo);
 
-      void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule /*pointer to a pointer*/);
-
       VulkanDevice& vulkanDevice;
       VkPipeline graphicsPipeline;
-      VkShaderModule vertShaderModule;
-      VkShaderModule fragShaderModule;
     };
   } // namespace Graphics
 } // namespace GameEngine
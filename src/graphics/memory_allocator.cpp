@@ -0,0 +1,305 @@
+#include "memory_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+
+    MemoryBlock::MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, void* mapped)
+        : memory{memory}, size{size}, memoryTypeIndex{memoryTypeIndex}, mapped{static_cast<uint8_t*>(mapped)}
+    {
+      maxOrder = 0;
+      while(orderSize(maxOrder + 1) <= size) { maxOrder++; }
+
+      // The whole block starts out as one free range of the highest order
+      freeLists.resize(maxOrder + 1);
+      freeLists[maxOrder].insert(0);
+    }
+
+    bool MemoryBlock::allocate(uint32_t order, VkDeviceSize& offset)
+    {
+      if(order > maxOrder) { return false; }
+
+      // Smallest free range that fits, split down until it matches the requested order
+      uint32_t current = order;
+      while(current <= maxOrder && freeLists[current].empty()) { current++; }
+      if(current > maxOrder) { return false; }
+
+      offset = *freeLists[current].begin();
+      freeLists[current].erase(freeLists[current].begin());
+
+      while(current > order)
+        {
+          current--;
+          freeLists[current].insert(offset + orderSize(current));
+        }
+
+      usedBytes += orderSize(order);
+      allocationCount++;
+      return true;
+    }
+
+    void MemoryBlock::free(VkDeviceSize offset, uint32_t order)
+    {
+      usedBytes -= orderSize(order);
+      allocationCount--;
+
+      // Merge with the buddy for as long as it is free too
+      while(order < maxOrder)
+        {
+          VkDeviceSize buddy = offset ^ orderSize(order);
+          auto it = freeLists[order].find(buddy);
+          if(it == freeLists[order].end()) { break; }
+
+          freeLists[order].erase(it);
+          offset = std::min(offset, buddy);
+          order++;
+        }
+      freeLists[order].insert(offset);
+    }
+
+    VkDeviceSize MemoryBlock::largestFreeRange() const
+    {
+      for(uint32_t order = maxOrder + 1; order > 0; order--)
+        {
+          if(!freeLists[order - 1].empty()) { return orderSize(order - 1); }
+        }
+      return 0;
+    }
+
+    MemoryAllocator::MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device) : device{device}
+    {
+      vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    }
+
+    MemoryAllocator::~MemoryAllocator()
+    {
+      for(auto& pool : pools)
+        {
+          for(auto& block : pool.blocks)
+            {
+              freeDeviceMemory(block->memory, block->mapped != nullptr);
+            }
+        }
+    }
+
+    Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                         bool linear)
+    {
+      uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+
+      std::lock_guard<std::mutex> lock{mutex};
+
+      VkDeviceSize blockSize = blockSizeFor(memoryTypeIndex);
+      if(requirements.size >= std::min(DEDICATED_THRESHOLD, blockSize / 2))
+        {
+          return allocateDedicated(requirements, memoryTypeIndex);
+        }
+
+      // Buddy ranges are aligned to their own size, so covering the alignment covers the alignment requirement
+      VkDeviceSize needed = std::max(requirements.size, requirements.alignment);
+      uint32_t order = 0;
+      while(MemoryBlock::orderSize(order) < needed) { order++; }
+
+      Allocation allocation{};
+      Pool& pool = pools[memoryTypeIndex * 2 + (linear ? 1 : 0)];
+
+      MemoryBlock* block = nullptr;
+      for(auto& candidate : pool.blocks)
+        {
+          if(candidate->allocate(order, allocation.offset))
+            {
+              block = candidate.get();
+              break;
+            }
+        }
+
+      if(block == nullptr)
+        {
+          void* mapped = nullptr;
+          VkDeviceMemory memory = allocateDeviceMemory(blockSize, memoryTypeIndex, &mapped);
+          pool.blocks.push_back(std::make_unique<MemoryBlock>(memory, blockSize, memoryTypeIndex, mapped));
+          block = pool.blocks.back().get();
+          if(!block->allocate(order, allocation.offset))
+            {
+              throw std::runtime_error("failed to sub-allocate from a new memory block!");
+            }
+        }
+
+      block->requestedBytes += requirements.size;
+
+      allocation.memory = block->memory;
+      allocation.size = requirements.size;
+      allocation.mapped = block->mapped != nullptr ? block->mapped + allocation.offset : nullptr;
+      allocation.block = block;
+      allocation.order = order;
+      allocation.memoryTypeIndex = memoryTypeIndex;
+      return allocation;
+    }
+
+    void MemoryAllocator::free(Allocation& allocation)
+    {
+      if(allocation.memory == VK_NULL_HANDLE) { return; }
+
+      std::lock_guard<std::mutex> lock{mutex};
+
+      if(allocation.block == nullptr)
+        {
+          freeDeviceMemory(allocation.memory, allocation.mapped != nullptr);
+          dedicatedCounts[allocation.memoryTypeIndex]--;
+          dedicatedBytes[allocation.memoryTypeIndex] -= allocation.size;
+          allocation = {};
+          return;
+        }
+
+      MemoryBlock* block = allocation.block;
+      block->free(allocation.offset, allocation.order);
+      block->requestedBytes -= allocation.size;
+
+      // Hand empty blocks back to the driver but keep the last one of a pool around to avoid churn
+      if(block->isEmpty())
+        {
+          uint32_t memoryTypeIndex = block->memoryTypeIndex;
+          for(uint32_t linear = 0; linear < 2; linear++)
+            {
+              auto& blocks = pools[memoryTypeIndex * 2 + linear].blocks;
+              auto it = std::find_if(blocks.begin(), blocks.end(), [block](auto& b) { return b.get() == block; });
+              if(it == blocks.end()) { continue; }
+
+              if(blocks.size() > 1)
+                {
+                  freeDeviceMemory(block->memory, block->mapped != nullptr);
+                  blocks.erase(it);
+                }
+              break;
+            }
+        }
+
+      allocation = {};
+    }
+
+    std::vector<HeapStats> MemoryAllocator::getHeapStats() const
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+
+      std::vector<HeapStats> stats(memoryProperties.memoryHeapCount);
+      // Fragmentation is measured inside each block, separate blocks are never contiguous and don't count against it
+      std::vector<VkDeviceSize> freeBytes(memoryProperties.memoryHeapCount, 0);
+      std::vector<VkDeviceSize> contiguousFreeBytes(memoryProperties.memoryHeapCount, 0);
+      for(uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++)
+        {
+          stats[heap].heapIndex = heap;
+          stats[heap].heapSize = memoryProperties.memoryHeaps[heap].size;
+          stats[heap].deviceLocal = memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+        }
+
+      for(uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++)
+        {
+          HeapStats& heap = stats[memoryProperties.memoryTypes[type].heapIndex];
+          VkDeviceSize& heapFree = freeBytes[heap.heapIndex];
+          VkDeviceSize& heapContiguousFree = contiguousFreeBytes[heap.heapIndex];
+
+          for(uint32_t linear = 0; linear < 2; linear++)
+            {
+              for(const auto& block : pools[type * 2 + linear].blocks)
+                {
+                  heap.blockCount++;
+                  heap.allocationCount += block->allocationCount;
+                  heap.reservedBytes += block->size;
+                  heap.usedBytes += block->usedBytes;
+                  heap.requestedBytes += block->requestedBytes;
+                  VkDeviceSize largestFree = block->largestFreeRange();
+                  heap.largestFreeRange = std::max(heap.largestFreeRange, largestFree);
+                  heapContiguousFree += largestFree;
+                  heapFree += block->freeBytes();
+                }
+            }
+
+          heap.dedicatedCount += dedicatedCounts[type];
+          heap.allocationCount += dedicatedCounts[type];
+          heap.reservedBytes += dedicatedBytes[type];
+          heap.usedBytes += dedicatedBytes[type];
+          heap.requestedBytes += dedicatedBytes[type];
+        }
+
+      for(auto& heap : stats)
+        {
+          VkDeviceSize heapFree = freeBytes[heap.heapIndex];
+          if(heapFree > 0)
+            {
+              heap.fragmentation = 1.0f - static_cast<float>(contiguousFreeBytes[heap.heapIndex]) /
+                                            static_cast<float>(heapFree);
+            }
+        }
+      return stats;
+    }
+
+    uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+    {
+      for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+        {
+          if((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+            {
+              return i;
+            }
+        }
+
+      throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    VkDeviceSize MemoryAllocator::blockSizeFor(uint32_t memoryTypeIndex) const
+    {
+      // Small heaps (e.g. the 256MB BAR heap) get smaller blocks so one block can't eat a big share of the heap
+      VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+      VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE;
+      while(blockSize > heapSize / 8 && blockSize > MemoryBlock::MIN_ALLOCATION * 4096) { blockSize /= 2; }
+      return blockSize;
+    }
+
+    VkDeviceMemory MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped)
+    {
+      VkMemoryAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocInfo.allocationSize = size;
+      allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+      VkDeviceMemory memory;
+      if(vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to allocate device memory!");
+        }
+      deviceAllocationCount++;
+
+      *mapped = nullptr;
+      if(memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+          vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+        }
+      return memory;
+    }
+
+    void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, bool mapped)
+    {
+      if(mapped) { vkUnmapMemory(device, memory); }
+      vkFreeMemory(device, memory, nullptr);
+      deviceAllocationCount--;
+    }
+
+    Allocation MemoryAllocator::allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex)
+    {
+      Allocation allocation{};
+      allocation.memory = allocateDeviceMemory(requirements.size, memoryTypeIndex, &allocation.mapped);
+      allocation.size = requirements.size;
+      allocation.memoryTypeIndex = memoryTypeIndex;
+
+      dedicatedCounts[memoryTypeIndex]++;
+      dedicatedBytes[memoryTypeIndex] += requirements.size;
+      return allocation;
+    }
+
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,153 @@
+#pragma once
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    class MemoryBlock;
+
+    /**
+     * @brief A range of device memory handed out by the MemoryAllocator.
+     *
+     * Bind resources with memory + offset. Host visible allocations are persistently mapped, mapped then points at
+     * the first byte of the allocation and must be used instead of vkMapMemory.
+     */
+    struct Allocation
+    {
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+      VkDeviceSize offset = 0;
+      VkDeviceSize size = 0; // Size requested by the resource, the reserved range may be larger
+      void* mapped = nullptr;
+
+      // Bookkeeping for MemoryAllocator::free, block is null for dedicated allocations
+      MemoryBlock* block = nullptr;
+      uint32_t order = 0;
+      uint32_t memoryTypeIndex = 0;
+    };
+
+    /**
+     * @brief Usage of one memory heap, summed over every memory type living in it.
+     */
+    struct HeapStats
+    {
+      uint32_t heapIndex = 0;
+      bool deviceLocal = false;
+      VkDeviceSize heapSize = 0;
+      uint32_t blockCount = 0;
+      uint32_t dedicatedCount = 0;
+      uint32_t allocationCount = 0;
+      VkDeviceSize reservedBytes = 0;  ///< Device memory allocated from the driver (blocks + dedicated).
+      VkDeviceSize usedBytes = 0;      ///< Bytes handed out including buddy rounding.
+      VkDeviceSize requestedBytes = 0; ///< Bytes the resources actually asked for.
+      VkDeviceSize largestFreeRange = 0; ///< Largest range any one block could still hand out.
+      /// 1 - (sum of every block's largest free range) / free bytes. 0 means the free space inside each block is
+      /// contiguous, free space spread over several blocks does not count as fragmented.
+      float fragmentation = 0.0f;
+    };
+
+    /**
+     * @brief A single vkAllocateMemory block split up with a buddy allocator.
+     *
+     * Every range is a power of two multiple of MIN_ALLOCATION and sits at an offset that is a multiple of its size,
+     * so any alignment up to the range size comes for free.
+     */
+    class MemoryBlock
+    {
+    public:
+      static constexpr VkDeviceSize MIN_ALLOCATION = 256;
+
+      MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, void* mapped);
+
+      bool allocate(uint32_t order, VkDeviceSize& offset);
+      void free(VkDeviceSize offset, uint32_t order);
+      VkDeviceSize largestFreeRange() const;
+      VkDeviceSize freeBytes() const { return size - usedBytes; }
+      bool isEmpty() const { return allocationCount == 0; }
+
+      static VkDeviceSize orderSize(uint32_t order) { return MIN_ALLOCATION << order; }
+
+      VkDeviceMemory memory;
+      VkDeviceSize size;
+      uint32_t memoryTypeIndex;
+      uint8_t* mapped;
+
+      uint32_t maxOrder;
+      uint32_t allocationCount = 0;
+      VkDeviceSize usedBytes = 0;
+      VkDeviceSize requestedBytes = 0;
+
+    private:
+      std::vector<std::set<VkDeviceSize>> freeLists; // Free range offsets per order
+    };
+
+    /**
+     * @brief Pooled device memory sub-allocator used by VulkanDevice::createBuffer and createImageWithInfo.
+     *
+     * Memory is reserved in large blocks per memory type and split with a buddy allocator, so the number of
+     * vkAllocateMemory calls stays far below maxMemoryAllocationCount. Linear resources (buffers) and optimal tiling
+     * images are kept in separate blocks so bufferImageGranularity can never be violated between neighbours.
+     * Resources of at least DEDICATED_THRESHOLD get their own vkAllocateMemory. Host visible blocks are mapped once
+     * when created and stay mapped. Thread safe.
+     */
+    class MemoryAllocator
+    {
+    public:
+      static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+      static constexpr VkDeviceSize DEDICATED_THRESHOLD = DEFAULT_BLOCK_SIZE / 2;
+
+      MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice device);
+      ~MemoryAllocator();
+
+      MemoryAllocator(const MemoryAllocator&) = delete;
+      MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+      /**
+       * @brief Finds memory for a resource.
+       * @param requirements Requirements queried from the buffer or image.
+       * @param properties Required memory property flags.
+       * @param linear true for buffers and linear images, false for optimal tiling images.
+       * @throws std::runtime_error if no memory type matches or the device is out of memory.
+       */
+      Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+      void free(Allocation& allocation);
+
+      std::vector<HeapStats> getHeapStats() const;
+      uint32_t getDeviceAllocationCount() const { return deviceAllocationCount; }
+
+    private:
+      struct Pool
+      {
+        std::vector<std::unique_ptr<MemoryBlock>> blocks;
+      };
+
+      uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+      VkDeviceSize blockSizeFor(uint32_t memoryTypeIndex) const;
+      VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mapped);
+      void freeDeviceMemory(VkDeviceMemory memory, bool mapped);
+      Allocation allocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex);
+
+      VkDevice device;
+      VkPhysicalDeviceMemoryProperties memoryProperties;
+
+      mutable std::mutex mutex;
+      // Index is memoryTypeIndex * 2 + (linear ? 1 : 0)
+      std::array<Pool, VK_MAX_MEMORY_TYPES * 2> pools;
+
+      std::array<uint32_t, VK_MAX_MEMORY_TYPES> dedicatedCounts{};
+      std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> dedicatedBytes{};
+      std::atomic<uint32_t> deviceAllocationCount{0}; // Read without the mutex by getDeviceAllocationCount
+    };
+  } // namespace Graphics
+} // namespace GameEngine
@@ -1,22 +1,39 @@
 #include "mesh.hpp"
+#include "deletion_queue.hpp"
+#include "mesh_simplifier.hpp"
+#include "staging_ring.hpp"
+
+// libs
+#include <glm/gtc/packing.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstring>
+#include <functional>
+#include <limits>
 
 namespace GameEngine
 {
   namespace Graphics
   {
-    Mesh::Mesh(VulkanDevice& device, const std::vector<Vertex>& vertices) : vulkanDevice{device}
+    Mesh::Mesh(VulkanDevice& device, const Builder& builder, VertexFormat format)
+        : vulkanDevice{device}, vertexFormat{format}, bounds{Bounds::fromVertices(builder.vertices)}
     {
-      createVertexBuffers(vertices);
+      createVertexBuffers(builder.vertices);
+      createIndexBuffers(builder.indices);
+
+      lods = builder.lods;
+      if(lods.empty()) { lods.push_back({0, indexCount, 0.0f, vertexCount}); }
     };
 
     Mesh::~Mesh()
     {
-      vkDestroyBuffer(vulkanDevice.device(), vertexBuffer, nullptr);
-      vkFreeMemory(vulkanDevice.device(), vertexBufferMemory, nullptr);
+      // Frames in flight may still draw the mesh, so the buffers go once those frames have completed
+      vulkanDevice.deletionQueue().releaseBuffer(vertexBuffer, vertexAllocation);
+
+      if(hasIndexBuffer) { vulkanDevice.deletionQueue().releaseBuffer(indexBuffer, indexAllocation); }
     }
 
     void Mesh::createVertexBuffers(const std::vector<Vertex>& vertices)
@@ -24,39 +41,277 @@ namespace GameEngine
       vertexCount = static_cast<uint32_t>(vertices.size());
       assert(vertexCount >= 3 && "Vertex count must be at least 3");
       // This gives the the total amount of bytes required for the vertex buffer to store all the vertices of the model
-      VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-      vulkanDevice.createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                vertexBuffer, vertexBufferMemory);
-      void* data;
-      vkMapMemory(vulkanDevice.device(), vertexBufferMemory, 0, bufferSize, 0, &data);
-      // Take the vertices data and copy it to the Host mapped memory regeon (CPU)
-      memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-      vkUnmapMemory(vulkanDevice.device(), vertexBufferMemory);
+      VkDeviceSize bufferSize = getVertexBufferSize();
+
+      const void* vertexData = vertices.data();
+      std::vector<uint8_t> packed;
+      if(vertexFormat != VertexFormat::Float32)
+        {
+          // Map the bounding box onto [-1, 1] on every axis, a flat axis keeps scale 1 so nothing divides by 0
+          glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+          glm::vec3 halfExtent = (bounds.max - bounds.min) * 0.5f;
+          for(int axis = 0; axis < 3; axis++)
+            {
+              if(halfExtent[axis] <= 0.0f) { halfExtent[axis] = 1.0f; }
+            }
+          dequantization = {glm::vec4{halfExtent, 1.0f}, glm::vec4{center, 0.0f}};
+
+          uint32_t stride = vertexFormatStride(vertexFormat);
+          packed.resize(bufferSize);
+          for(uint32_t i = 0; i < vertexCount; i++)
+            {
+              glm::vec3 position = glm::clamp((vertices[i].position - center) / halfExtent, -1.0f, 1.0f);
+              uint16_t components[4];
+              for(int axis = 0; axis < 3; axis++)
+                {
+                  components[axis] = vertexFormat == VertexFormat::Snorm16 ? glm::packSnorm1x16(position[axis])
+                                                                           : glm::packHalf1x16(position[axis]);
+                }
+              components[3] = vertexFormat == VertexFormat::Snorm16 ? glm::packSnorm1x16(1.0f)
+                                                                    : glm::packHalf1x16(1.0f);
+              uint32_t color = glm::packUnorm4x8(glm::vec4{glm::clamp(vertices[i].color, 0.0f, 1.0f), 1.0f});
+
+              uint8_t* vertex = packed.data() + size_t{i} * stride;
+              std::memcpy(vertex, components, sizeof(components));
+              std::memcpy(vertex + sizeof(components), &color, sizeof(color));
+            }
+          vertexData = packed.data();
+        }
+
+      // Lives in DEVICE_LOCAL memory so draws never read geometry over PCIe, filled through the staging ring.
+      // The copy is batched with other uploads and submitted by the Renderer before the next frame
+      vulkanDevice.createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexAllocation);
+      vulkanDevice.stagingRing().uploadToBuffer(vertexBuffer, 0, vertexData, bufferSize);
     }
 
-    void Mesh::draw(VkCommandBuffer commandBuffer) { vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0); }
+    void Mesh::createIndexBuffers(const std::vector<uint32_t>& indices)
+    {
+      indexCount = static_cast<uint32_t>(indices.size());
+      hasIndexBuffer = indexCount > 0;
+      if(!hasIndexBuffer) { return; }
+
+      // Half the index memory and bandwidth whenever every vertex can be addressed with 16 bits
+      std::vector<uint16_t> shortIndices;
+      const void* indexData = indices.data();
+      VkDeviceSize bufferSize = sizeof(uint32_t) * indexCount;
+      indexType = VK_INDEX_TYPE_UINT32;
+
+      if(vertexCount <= std::numeric_limits<uint16_t>::max())
+        {
+          shortIndices.assign(indices.begin(), indices.end());
+          indexData = shortIndices.data();
+          bufferSize = sizeof(uint16_t) * indexCount;
+          indexType = VK_INDEX_TYPE_UINT16;
+        }
+
+      vulkanDevice.createBuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexAllocation);
+      vulkanDevice.stagingRing().uploadToBuffer(indexBuffer, 0, indexData, bufferSize);
+    }
+
+    void Mesh::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod)
+    {
+      assert(lod < lods.size() && "Level of detail out of range");
+      if(hasIndexBuffer)
+        {
+          vkCmdDrawIndexed(commandBuffer, lods[lod].indexCount, instanceCount, lods[lod].firstIndex, 0, firstInstance);
+        }
+      else { vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance); }
+    }
+
+    void Mesh::writeIndirectCommand(VkDrawIndexedIndirectCommand& command, uint32_t firstInstance, uint32_t lod) const
+    {
+      assert(lod < lods.size() && "Level of detail out of range");
+      if(hasIndexBuffer) { command = {lods[lod].indexCount, 0, lods[lod].firstIndex, 0, firstInstance}; }
+      else
+        {
+          VkDrawIndirectCommand drawCommand{vertexCount, 0, 0, firstInstance};
+          command = {};
+          std::memcpy(&command, &drawCommand, sizeof(drawCommand));
+        }
+    }
+
+    void Mesh::drawIndirect(VkCommandBuffer commandBuffer, VkBuffer drawBuffer, VkDeviceSize drawOffset,
+                            uint32_t maxDrawCount, VkBuffer countBuffer, VkDeviceSize countOffset)
+    {
+      // Every command is VkDrawIndexedIndirectCommand sized, whichever kind it holds
+      constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+      if(vulkanDevice.supportsMultiDrawIndirect())
+        {
+          if(hasIndexBuffer)
+            {
+              if(auto drawCount = vulkanDevice.cmdDrawIndexedIndirectCount())
+                {
+                  drawCount(commandBuffer, drawBuffer, drawOffset, countBuffer, countOffset, maxDrawCount, stride);
+                }
+              else { vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, drawOffset, maxDrawCount, stride); }
+            }
+          else if(auto drawCount = vulkanDevice.cmdDrawIndirectCount())
+            {
+              drawCount(commandBuffer, drawBuffer, drawOffset, countBuffer, countOffset, maxDrawCount, stride);
+            }
+          else { vkCmdDrawIndirect(commandBuffer, drawBuffer, drawOffset, maxDrawCount, stride); }
+          return;
+        }
+
+      for(uint32_t i = 0; i < maxDrawCount; i++)
+        {
+          VkDeviceSize offset = drawOffset + i * stride;
+          if(hasIndexBuffer) { vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, offset, 1, stride); }
+          else { vkCmdDrawIndirect(commandBuffer, drawBuffer, offset, 1, stride); }
+        }
+    }
 
     void Mesh::bind(VkCommandBuffer commandBuffer)
     {
       VkBuffer buffers[] = {vertexBuffer};
       VkDeviceSize offsets[] = {0};
       vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+
+      if(hasIndexBuffer) { vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, indexType); }
+    }
+
+    Mesh::Bounds Mesh::Bounds::fromVertices(const std::vector<Vertex>& vertices)
+    {
+      Bounds result{};
+      if(vertices.empty()) { return result; }
+
+      result.min = result.max = vertices[0].position;
+      for(const auto& vertex : vertices)
+        {
+          result.min = glm::min(result.min, vertex.position);
+          result.max = glm::max(result.max, vertex.position);
+        }
+
+      // Centering on the box is not the minimal sphere, but it is tight for the boxy meshes we load and needs
+      // only one more pass
+      result.center = (result.min + result.max) * 0.5f;
+      float radiusSquared = 0.0f;
+      for(const auto& vertex : vertices)
+        {
+          glm::vec3 offset = vertex.position - result.center;
+          radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+        }
+      result.radius = std::sqrt(radiusSquared);
+      return result;
     }
 
-    std::vector<VkVertexInputBindingDescription> Mesh::Vertex::getBindingDescriptions()
+    size_t Mesh::Vertex::Hash::operator()(const Vertex& vertex) const
+    {
+      // boost::hash_combine style mixing of every float
+      size_t seed = 0;
+      auto combine = [&seed](float value) {
+        seed ^= std::hash<float>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      };
+      combine(vertex.position.x);
+      combine(vertex.position.y);
+      combine(vertex.position.z);
+      combine(vertex.color.x);
+      combine(vertex.color.y);
+      combine(vertex.color.z);
+      return seed;
+    }
+
+    uint32_t Mesh::Builder::addVertex(const Vertex& vertex)
+    {
+      auto [it, inserted] = uniqueVertices.try_emplace(vertex, static_cast<uint32_t>(vertices.size()));
+      if(inserted) { vertices.push_back(vertex); }
+      indices.push_back(it->second);
+      return it->second;
+    }
+
+    void Mesh::Builder::addTriangle(const Vertex& a, const Vertex& b, const Vertex& c)
+    {
+      addVertex(a);
+      addVertex(b);
+      addVertex(c);
+    }
+
+    Mesh::Builder Mesh::Builder::fromTriangleList(const std::vector<Vertex>& triangleVertices)
+    {
+      Builder builder{};
+      builder.indices.reserve(triangleVertices.size());
+      for(const auto& vertex : triangleVertices) { builder.addVertex(vertex); }
+      return builder;
+    }
+
+    uint32_t Mesh::Builder::generateLods(uint32_t maxLods)
+    {
+      std::vector<uint8_t> referenced;
+      auto countVertices = [&](const std::vector<uint32_t>& level)
+      {
+        referenced.assign(vertices.size(), 0);
+        uint32_t count = 0;
+        for(uint32_t index : level)
+          {
+            count += referenced[index] == 0;
+            referenced[index] = 1;
+          }
+        return count;
+      };
+
+      if(indices.empty())
+        {
+          lods.clear();
+          return 1;
+        }
+
+      uint32_t fullIndexCount = static_cast<uint32_t>(lods.empty() ? indices.size() : lods[0].indexCount);
+      indices.resize(fullIndexCount);
+      lods.assign(1, {0, fullIndexCount, 0.0f, countVertices(indices)});
+
+      std::vector<uint32_t> fullIndices = indices;
+      float maxError = MAX_LOD_ERROR * Bounds::fromVertices(vertices).radius;
+      size_t previousCount = fullIndexCount;
+
+      while(lods.size() < maxLods)
+        {
+          size_t target = static_cast<size_t>(previousCount * LOD_REDUCTION) / 3 * 3;
+          float error = 0.0f;
+          std::vector<uint32_t> level = MeshSimplifier::simplify(vertices, fullIndices, target, maxError, &error);
+          if(level.empty() || level.size() > previousCount * MIN_LOD_SHRINK) { break; }
+
+          // Selection assumes coarser levels never have a smaller error
+          error = std::max(error, lods.back().error);
+          lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), error,
+                          countVertices(level)});
+          indices.insert(indices.end(), level.begin(), level.end());
+          previousCount = level.size();
+        }
+      return static_cast<uint32_t>(lods.size());
+    }
+
+    std::vector<VkVertexInputBindingDescription> Mesh::Vertex::getBindingDescriptions(VertexFormat format)
     {
       std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
       bindingDescriptions[0].binding = 0;
-      bindingDescriptions[0].stride = sizeof(Vertex);
+      bindingDescriptions[0].stride = vertexFormatStride(format);
       bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
       return bindingDescriptions;
     }
 
-    std::vector<VkVertexInputAttributeDescription> Mesh::Vertex::getAttributeDescriptions()
+    std::vector<VkVertexInputAttributeDescription> Mesh::Vertex::getAttributeDescriptions(VertexFormat format)
     {
       std::vector<VkVertexInputAttributeDescription> attributeDescriptions(2);
 
+      // Compact formats pack four 16 bit position components, then four color bytes. The shader reads the same
+      // vec3 inputs either way, the unused fourth components are dropped
+      if(format != VertexFormat::Float32)
+        {
+          attributeDescriptions[0].binding = 0;
+          attributeDescriptions[0].location = 0;
+          attributeDescriptions[0].format = format == VertexFormat::Snorm16 ? VK_FORMAT_R16G16B16A16_SNORM
+                                                                             : VK_FORMAT_R16G16B16A16_SFLOAT;
+          attributeDescriptions[0].offset = 0;
+
+          attributeDescriptions[1].binding = 0;
+          attributeDescriptions[1].location = 1;
+          attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+          attributeDescriptions[1].offset = 4 * sizeof(uint16_t);
+          return attributeDescriptions;
+        }
+
       // Interleaving position and color together
       attributeDescriptions[0].binding = 0;
       attributeDescriptions[0].location = 0;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "vertex_format.hpp"
 #include "vulkan_device.hpp"
 
 // libs
@@ -8,6 +9,9 @@
 #include <glm/glm.hpp>
 
 // std
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 namespace GameEngine
@@ -17,7 +21,8 @@ namespace GameEngine
     /**
      * @brief A class representing a mesh for rendering in Vulkan.
      *
-     * The Mesh class manages vertex data and associated Vulkan buffers for rendering.
+     * The Mesh class manages vertex data and associated Vulkan buffers for rendering. Vertices are kept at full
+     * precision on the CPU and converted to the mesh's VertexFormat when they are uploaded.
      */
     class Mesh
     {
@@ -28,33 +33,148 @@ namespace GameEngine
         glm::vec3 color;
 
         /**
-         * @brief Retrieves the Vulkan vertex input binding descriptions.
+         * @brief Retrieves the Vulkan vertex input binding descriptions of meshes stored in format.
          * @return A vector of VkVertexInputBindingDescription objects.
          */
-        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+        static std::vector<VkVertexInputBindingDescription>
+        getBindingDescriptions(VertexFormat format = VertexFormat::Float32);
 
         /**
-         * @brief Retrieves the Vulkan vertex input attribute descriptions.
+         * @brief Retrieves the Vulkan vertex input attribute descriptions of meshes stored in format.
          * @return A vector of VkVertexInputAttributeDescription objects.
          */
-        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+        static std::vector<VkVertexInputAttributeDescription>
+        getAttributeDescriptions(VertexFormat format = VertexFormat::Float32);
+
+        bool operator==(const Vertex& other) const { return position == other.position && color == other.color; }
+
+        /**
+         * @brief Hashes every attribute so identical vertices can be welded together.
+         */
+        struct Hash
+        {
+          size_t operator()(const Vertex& vertex) const;
+        };
+      };
+
+      /**
+       * @brief One level of detail, a range of the mesh's index buffer. Every level indexes the same vertices.
+       */
+      struct Lod
+      {
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;
+        float error = 0.0f;       ///< How far, in model units, the level may deviate from the full detail surface.
+        uint32_t vertexCount = 0; ///< Distinct vertices the level's indices refer to.
+      };
+
+      /**
+       * @brief Maps stored positions back to model space, position = stored * scale + offset. Pushed to the vertex
+       * shader with every draw of the mesh (std430, vec4 for alignment, w unused).
+       */
+      struct Dequantization
+      {
+        glm::vec4 scale{1.0f};
+        glm::vec4 offset{0.0f};
       };
 
       /**
-       * @brief Constructs a Mesh with the given vertices and Vulkan device.
+       * @brief Collects vertices and indices for a Mesh, welding identical vertices together.
+       *
+       * Every vertex added through addVertex or addTriangle is looked up in a hash map first, so shared corners are
+       * stored once and referenced by index. That saves memory and lets the GPU reuse post transform results.
+       */
+      struct Builder
+      {
+        // Levels generateLods stops at, and the index count it aims for relative to the previous level
+        static constexpr uint32_t MAX_LODS = 6;
+        static constexpr float LOD_REDUCTION = 0.5f;
+        // Largest simplification error relative to the bounding radius, coarser levels are not generated
+        static constexpr float MAX_LOD_ERROR = 0.25f;
+        // A level keeping more than this fraction of the previous one's indices is not worth its memory
+        static constexpr float MIN_LOD_SHRINK = 0.85f;
+
+        std::vector<Vertex> vertices{};
+        std::vector<uint32_t> indices{};
+        std::vector<Lod> lods{}; ///< Ranges of indices, finest first. Empty when indices hold a single level.
+
+        /**
+         * @brief Appends an index for the vertex, adding the vertex only if no identical one exists yet.
+         * @return Index of the (possibly reused) vertex.
+         */
+        uint32_t addVertex(const Vertex& vertex);
+
+        void addTriangle(const Vertex& a, const Vertex& b, const Vertex& c);
+
+        /**
+         * @brief Welds a non-indexed triangle list into unique vertices plus indices.
+         */
+        static Builder fromTriangleList(const std::vector<Vertex>& triangleVertices);
+
+        /**
+         * @brief Appends simplified levels of indices to indices with MeshSimplifier and lists them all in lods.
+         *
+         * Each level aims for LOD_REDUCTION of the previous one's indices and is simplified from the full detail
+         * indices, so its error is measured against the original surface. Stops early when the simplifier can no
+         * longer shrink the mesh enough within MAX_LOD_ERROR. Does nothing for non-indexed builders.
+         * @return Number of levels, including the full detail one.
+         */
+        uint32_t generateLods(uint32_t maxLods = MAX_LODS);
+
+      private:
+        std::unordered_map<Vertex, uint32_t, Vertex::Hash> uniqueVertices{};
+      };
+
+      /**
+       * @brief Local space bounding volumes, computed once from the vertices when the mesh is created.
+       */
+      struct Bounds
+      {
+        glm::vec3 min{0.0f};    ///< Axis aligned box corners.
+        glm::vec3 max{0.0f};
+        glm::vec3 center{0.0f}; ///< Sphere center, the middle of the box.
+        float radius = 0.0f;    ///< Distance from center to the farthest vertex.
+
+        static Bounds fromVertices(const std::vector<Vertex>& vertices);
+      };
+
+      /**
+       * @brief Constructs a Mesh from the builder's vertices and, if present, its indices.
        * @param device Reference to the VulkanDevice used for buffer creation.
-       * @param vertices Vector of Vertex objects containing mesh data.
+       * @param builder Vertex and index data. Without indices the mesh is drawn with vkCmdDraw.
+       * @param format How the vertex buffer stores the vertices, the pipeline drawing the mesh must match it.
        */
-      Mesh(VulkanDevice& device, const std::vector<Vertex>& vertices);
+      Mesh(VulkanDevice& device, const Builder& builder, VertexFormat format = VertexFormat::Float32);
 
+      /**
+       * @brief Hands the buffers to the device's DeletionQueue, so a mesh can be dropped while frames draw it.
+       */
       ~Mesh();
 
       // Delete copy constructors because mesh manages Vulkan buffer and memory objects
       Mesh(const Mesh&) = delete;
       Mesh& operator=(const Mesh&) = delete;
 
+      uint32_t getVertexCount() const { return vertexCount; }
+      uint32_t getIndexCount() const { return indexCount; } ///< Of every level together.
+      uint32_t getLodCount() const { return static_cast<uint32_t>(lods.size()); }
+      const Lod& getLod(uint32_t lod) const { return lods[lod]; }
+
       /**
-       * @brief Binds the mesh's vertex buffer to the provided command buffer.
+       * @brief Triangles drawn per instance at the given level.
+       */
+      uint32_t getTriangleCount(uint32_t lod = 0) const
+      {
+        return (hasIndexBuffer ? lods[lod].indexCount : vertexCount) / 3;
+      }
+      VkIndexType getIndexType() const { return indexType; }
+      const Bounds& getBounds() const { return bounds; }
+      VertexFormat getVertexFormat() const { return vertexFormat; }
+      const Dequantization& getDequantization() const { return dequantization; }
+      VkDeviceSize getVertexBufferSize() const { return VkDeviceSize{vertexCount} * vertexFormatStride(vertexFormat); }
+
+      /**
+       * @brief Binds the mesh's vertex buffer, and index buffer if it has one, to the provided command buffer.
        * @param commandBuffer The Vulkan command buffer to bind the mesh to.
        */
       void bind(VkCommandBuffer commandBuffer);
@@ -62,20 +182,63 @@ namespace GameEngine
       /**
        * @brief Issues draw commands for the mesh using the provided command buffer.
        * @param commandBuffer The Vulkan command buffer to record draw commands.
+       * @param instanceCount Number of instances to draw, per instance data is read from the bound instance buffer.
+       * @param firstInstance Index of the first instance in the instance buffer.
+       * @param lod Level of detail to draw, below getLodCount.
        */
-      void draw(VkCommandBuffer commandBuffer);
+      void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0,
+                uint32_t lod = 0);
+
+      /**
+       * @brief Writes the indirect command drawIndirect expects, with instanceCount 0 for a compute pass to fill in.
+       * @param command Room for a VkDrawIndexedIndirectCommand. Non-indexed meshes write a VkDrawIndirectCommand into
+       * its first 16 bytes, instanceCount sits at the same offset in both.
+       * @param firstInstance Index of the first instance in the instance buffer.
+       * @param lod Level of detail to draw, below getLodCount.
+       */
+      void writeIndirectCommand(VkDrawIndexedIndirectCommand& command, uint32_t firstInstance, uint32_t lod = 0) const;
+
+      /**
+       * @brief Draws the mesh with the first count commands from drawOffset on, count being read from countOffset.
+       *
+       * Uses vkCmdDraw*IndirectCount when VK_KHR_draw_indirect_count and multiDrawIndirect are available. Without
+       * them all maxDrawCount commands are executed, so those past the count must have an instanceCount of 0.
+       * @param maxDrawCount Commands at drawOffset, tightly packed VkDrawIndexedIndirectCommand sized.
+       */
+      void drawIndirect(VkCommandBuffer commandBuffer, VkBuffer drawBuffer, VkDeviceSize drawOffset,
+                        uint32_t maxDrawCount, VkBuffer countBuffer, VkDeviceSize countOffset);
 
     private:
       /**
-       * @brief Creates vertex buffers for the provided vertices.
+       * @brief Creates a DEVICE_LOCAL vertex buffer and queues its upload on the device's staging ring.
+       *
+       * Compact formats quantize the positions to bounds first and fill in dequantization to undo it.
        * @param vertices Vector of Vertex objects to create buffers for.
        */
       void createVertexBuffers(const std::vector<Vertex>& vertices);
 
+      /**
+       * @brief Creates a DEVICE_LOCAL index buffer, using 16 bit indices whenever every index fits.
+       * @param indices Indices into the vertex buffer, every level of detail back to back. May be empty for
+       * non-indexed meshes.
+       */
+      void createIndexBuffers(const std::vector<uint32_t>& indices);
+
       VulkanDevice& vulkanDevice;        ///< Reference to the Vulkan device.
       VkBuffer vertexBuffer;             ///< Vulkan buffer for vertex data.
-      VkDeviceMemory vertexBufferMemory; ///< Vulkan memory for the vertex buffer.
+      Allocation vertexAllocation;       ///< Device memory range of the vertex buffer.
       uint32_t vertexCount;              ///< Number of vertices in the mesh.
+      VertexFormat vertexFormat;         ///< Layout of the vertex buffer.
+      Dequantization dequantization{};   ///< Identity for VertexFormat::Float32.
+
+      bool hasIndexBuffer = false;                       ///< False for meshes drawn with vkCmdDraw.
+      VkBuffer indexBuffer = VK_NULL_HANDLE;             ///< Vulkan buffer for index data.
+      Allocation indexAllocation{};                      ///< Device memory range of the index buffer.
+      uint32_t indexCount = 0;                           ///< Number of indices in the mesh, all levels.
+      std::vector<Lod> lods{};                           ///< At least one, the full detail level first.
+      VkIndexType indexType = VK_INDEX_TYPE_UINT32;      ///< UINT16 when the vertex count allows it.
+
+      Bounds bounds{}; ///< Used by the frustum culler, never changes after creation.
     };
   } // namespace Graphics
 
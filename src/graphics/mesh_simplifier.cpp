@@ -0,0 +1,238 @@
+#include "mesh_simplifier.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    namespace
+    {
+      /**
+       * @brief Symmetric 4x4 matrix summing squared distances to planes, only the upper triangle is stored.
+       */
+      struct Quadric
+      {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+
+        /**
+         * @brief Quadric of the plane dot(normal, p) + d = 0, scaled by weight. normal must be unit length.
+         */
+        static Quadric fromPlane(const glm::dvec3& normal, double d, double weight)
+        {
+          Quadric q;
+          q.a00 = weight * normal.x * normal.x;
+          q.a01 = weight * normal.x * normal.y;
+          q.a02 = weight * normal.x * normal.z;
+          q.a03 = weight * normal.x * d;
+          q.a11 = weight * normal.y * normal.y;
+          q.a12 = weight * normal.y * normal.z;
+          q.a13 = weight * normal.y * d;
+          q.a22 = weight * normal.z * normal.z;
+          q.a23 = weight * normal.z * d;
+          q.a33 = weight * d * d;
+          return q;
+        }
+
+        Quadric& operator+=(const Quadric& other)
+        {
+          a00 += other.a00, a01 += other.a01, a02 += other.a02, a03 += other.a03;
+          a11 += other.a11, a12 += other.a12, a13 += other.a13;
+          a22 += other.a22, a23 += other.a23;
+          a33 += other.a33;
+          return *this;
+        }
+
+        /**
+         * @brief Weighted sum of squared distances from p to the planes, v^T Q v for v = (p, 1).
+         */
+        double evaluate(const glm::vec3& p) const
+        {
+          double x = p.x, y = p.y, z = p.z;
+          return x * x * a00 + y * y * a11 + z * z * a22 + a33 +
+                 2.0 * (x * y * a01 + x * z * a02 + y * z * a12 + x * a03 + y * a13 + z * a23);
+        }
+      };
+
+      struct Collapse
+      {
+        double cost;
+        uint32_t from;
+        uint32_t to;
+
+        bool operator<(const Collapse& other) const { return cost < other.cost; }
+      };
+
+      uint64_t edgeKey(uint32_t a, uint32_t b)
+      {
+        return a < b ? (uint64_t{a} << 32) | b : (uint64_t{b} << 32) | a;
+      }
+
+      /**
+       * @brief Triangles around each vertex as one flat array, vertex v's are [offsets[v], offsets[v + 1]).
+       */
+      void buildAdjacency(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& offsets,
+                          std::vector<uint32_t>& triangles)
+      {
+        offsets.assign(vertexCount + 1, 0);
+        for(uint32_t index : indices) { offsets[index + 1]++; }
+        for(size_t v = 0; v < vertexCount; v++) { offsets[v + 1] += offsets[v]; }
+
+        triangles.resize(indices.size());
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i < indices.size(); i++) { triangles[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3); }
+      }
+    } // namespace
+
+    std::vector<uint32_t> MeshSimplifier::simplify(const std::vector<Mesh::Vertex>& vertices,
+                                                   const std::vector<uint32_t>& indices, size_t targetIndexCount,
+                                                   float maxError, float* resultError)
+    {
+      std::vector<uint32_t> result = indices;
+      if(resultError != nullptr) { *resultError = 0.0f; }
+      if(result.size() <= targetIndexCount || vertices.empty()) { return result; }
+
+      size_t vertexCount = vertices.size();
+      auto position = [&](uint32_t vertex) -> const glm::vec3& { return vertices[vertex].position; };
+
+      // Unweighted, so the square root of a cost bounds the distance to each plane that went into it
+      std::vector<Quadric> quadrics(vertexCount);
+      for(size_t i = 0; i + 2 < result.size(); i += 3)
+        {
+          glm::dvec3 p0{position(result[i])};
+          glm::dvec3 normal =
+            glm::cross(glm::dvec3{position(result[i + 1])} - p0, glm::dvec3{position(result[i + 2])} - p0);
+          double length = glm::length(normal);
+          if(length == 0.0) { continue; }
+          normal /= length;
+
+          Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, p0), 1.0);
+          for(size_t corner = 0; corner < 3; corner++) { quadrics[result[i + corner]] += plane; }
+        }
+
+      std::vector<bool> locked(vertexCount, false);
+      {
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        edgeUses.reserve(result.size());
+        for(size_t i = 0; i + 2 < result.size(); i += 3)
+          {
+            for(size_t corner = 0; corner < 3; corner++)
+              {
+                edgeUses[edgeKey(result[i + corner], result[i + (corner + 1) % 3])]++;
+              }
+          }
+        for(auto [key, uses] : edgeUses)
+          {
+            if(uses == 1)
+              {
+                locked[key >> 32] = true;
+                locked[key & 0xffffffffu] = true;
+              }
+          }
+      }
+
+      // A collapse moves one corner of every triangle around from, none of them may turn over
+      std::vector<uint32_t> adjacencyOffsets;
+      std::vector<uint32_t> adjacency;
+      auto flips = [&](uint32_t from, uint32_t to)
+      {
+        const glm::vec3& target = position(to);
+        for(uint32_t k = adjacencyOffsets[from]; k < adjacencyOffsets[from + 1]; k++)
+          {
+            const uint32_t* triangle = &result[adjacency[k] * 3];
+            if(triangle[0] == to || triangle[1] == to || triangle[2] == to) { continue; } // Removed by the collapse
+
+            glm::vec3 before[3] = {position(triangle[0]), position(triangle[1]), position(triangle[2])};
+            glm::vec3 after[3] = {before[0], before[1], before[2]};
+            for(size_t corner = 0; corner < 3; corner++)
+              {
+                if(triangle[corner] == from) { after[corner] = target; }
+              }
+
+            glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if(glm::dot(normalBefore, normalAfter) <= 0.0f) { return true; }
+          }
+        return false;
+      };
+
+      double maxCost = double{maxError} * maxError;
+      double reachedCost = 0.0;
+      std::vector<Collapse> collapses;
+      std::vector<uint32_t> remap(vertexCount);
+      std::vector<uint8_t> touched(vertexCount);
+
+      for(uint32_t pass = 0; pass < MAX_PASSES && result.size() > targetIndexCount; pass++)
+        {
+          buildAdjacency(result, vertexCount, adjacencyOffsets, adjacency);
+
+          // Interior edges show up once in each direction, one per triangle using them
+          collapses.clear();
+          for(size_t i = 0; i + 2 < result.size(); i += 3)
+            {
+              for(size_t corner = 0; corner < 3; corner++)
+                {
+                  uint32_t from = result[i + corner];
+                  uint32_t to = result[i + (corner + 1) % 3];
+                  if(locked[from]) { continue; }
+
+                  Quadric merged = quadrics[from];
+                  merged += quadrics[to];
+                  collapses.push_back({std::max(merged.evaluate(position(to)), 0.0), from, to});
+                }
+            }
+          std::sort(collapses.begin(), collapses.end());
+
+          std::iota(remap.begin(), remap.end(), 0u);
+          std::fill(touched.begin(), touched.end(), uint8_t{0});
+          size_t trianglesLeft = result.size() / 3;
+          size_t targetTriangles = targetIndexCount / 3;
+          bool collapsed = false;
+
+          for(const Collapse& collapse : collapses)
+            {
+              if(collapse.cost > maxCost || trianglesLeft <= targetTriangles) { break; }
+              if(touched[collapse.from] || touched[collapse.to] || flips(collapse.from, collapse.to)) { continue; }
+
+              remap[collapse.from] = collapse.to;
+              quadrics[collapse.to] += quadrics[collapse.from];
+              reachedCost = std::max(reachedCost, collapse.cost);
+              collapsed = true;
+
+              // Freeze every triangle around from for the rest of the pass, later collapses then never see one this
+              // collapse has already changed
+              for(uint32_t k = adjacencyOffsets[collapse.from]; k < adjacencyOffsets[collapse.from + 1]; k++)
+                {
+                  const uint32_t* triangle = &result[adjacency[k] * 3];
+                  touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+                }
+
+              // An interior edge is shared by two triangles, both collapse to a line
+              trianglesLeft -= std::min<size_t>(trianglesLeft, 2);
+            }
+          if(!collapsed) { break; }
+
+          size_t written = 0;
+          for(size_t i = 0; i + 2 < result.size(); i += 3)
+            {
+              uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+              if(a == b || b == c || a == c) { continue; }
+              result[written++] = a;
+              result[written++] = b;
+              result[written++] = c;
+            }
+          result.resize(written);
+        }
+
+      if(resultError != nullptr) { *resultError = static_cast<float>(std::sqrt(reachedCost)); }
+      return result;
+    }
+  } // namespace Graphics
+} // namespace GameEngine
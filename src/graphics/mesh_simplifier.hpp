@@ -0,0 +1,48 @@
+#pragma once
+
+#include "mesh.hpp"
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief Reduces a triangle list with quadric error metric edge collapses (Garland and Heckbert).
+     *
+     * Every vertex carries the sum of the squared distance quadrics of the planes of its triangles. Collapsing the
+     * edge (a, b) moves a onto b and costs a's and b's summed quadrics evaluated at b, the squared distance b is away
+     * from the planes both used to lie on. The cheapest collapses are applied in passes: within a pass no two
+     * collapses touch the same triangles, so costs stay exact, and quadrics are merged before the next pass.
+     *
+     * Vertices only ever move onto other existing vertices, so every level indexes the original vertex buffer and a
+     * whole LOD chain fits into one index buffer. Vertices on edges used by a single triangle stay where they are:
+     * those are open borders and attribute seams, where the builder split a position because its colors differ.
+     * Collapses that would flip a triangle are skipped.
+     */
+    class MeshSimplifier
+    {
+    public:
+      // Upper bound on collapse passes, each one at least removes a few triangles or stops the simplification
+      static constexpr uint32_t MAX_PASSES = 64;
+
+      /**
+       * @brief Simplifies indices down to about targetIndexCount indices.
+       * @param vertices Positions the indices refer to, left untouched.
+       * @param indices Triangle list to simplify.
+       * @param targetIndexCount Stops once this many indices or fewer are left.
+       * @param maxError Largest distance, in model units, a collapsed vertex may lie from its original surface. The
+       * result keeps more indices than targetIndexCount if reaching it would need a larger error.
+       * @param[out] resultError Largest error of the collapses made, 0 if none was. May be nullptr.
+       * @return The simplified triangle list, degenerate triangles removed.
+       */
+      static std::vector<uint32_t> simplify(const std::vector<Mesh::Vertex>& vertices,
+                                            const std::vector<uint32_t>& indices, size_t targetIndexCount,
+                                            float maxError, float* resultError = nullptr);
+    };
+  } // namespace Graphics
+} // namespace GameEngine
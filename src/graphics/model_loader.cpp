@@ -0,0 +1,584 @@
+#include "model_loader.hpp"
+
+#include "../core/job_system.hpp"
+#include "../core/json.hpp"
+#include "../platform/mapped_file.hpp"
+
+// std lib headers
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    namespace
+    {
+      uint32_t workerCount() { return Core::JobSystem::get().threadCount(); }
+
+      /**
+       * @brief Runs task(i) for every i in [0, count) as jobs, rethrowing the first exception.
+       */
+      template <typename Task> void parallelFor(size_t count, const Task& task)
+      {
+        Core::JobSystem::get().parallelFor(count, 1,
+                                           [&task](size_t begin, size_t end)
+                                           {
+                                             for(size_t i = begin; i < end; i++) { task(i); }
+                                           });
+      }
+
+      // ---- OBJ ----
+
+      /**
+       * @brief One face corner as parsed, before every chunk's vertex count is known.
+       *
+       * Positive face indices are already absolute, so they are stored 0 based. Negative (relative) indices depend on
+       * how many vertices precede the face in the whole file, which a chunk doesn't know, so they are stored as an
+       * index relative to the chunk's first vertex. That is negative when it points into an earlier chunk.
+       */
+      struct ObjIndex
+      {
+        int64_t value;
+        bool relative;
+      };
+
+      /**
+       * @brief Output of one OBJ chunk.
+       */
+      struct ObjChunk
+      {
+        std::vector<Mesh::Vertex> vertices;
+        std::vector<ObjIndex> indices;
+      };
+
+      bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+      const char* skipSpaces(const char* p, const char* end)
+      {
+        while(p < end && isSpace(*p)) { p++; }
+        return p;
+      }
+
+      const char* parseFloat(const char* p, const char* end, float& value)
+      {
+        p = skipSpaces(p, end);
+        // from_chars rejects a leading '+', which some exporters write
+        if(p < end && *p == '+') { p++; }
+        auto [next, error] = std::from_chars(p, end, value);
+        return error == std::errc{} ? next : nullptr;
+      }
+
+      void parseObjChunk(const char* p, const char* end, ObjChunk& chunk)
+      {
+        std::vector<ObjIndex> face;
+
+        while(p < end)
+          {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            if(lineEnd == nullptr) { lineEnd = end; }
+
+            p = skipSpaces(p, lineEnd);
+            if(lineEnd - p >= 2 && p[0] == 'v' && isSpace(p[1]))
+              {
+                Mesh::Vertex vertex{{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+                const char* cursor = p + 2;
+                for(int axis = 0; axis < 3 && cursor != nullptr; axis++)
+                  {
+                    cursor = parseFloat(cursor, lineEnd, vertex.position[axis]);
+                  }
+                if(cursor == nullptr) { throw std::runtime_error("malformed obj vertex line!"); }
+
+                // Optional "v x y z r g b" vertex colors
+                glm::vec3 color;
+                const char* colorCursor = cursor;
+                for(int channel = 0; channel < 3 && colorCursor != nullptr; channel++)
+                  {
+                    colorCursor = parseFloat(colorCursor, lineEnd, color[channel]);
+                  }
+                if(colorCursor != nullptr) { vertex.color = color; }
+
+                chunk.vertices.push_back(vertex);
+              }
+            else if(lineEnd - p >= 2 && p[0] == 'f' && isSpace(p[1]))
+              {
+                face.clear();
+                const char* cursor = skipSpaces(p + 2, lineEnd);
+                while(cursor < lineEnd)
+                  {
+                    // Only the position index of "v/vt/vn" is used
+                    int64_t index = 0;
+                    auto [next, error] = std::from_chars(cursor, lineEnd, index);
+                    if(error != std::errc{} || index == 0) { throw std::runtime_error("malformed obj face line!"); }
+
+                    if(index > 0) { face.push_back({index - 1, false}); }
+                    else { face.push_back({static_cast<int64_t>(chunk.vertices.size()) + index, true}); }
+
+                    cursor = next;
+                    while(cursor < lineEnd && !isSpace(*cursor)) { cursor++; }
+                    cursor = skipSpaces(cursor, lineEnd);
+                  }
+                if(face.size() < 3) { throw std::runtime_error("obj face with fewer than 3 vertices!"); }
+
+                // Triangulate as a fan, fine for the convex polygons exporters write
+                for(size_t i = 1; i + 1 < face.size(); i++)
+                  {
+                    chunk.indices.push_back(face[0]);
+                    chunk.indices.push_back(face[i]);
+                    chunk.indices.push_back(face[i + 1]);
+                  }
+              }
+
+            p = lineEnd + 1;
+          }
+      }
+
+      // ---- glTF ----
+
+      constexpr uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+      constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+      constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+      constexpr int GLTF_MODE_TRIANGLES = 4;
+      constexpr int GLTF_UNSIGNED_BYTE = 5121;
+      constexpr int GLTF_UNSIGNED_SHORT = 5123;
+      constexpr int GLTF_UNSIGNED_INT = 5125;
+      constexpr int GLTF_FLOAT = 5126;
+
+      struct BufferRange
+      {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+      };
+
+      /**
+       * @brief Resolved accessor, points straight into a mapped buffer.
+       */
+      struct AccessorView
+      {
+        const uint8_t* data = nullptr;
+        size_t count = 0;
+        size_t stride = 0;
+        int componentType = 0;
+        int componentCount = 0;
+        bool normalized = false;
+      };
+
+      size_t componentSize(int componentType)
+      {
+        switch(componentType)
+          {
+          case 5120:
+          case GLTF_UNSIGNED_BYTE: return 1;
+          case 5122:
+          case GLTF_UNSIGNED_SHORT: return 2;
+          case GLTF_UNSIGNED_INT:
+          case GLTF_FLOAT: return 4;
+          default: throw std::runtime_error("unknown gltf component type!");
+          }
+      }
+
+      int componentCountOf(const std::string& type)
+      {
+        if(type == "SCALAR") { return 1; }
+        if(type == "VEC2") { return 2; }
+        if(type == "VEC3") { return 3; }
+        if(type == "VEC4") { return 4; }
+        throw std::runtime_error("unsupported gltf accessor type: " + type);
+      }
+
+      /**
+       * @brief Converts a glTF index, count or byte offset to size_t.
+       *
+       * JsonValue::asIndex just casts, which is undefined for negative or huge numbers, so anything that is not a
+       * non-negative integer a double represents exactly is refused before the cast.
+       * @throws std::runtime_error for negative, fractional, non-finite or too large numbers.
+       */
+      size_t toSize(double number)
+      {
+        constexpr double maxExact = 9007199254740992.0; // 2^53
+        double limit = std::min(maxExact, static_cast<double>(std::numeric_limits<size_t>::max()));
+        if(!(number >= 0.0 && number <= limit) || std::floor(number) != number)
+          {
+            throw std::runtime_error("invalid gltf index, count or offset!");
+          }
+        return static_cast<size_t>(number);
+      }
+
+      /**
+       * @brief toSize for enum like values such as componentType, anything past INT_MAX becomes an unknown INT_MAX.
+       */
+      int toEnum(double number) { return static_cast<int>(std::min<size_t>(toSize(number), INT_MAX)); }
+
+      AccessorView resolveAccessor(const Core::JsonValue& document, const std::vector<BufferRange>& buffers,
+                                   size_t accessorIndex)
+      {
+        const Core::JsonValue& accessor = document["accessors"][accessorIndex];
+        if(accessor.isNull() || !accessor.has("bufferView"))
+          {
+            throw std::runtime_error("gltf accessor without buffer view is not supported!");
+          }
+        const Core::JsonValue& bufferView = document["bufferViews"][toSize(accessor["bufferView"].asNumber())];
+        if(bufferView.isNull()) { throw std::runtime_error("invalid gltf buffer view!"); }
+        size_t bufferIndex = toSize(bufferView["buffer"].asNumber());
+        if(bufferIndex >= buffers.size()) { throw std::runtime_error("invalid gltf buffer view!"); }
+
+        AccessorView view{};
+        view.count = toSize(accessor["count"].asNumber());
+        view.componentType = toEnum(accessor["componentType"].asNumber());
+        view.componentCount = componentCountOf(accessor["type"].asString());
+        view.normalized = accessor["normalized"].asBool();
+
+        size_t elementSize = componentSize(view.componentType) * view.componentCount;
+        view.stride = toSize(bufferView.numberOr("byteStride", static_cast<double>(elementSize)));
+
+        size_t viewOffset = toSize(bufferView.numberOr("byteOffset", 0.0));
+        size_t viewLength = toSize(bufferView["byteLength"].asNumber());
+        size_t accessorOffset = toSize(accessor.numberOr("byteOffset", 0.0));
+        const BufferRange& buffer = buffers[bufferIndex];
+
+        // Everything below reads straight from the mapping, so refuse anything that would run off the end. Every
+        // check subtracts from a size already known to be larger, so none of them can wrap around
+        bool inBounds = viewOffset <= buffer.size && viewLength <= buffer.size - viewOffset;
+        if(inBounds && view.count > 0)
+          {
+            inBounds = accessorOffset <= viewLength && elementSize <= viewLength - accessorOffset;
+            // The last element starts stride * (count - 1) bytes after the first
+            size_t room = inBounds ? viewLength - accessorOffset - elementSize : 0;
+            inBounds = inBounds && (view.stride == 0 || view.count - 1 <= room / view.stride);
+          }
+        if(!inBounds) { throw std::runtime_error("gltf accessor out of buffer bounds!"); }
+
+        view.data = buffer.data + viewOffset + accessorOffset;
+        return view;
+      }
+
+      float readComponent(const uint8_t* source, int componentType, bool normalized)
+      {
+        switch(componentType)
+          {
+          case GLTF_FLOAT:
+            {
+              float value;
+              std::memcpy(&value, source, sizeof(value));
+              return value;
+            }
+          case GLTF_UNSIGNED_BYTE: return normalized ? *source / 255.0f : static_cast<float>(*source);
+          case GLTF_UNSIGNED_SHORT:
+            {
+              uint16_t value;
+              std::memcpy(&value, source, sizeof(value));
+              return normalized ? value / 65535.0f : static_cast<float>(value);
+            }
+          default: throw std::runtime_error("unsupported gltf vertex component type!");
+          }
+      }
+
+      uint32_t readIndex(const AccessorView& view, size_t i)
+      {
+        const uint8_t* source = view.data + view.stride * i;
+        switch(view.componentType)
+          {
+          case GLTF_UNSIGNED_BYTE: return *source;
+          case GLTF_UNSIGNED_SHORT:
+            {
+              uint16_t value;
+              std::memcpy(&value, source, sizeof(value));
+              return value;
+            }
+          case GLTF_UNSIGNED_INT:
+            {
+              uint32_t value;
+              std::memcpy(&value, source, sizeof(value));
+              return value;
+            }
+          default: throw std::runtime_error("unsupported gltf index component type!");
+          }
+      }
+
+      struct GltfPrimitive
+      {
+        AccessorView positions;
+        AccessorView colors;
+        AccessorView indices;
+        bool hasColors = false;
+        bool hasIndices = false;
+        size_t firstVertex = 0;
+        size_t firstIndex = 0;
+      };
+
+      template <typename T> T readLittleEndian(const uint8_t* source)
+      {
+        T value;
+        std::memcpy(&value, source, sizeof(T));
+        return value;
+      }
+    } // namespace
+
+    Mesh::Builder ModelLoader::load(const std::string& filepath, LoadStats* stats)
+    {
+      std::string extension = std::filesystem::path(filepath).extension().string();
+      std::transform(extension.begin(), extension.end(), extension.begin(),
+                     [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+      LoadStats loadStats{};
+      auto start = std::chrono::steady_clock::now();
+
+      Mesh::Builder builder;
+      if(extension == ".obj") { builder = loadObj(filepath, loadStats); }
+      else if(extension == ".gltf") { builder = loadGltf(filepath, false, loadStats); }
+      else if(extension == ".glb") { builder = loadGltf(filepath, true, loadStats); }
+      else { throw std::runtime_error("unsupported model format: " + filepath); }
+
+      if(builder.vertices.empty()) { throw std::runtime_error("model has no geometry: " + filepath); }
+
+      loadStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      loadStats.megabytesPerSecond =
+        loadStats.seconds > 0.0 ? loadStats.bytes / (1024.0 * 1024.0) / loadStats.seconds : 0.0;
+      loadStats.vertexCount = builder.vertices.size();
+      loadStats.indexCount = builder.indices.size();
+      if(stats != nullptr) { *stats = loadStats; }
+
+      return builder;
+    }
+
+    Mesh::Builder ModelLoader::loadObj(const std::string& filepath, LoadStats& stats)
+    {
+      Platform::MappedFile file{filepath};
+      stats.bytes = file.size();
+
+      const char* begin = reinterpret_cast<const char*>(file.data());
+      const char* end = begin + file.size();
+
+      // Split into roughly equal chunks, moving each boundary forward to the start of the next line
+      size_t chunkCount = std::clamp<size_t>(file.size() / MIN_OBJ_CHUNK_BYTES, 1, workerCount());
+      std::vector<const char*> boundaries{begin};
+      for(size_t i = 1; i < chunkCount; i++)
+        {
+          const char* split = std::max(boundaries.back(), begin + file.size() * i / chunkCount);
+          const char* newline = static_cast<const char*>(std::memchr(split, '\n', static_cast<size_t>(end - split)));
+          if(newline == nullptr) { break; }
+          boundaries.push_back(newline + 1);
+        }
+      boundaries.push_back(end);
+      chunkCount = boundaries.size() - 1;
+      stats.threadCount = static_cast<uint32_t>(chunkCount);
+
+      std::vector<ObjChunk> chunks(chunkCount);
+      parallelFor(chunkCount, [&](size_t i) { parseObjChunk(boundaries[i], boundaries[i + 1], chunks[i]); });
+
+      // Prefix sums give every chunk its slice of the final arrays and the vertex base for relative indices
+      std::vector<size_t> vertexBase(chunkCount + 1, 0);
+      std::vector<size_t> indexBase(chunkCount + 1, 0);
+      for(size_t i = 0; i < chunkCount; i++)
+        {
+          vertexBase[i + 1] = vertexBase[i] + chunks[i].vertices.size();
+          indexBase[i + 1] = indexBase[i] + chunks[i].indices.size();
+        }
+
+      // Each OBJ position becomes exactly one vertex, so the file's indices can be used as is without welding
+      Mesh::Builder builder;
+      builder.vertices.resize(vertexBase[chunkCount]);
+      builder.indices.resize(indexBase[chunkCount]);
+      size_t totalVertices = vertexBase[chunkCount];
+
+      parallelFor(chunkCount,
+                  [&](size_t i)
+                  {
+                    const ObjChunk& chunk = chunks[i];
+                    std::copy(chunk.vertices.begin(), chunk.vertices.end(), builder.vertices.begin() + vertexBase[i]);
+
+                    uint32_t* out = builder.indices.data() + indexBase[i];
+                    for(const ObjIndex& index : chunk.indices)
+                      {
+                        int64_t resolved =
+                          index.relative ? static_cast<int64_t>(vertexBase[i]) + index.value : index.value;
+                        if(resolved < 0 || static_cast<uint64_t>(resolved) >= totalVertices)
+                          {
+                            throw std::runtime_error("obj face index out of range!");
+                          }
+                        *out++ = static_cast<uint32_t>(resolved);
+                      }
+                  });
+
+      return builder;
+    }
+
+    Mesh::Builder ModelLoader::loadGltf(const std::string& filepath, bool binary, LoadStats& stats)
+    {
+      Platform::MappedFile file{filepath};
+      stats.bytes = file.size();
+
+      // Keeps external .bin files mapped until every primitive has been decoded
+      std::vector<std::unique_ptr<Platform::MappedFile>> externalBuffers;
+      std::vector<BufferRange> buffers;
+
+      std::string_view json;
+      BufferRange glbBinChunk{};
+      if(binary)
+        {
+          const uint8_t* data = file.data();
+          if(file.size() < 20 || readLittleEndian<uint32_t>(data) != GLB_MAGIC ||
+             readLittleEndian<uint32_t>(data + 4) != 2)
+            {
+              throw std::runtime_error("not a glTF 2.0 binary file: " + filepath);
+            }
+
+          // 12 byte header, then chunks of {length, type, payload}, the JSON chunk always comes first
+          size_t offset = 12;
+          while(offset + 8 <= file.size())
+            {
+              uint32_t chunkLength = readLittleEndian<uint32_t>(data + offset);
+              uint32_t chunkType = readLittleEndian<uint32_t>(data + offset + 4);
+              if(offset + 8 + chunkLength > file.size()) { throw std::runtime_error("truncated glb chunk!"); }
+
+              const uint8_t* payload = data + offset + 8;
+              if(chunkType == GLB_CHUNK_JSON)
+                {
+                  json = std::string_view{reinterpret_cast<const char*>(payload), chunkLength};
+                }
+              else if(chunkType == GLB_CHUNK_BIN && glbBinChunk.data == nullptr)
+                {
+                  glbBinChunk = {payload, chunkLength};
+                }
+              offset += 8 + chunkLength;
+            }
+          if(json.empty()) { throw std::runtime_error("glb file has no JSON chunk: " + filepath); }
+        }
+      else { json = std::string_view{reinterpret_cast<const char*>(file.data()), file.size()}; }
+
+      Core::JsonValue document = Core::JsonValue::parse(json);
+
+      // Buffers reference the mapped memory directly, nothing is copied
+      std::filesystem::path directory = std::filesystem::path(filepath).parent_path();
+      for(const auto& buffer : document["buffers"].asArray())
+        {
+          if(!buffer.has("uri"))
+            {
+              // Only the first buffer of a .glb may omit its uri, it refers to the BIN chunk
+              if(glbBinChunk.data == nullptr) { throw std::runtime_error("gltf buffer without data!"); }
+              buffers.push_back(glbBinChunk);
+              continue;
+            }
+
+          const std::string& uri = buffer["uri"].asString();
+          if(uri.rfind("data:", 0) == 0)
+            {
+              throw std::runtime_error("embedded base64 gltf buffers are not supported, use .glb or a .bin file!");
+            }
+          externalBuffers.push_back(std::make_unique<Platform::MappedFile>((directory / uri).string()));
+          buffers.push_back({externalBuffers.back()->data(), externalBuffers.back()->size()});
+          stats.bytes += externalBuffers.back()->size();
+        }
+
+      // Resolve every triangle primitive up front so each one knows where its output goes
+      std::vector<GltfPrimitive> primitives;
+      size_t totalVertices = 0;
+      size_t totalIndices = 0;
+      for(const auto& mesh : document["meshes"].asArray())
+        {
+          for(const auto& primitive : mesh["primitives"].asArray())
+            {
+              if(toEnum(primitive.numberOr("mode", GLTF_MODE_TRIANGLES)) != GLTF_MODE_TRIANGLES) { continue; }
+
+              const Core::JsonValue& attributes = primitive["attributes"];
+              if(!attributes.has("POSITION")) { continue; }
+
+              GltfPrimitive resolved{};
+              resolved.positions = resolveAccessor(document, buffers, toSize(attributes["POSITION"].asNumber()));
+              if(resolved.positions.componentType != GLTF_FLOAT || resolved.positions.componentCount != 3)
+                {
+                  throw std::runtime_error("gltf POSITION must be a float VEC3!");
+                }
+
+              if(attributes.has("COLOR_0"))
+                {
+                  resolved.colors = resolveAccessor(document, buffers, toSize(attributes["COLOR_0"].asNumber()));
+                  resolved.hasColors = true;
+                  if(resolved.colors.count < resolved.positions.count || resolved.colors.componentCount < 3)
+                    {
+                      throw std::runtime_error("gltf COLOR_0 does not match POSITION!");
+                    }
+                }
+
+              if(primitive.has("indices"))
+                {
+                  resolved.indices = resolveAccessor(document, buffers, toSize(primitive["indices"].asNumber()));
+                  resolved.hasIndices = true;
+                }
+
+              resolved.firstVertex = totalVertices;
+              resolved.firstIndex = totalIndices;
+              totalVertices += resolved.positions.count;
+              totalIndices += resolved.hasIndices ? resolved.indices.count : resolved.positions.count;
+              primitives.push_back(resolved);
+            }
+        }
+
+      if(totalVertices > UINT32_MAX)
+        {
+          throw std::runtime_error("gltf model has too many vertices for 32 bit indices!");
+        }
+
+      Mesh::Builder builder;
+      builder.vertices.resize(totalVertices);
+      builder.indices.resize(totalIndices);
+      stats.threadCount = static_cast<uint32_t>(std::min<size_t>(primitives.size(), workerCount()));
+
+      parallelFor(primitives.size(),
+                  [&](size_t p)
+                  {
+                    const GltfPrimitive& primitive = primitives[p];
+                    Mesh::Vertex* vertices = builder.vertices.data() + primitive.firstVertex;
+                    for(size_t i = 0; i < primitive.positions.count; i++)
+                      {
+                        const uint8_t* position = primitive.positions.data + primitive.positions.stride * i;
+                        std::memcpy(&vertices[i].position, position, sizeof(glm::vec3));
+
+                        vertices[i].color = {1.0f, 1.0f, 1.0f};
+                        if(primitive.hasColors)
+                          {
+                            const AccessorView& colors = primitive.colors;
+                            const uint8_t* color = colors.data + colors.stride * i;
+                            size_t size = componentSize(colors.componentType);
+                            for(int c = 0; c < 3; c++)
+                              {
+                                vertices[i].color[c] = readComponent(color + size * c, colors.componentType, true);
+                              }
+                          }
+                      }
+
+                    // Offset the primitive's local indices so every primitive lands in one shared vertex buffer
+                    uint32_t* indices = builder.indices.data() + primitive.firstIndex;
+                    uint32_t base = static_cast<uint32_t>(primitive.firstVertex);
+                    if(!primitive.hasIndices)
+                      {
+                        for(size_t i = 0; i < primitive.positions.count; i++)
+                          {
+                            indices[i] = base + static_cast<uint32_t>(i);
+                          }
+                        return;
+                      }
+                    for(size_t i = 0; i < primitive.indices.count; i++)
+                      {
+                        uint32_t index = readIndex(primitive.indices, i);
+                        if(index >= primitive.positions.count) { throw std::runtime_error("gltf index out of range!"); }
+                        indices[i] = base + index;
+                      }
+                  });
+
+      return builder;
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mesh.hpp"
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief Loads OBJ and glTF 2.0 (.gltf + .bin, .glb) geometry into a Mesh::Builder.
+     *
+     * Source files are memory mapped and parsed straight out of the mapping. OBJ text is split into newline aligned
+     * chunks that are parsed as Core::JobSystem jobs and then stitched together; glTF binary buffers are never
+     * copied, each triangle primitive is decoded from the mapped buffer into its own slice of the output by a job.
+     *
+     * Only positions and vertex colors are read since that is all Mesh::Vertex holds. Normals, texture coordinates
+     * and glTF node transforms are ignored, every primitive ends up in one mesh in model space.
+     */
+    class ModelLoader
+    {
+    public:
+      // Below this much work per chunk scheduling a job costs more than it saves
+      static constexpr size_t MIN_OBJ_CHUNK_BYTES = 1024 * 1024;
+
+      struct LoadStats
+      {
+        uint64_t bytes = 0;           ///< Bytes of source data parsed, including external glTF buffers.
+        double seconds = 0.0;         ///< Wall time from opening the file to a filled builder.
+        double megabytesPerSecond = 0.0;
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        uint32_t threadCount = 1;     ///< Threads used for the widest parallel phase.
+      };
+
+      /**
+       * @brief Loads a model, picking the format from the file extension.
+       * @param filepath Path to a .obj, .gltf or .glb file.
+       * @param stats Filled with throughput numbers if not null.
+       * @throws std::runtime_error on unsupported formats or malformed files.
+       */
+      static Mesh::Builder load(const std::string& filepath, LoadStats* stats = nullptr);
+
+    private:
+      static Mesh::Builder loadObj(const std::string& filepath, LoadStats& stats);
+      static Mesh::Builder loadGltf(const std::string& filepath, bool binary, LoadStats& stats);
+    };
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,330 @@
+#include "offscreen_target.hpp"
+#include "timeline.hpp"
+
+// std
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+
+    OffscreenTarget::OffscreenTarget(VulkanDevice& deviceRef, VkExtent2D extent, bool enableReadback,
+                                     uint32_t framesInFlight)
+        : device{deviceRef}, extent{extent}, readbackEnabled{enableReadback}, framesInFlight{framesInFlight}
+    {
+      depthFormat = device.findSupportedFormat(
+        {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT}, VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+      createImages();
+      createRenderPass();
+      createFramebuffers();
+      if(readbackEnabled) { createReadbackResources(); }
+      frameValues.assign(framesInFlight, 0);
+    }
+
+    OffscreenTarget::~OffscreenTarget()
+    {
+      if(!readbackCommandBuffers.empty())
+        {
+          vkFreeCommandBuffers(device.device(), device.getCommandPool(),
+                               static_cast<uint32_t>(readbackCommandBuffers.size()), readbackCommandBuffers.data());
+        }
+      for(size_t i = 0; i < readbackBuffers.size(); i++)
+        {
+          device.destroyBuffer(readbackBuffers[i], readbackAllocations[i]);
+        }
+
+      for(auto framebuffer : framebuffers) { vkDestroyFramebuffer(device.device(), framebuffer, nullptr); }
+
+      for(size_t i = 0; i < colorImages.size(); i++)
+        {
+          vkDestroyImageView(device.device(), colorImageViews[i], nullptr);
+          device.destroyImage(colorImages[i], colorImageAllocations[i]);
+
+          vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
+          device.destroyImage(depthImages[i], depthImageAllocations[i]);
+        }
+
+      vkDestroyRenderPass(device.device(), renderPass, nullptr);
+    }
+
+    VkResult OffscreenTarget::acquireNextImage(uint32_t* imageIndex)
+    {
+      auto waitStart = std::chrono::steady_clock::now();
+      device.graphicsTimeline().wait(frameValues[currentFrame]);
+      fenceWaitMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+
+      // Every frame slot owns its own image so there is nothing to acquire from a presentation engine
+      *imageIndex = static_cast<uint32_t>(currentFrame);
+      return VK_SUCCESS;
+    }
+
+    VkResult OffscreenTarget::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex)
+    {
+      std::array<VkCommandBuffer, 2> commandBuffers = {buffers[0], VK_NULL_HANDLE};
+      uint32_t commandBufferCount = 1;
+      if(readbackEnabled) { commandBuffers[commandBufferCount++] = readbackCommandBuffers[*imageIndex]; }
+
+      VkSubmitInfo submitInfo = {};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.commandBufferCount = commandBufferCount;
+      submitInfo.pCommandBuffers = commandBuffers.data();
+
+      VkResult result = device.graphicsTimeline().submit(submitInfo, &frameValues[currentFrame]);
+      if(result != VK_SUCCESS) { throw std::runtime_error("failed to submit offscreen command buffer!"); }
+
+      lastSubmittedImage = static_cast<int>(*imageIndex);
+      currentFrame = (currentFrame + 1) % framesInFlight;
+      return result;
+    }
+
+    bool OffscreenTarget::isPreviousFrameInFlight() const
+    {
+      size_t previousFrame = (currentFrame + framesInFlight - 1) % framesInFlight;
+      return !device.graphicsTimeline().isComplete(frameValues[previousFrame]);
+    }
+
+    bool OffscreenTarget::readbackLastFrame(std::vector<uint8_t>& pixels)
+    {
+      if(!readbackEnabled || lastSubmittedImage < 0) { return false; }
+
+      // Image index and frame slot are the same thing for offscreen targets
+      device.graphicsTimeline().wait(frameValues[lastSubmittedImage]);
+
+      VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+      pixels.resize(static_cast<size_t>(size));
+
+      // Readback buffers are host visible so their allocations stay mapped
+      memcpy(pixels.data(), readbackAllocations[lastSubmittedImage].mapped, static_cast<size_t>(size));
+      return true;
+    }
+
+    void OffscreenTarget::createImages()
+    {
+      colorImages.resize(framesInFlight);
+      colorImageAllocations.resize(framesInFlight);
+      colorImageViews.resize(framesInFlight);
+      depthImages.resize(framesInFlight);
+      depthImageAllocations.resize(framesInFlight);
+      depthImageViews.resize(framesInFlight);
+
+      for(size_t i = 0; i < colorImages.size(); i++)
+        {
+          VkImageCreateInfo imageInfo{};
+          imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+          imageInfo.imageType = VK_IMAGE_TYPE_2D;
+          imageInfo.extent.width = extent.width;
+          imageInfo.extent.height = extent.height;
+          imageInfo.extent.depth = 1;
+          imageInfo.mipLevels = 1;
+          imageInfo.arrayLayers = 1;
+          imageInfo.format = COLOR_FORMAT;
+          imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+          imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+          imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+          imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+          imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+          imageInfo.flags = 0;
+
+          device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImages[i],
+                                     colorImageAllocations[i]);
+
+          // Same image description for depth, only format and usage differ
+          imageInfo.format = depthFormat;
+          imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+          device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImages[i],
+                                     depthImageAllocations[i]);
+
+          VkImageViewCreateInfo viewInfo{};
+          viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+          viewInfo.image = colorImages[i];
+          viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+          viewInfo.format = COLOR_FORMAT;
+          viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+          viewInfo.subresourceRange.baseMipLevel = 0;
+          viewInfo.subresourceRange.levelCount = 1;
+          viewInfo.subresourceRange.baseArrayLayer = 0;
+          viewInfo.subresourceRange.layerCount = 1;
+
+          if(vkCreateImageView(device.device(), &viewInfo, nullptr, &colorImageViews[i]) != VK_SUCCESS)
+            {
+              throw std::runtime_error("failed to create offscreen color image view!");
+            }
+
+          viewInfo.image = depthImages[i];
+          viewInfo.format = depthFormat;
+          viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+          if(vkCreateImageView(device.device(), &viewInfo, nullptr, &depthImageViews[i]) != VK_SUCCESS)
+            {
+              throw std::runtime_error("failed to create offscreen depth image view!");
+            }
+        }
+    }
+
+    void OffscreenTarget::createRenderPass()
+    {
+      VkAttachmentDescription depthAttachment{};
+      depthAttachment.format = depthFormat;
+      depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+      depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+      VkAttachmentReference depthAttachmentRef{};
+      depthAttachmentRef.attachment = 1;
+      depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+      // Instead of PRESENT_SRC the color image ends up ready to be copied out
+      VkAttachmentDescription colorAttachment = {};
+      colorAttachment.format = COLOR_FORMAT;
+      colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+      colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+      colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+      colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+      VkAttachmentReference colorAttachmentRef = {};
+      colorAttachmentRef.attachment = 0;
+      colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+      VkSubpassDescription subpass = {};
+      subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+      subpass.colorAttachmentCount = 1;
+      subpass.pColorAttachments = &colorAttachmentRef;
+      subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+      std::array<VkSubpassDependency, 2> dependencies = {};
+      dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+      dependencies[0].dstSubpass = 0;
+      dependencies[0].srcStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+      dependencies[0].srcAccessMask = 0;
+      dependencies[0].dstStageMask =
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+      dependencies[0].dstAccessMask =
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+      // Make the color writes visible to the readback copy that follows the render pass
+      dependencies[1].srcSubpass = 0;
+      dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+      dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+      std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
+      VkRenderPassCreateInfo renderPassInfo = {};
+      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+      renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+      renderPassInfo.pAttachments = attachments.data();
+      renderPassInfo.subpassCount = 1;
+      renderPassInfo.pSubpasses = &subpass;
+      renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+      renderPassInfo.pDependencies = dependencies.data();
+
+      if(vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to create offscreen render pass!");
+        }
+    }
+
+    void OffscreenTarget::createFramebuffers()
+    {
+      framebuffers.resize(colorImages.size());
+      for(size_t i = 0; i < colorImages.size(); i++)
+        {
+          std::array<VkImageView, 2> attachments = {colorImageViews[i], depthImageViews[i]};
+
+          VkFramebufferCreateInfo framebufferInfo = {};
+          framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+          framebufferInfo.renderPass = renderPass;
+          framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+          framebufferInfo.pAttachments = attachments.data();
+          framebufferInfo.width = extent.width;
+          framebufferInfo.height = extent.height;
+          framebufferInfo.layers = 1;
+
+          if(vkCreateFramebuffer(device.device(), &framebufferInfo, nullptr, &framebuffers[i]) != VK_SUCCESS)
+            {
+              throw std::runtime_error("failed to create offscreen framebuffer!");
+            }
+        }
+    }
+
+    void OffscreenTarget::createReadbackResources()
+    {
+      VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+      readbackBuffers.resize(colorImages.size());
+      readbackAllocations.resize(colorImages.size());
+      readbackCommandBuffers.resize(colorImages.size());
+
+      VkCommandBufferAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocInfo.commandPool = device.getCommandPool();
+      allocInfo.commandBufferCount = static_cast<uint32_t>(readbackCommandBuffers.size());
+
+      if(vkAllocateCommandBuffers(device.device(), &allocInfo, readbackCommandBuffers.data()) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to allocate readback command buffers!");
+        }
+
+      for(size_t i = 0; i < colorImages.size(); i++)
+        {
+          device.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              readbackBuffers[i], readbackAllocations[i]);
+
+          // The copy never changes so it is recorded once and resubmitted after every frame
+          VkCommandBufferBeginInfo beginInfo{};
+          beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+          vkBeginCommandBuffer(readbackCommandBuffers[i], &beginInfo);
+
+          VkBufferImageCopy region{};
+          region.bufferOffset = 0;
+          region.bufferRowLength = 0;
+          region.bufferImageHeight = 0;
+          region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+          region.imageSubresource.mipLevel = 0;
+          region.imageSubresource.baseArrayLayer = 0;
+          region.imageSubresource.layerCount = 1;
+          region.imageOffset = {0, 0, 0};
+          region.imageExtent = {extent.width, extent.height, 1};
+
+          vkCmdCopyImageToBuffer(readbackCommandBuffers[i], colorImages[i], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                 readbackBuffers[i], 1, &region);
+
+          VkBufferMemoryBarrier barrier{};
+          barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+          barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+          barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+          barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.buffer = readbackBuffers[i];
+          barrier.offset = 0;
+          barrier.size = VK_WHOLE_SIZE;
+          vkCmdPipelineBarrier(readbackCommandBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                               0, nullptr, 1, &barrier, 0, nullptr);
+
+          if(vkEndCommandBuffer(readbackCommandBuffers[i]) != VK_SUCCESS)
+            {
+              throw std::runtime_error("failed to record readback command buffer!");
+            }
+        }
+    }
+
+  } // namespace Graphics
+} // namespace GameEngine
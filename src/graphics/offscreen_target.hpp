@@ -0,0 +1,97 @@
+#pragma once
+
+#include "render_target.hpp"
+#include "vulkan_device.hpp"
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief Headless render target backed by plain VkImages instead of a presentable swap chain.
+     *
+     * Used for benchmarking and golden image checks on machines without a window system. Each frame slot
+     * owns its own color/depth image so frames can stay in flight exactly like they do with the SwapChain.
+     * When readback is enabled every frame is also copied into a host visible buffer.
+     */
+    class OffscreenTarget : public RenderTarget
+    {
+    public:
+      static constexpr VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
+      /**
+       * @brief Creates the offscreen images, render pass and framebuffers.
+       * @param deviceRef Device used to create the images.
+       * @param extent Size of the images in pixels.
+       * @param enableReadback Copy every rendered image to host memory so it can be read back.
+       * @param framesInFlight Frame slots to cycle through, each with its own images. At most MAX_FRAMES_IN_FLIGHT.
+       */
+      OffscreenTarget(VulkanDevice& deviceRef, VkExtent2D extent, bool enableReadback,
+                      uint32_t framesInFlight = MAX_FRAMES_IN_FLIGHT);
+      ~OffscreenTarget();
+
+      OffscreenTarget(const OffscreenTarget&) = delete;
+      OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+      VkFramebuffer getFrameBuffer(int index) override { return framebuffers[index]; }
+      VkRenderPass getRenderPass() override { return renderPass; }
+      VkExtent2D getSwapChainExtent() override { return extent; }
+      size_t imageCount() override { return colorImages.size(); }
+      RenderPassFormats getRenderPassFormats() override { return {COLOR_FORMAT, depthFormat}; }
+
+      VkResult acquireNextImage(uint32_t* imageIndex) override;
+      VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) override;
+
+      bool isPreviousFrameInFlight() const override;
+      double getFenceWaitMs() const override { return fenceWaitMs; }
+
+      /**
+       * @brief Copies the most recently submitted frame into tightly packed RGBA8 pixels.
+       *
+       * Blocks until that frame has finished on the GPU. Requires readback to be enabled.
+       * @param[out] pixels Receives width * height * 4 bytes in sRGB encoding.
+       * @return false if readback is disabled or no frame has been submitted yet.
+       */
+      bool readbackLastFrame(std::vector<uint8_t>& pixels);
+
+    private:
+      void createImages();
+      void createRenderPass();
+      void createFramebuffers();
+      void createReadbackResources();
+
+      VulkanDevice& device;
+      VkExtent2D extent;
+      bool readbackEnabled;
+
+      VkRenderPass renderPass = VK_NULL_HANDLE;
+      VkFormat depthFormat;
+
+      std::vector<VkImage> colorImages;
+      std::vector<Allocation> colorImageAllocations;
+      std::vector<VkImageView> colorImageViews;
+      std::vector<VkImage> depthImages;
+      std::vector<Allocation> depthImageAllocations;
+      std::vector<VkImageView> depthImageViews;
+      std::vector<VkFramebuffer> framebuffers;
+
+      // One host visible buffer and a pre-recorded copy command per image
+      std::vector<VkBuffer> readbackBuffers;
+      std::vector<Allocation> readbackAllocations;
+      std::vector<VkCommandBuffer> readbackCommandBuffers;
+
+      std::vector<uint64_t> frameValues; // Graphics timeline value of each frame slot's last submit
+      uint32_t framesInFlight;
+      size_t currentFrame = 0;
+      int lastSubmittedImage = -1;
+      double fenceWaitMs = 0.0;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
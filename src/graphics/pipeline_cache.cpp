@@ -0,0 +1,206 @@
+#include "pipeline_cache.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    PipelineCache::PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string path,
+                                 bool creationFeedback)
+        : device{device}, properties{properties}, path{std::move(path)}, creationFeedback{creationFeedback}
+    {
+      std::vector<char> data;
+      std::ifstream file{this->path, std::ios::ate | std::ios::binary};
+      if(file.is_open())
+        {
+          data.resize(static_cast<size_t>(file.tellg()));
+          file.seekg(0);
+          file.read(data.data(), data.size());
+          if(!file) { data.clear(); }
+        }
+
+      std::string reason;
+      if(data.empty()) { std::cout << "pipeline cache: no cache at " << this->path << ", starting empty" << std::endl; }
+      else if(!isCompatible(data, reason))
+        {
+          std::cout << "pipeline cache: ignoring " << this->path << " (" << reason << ")" << std::endl;
+          data.clear();
+        }
+      else
+        {
+          loadedBytes = data.size();
+          std::cout << "pipeline cache: loaded " << loadedBytes << " bytes from " << this->path << std::endl;
+        }
+
+      VkPipelineCacheCreateInfo createInfo{};
+      createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+      createInfo.initialDataSize = data.size();
+      createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+      if(vkCreatePipelineCache(device, &createInfo, nullptr, &cache) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    PipelineCache::~PipelineCache()
+    {
+      save();
+      vkDestroyPipelineCache(device, cache, nullptr);
+    }
+
+    bool PipelineCache::isCompatible(const std::vector<char>& data, std::string& reason) const
+    {
+      VkPipelineCacheHeaderVersionOne header{};
+      if(data.size() < sizeof(header))
+        {
+          reason = "truncated header";
+          return false;
+        }
+      std::memcpy(&header, data.data(), sizeof(header));
+
+      if(header.headerSize < sizeof(header) || header.headerSize > data.size())
+        {
+          reason = "bad header size";
+          return false;
+        }
+      if(header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+        {
+          reason = "unknown header version";
+          return false;
+        }
+      if(header.vendorID != properties.vendorID || header.deviceID != properties.deviceID)
+        {
+          reason = "written by a different GPU";
+          return false;
+        }
+      if(std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        {
+          reason = "written by a different driver version";
+          return false;
+        }
+      return true;
+    }
+
+    VkResult PipelineCache::createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo,
+                                                   VkPipeline* pipeline)
+    {
+      VkGraphicsPipelineCreateInfo pipelineInfo = createInfo;
+
+      // Chained in front of whatever the caller passed, the driver fills it in during creation
+      VkPipelineCreationFeedbackEXT feedback{};
+      std::vector<VkPipelineCreationFeedbackEXT> stageFeedbacks(createInfo.stageCount);
+      VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+      if(creationFeedback)
+        {
+          feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+          feedbackInfo.pNext = createInfo.pNext;
+          feedbackInfo.pPipelineCreationFeedback = &feedback;
+          feedbackInfo.pipelineStageCreationFeedbackCount = createInfo.stageCount;
+          feedbackInfo.pPipelineStageCreationFeedbacks = stageFeedbacks.data();
+          pipelineInfo.pNext = &feedbackInfo;
+        }
+
+      auto start = std::chrono::steady_clock::now();
+      VkResult result = vkCreateGraphicsPipelines(device, cache, 1, &pipelineInfo, nullptr, pipeline);
+      recordCreation(std::chrono::steady_clock::now() - start, feedback);
+      return result;
+    }
+
+    VkResult PipelineCache::createComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline* pipeline)
+    {
+      VkComputePipelineCreateInfo pipelineInfo = createInfo;
+
+      VkPipelineCreationFeedbackEXT feedback{};
+      VkPipelineCreationFeedbackEXT stageFeedback{};
+      VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo{};
+      if(creationFeedback)
+        {
+          feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+          feedbackInfo.pNext = createInfo.pNext;
+          feedbackInfo.pPipelineCreationFeedback = &feedback;
+          feedbackInfo.pipelineStageCreationFeedbackCount = 1;
+          feedbackInfo.pPipelineStageCreationFeedbacks = &stageFeedback;
+          pipelineInfo.pNext = &feedbackInfo;
+        }
+
+      auto start = std::chrono::steady_clock::now();
+      VkResult result = vkCreateComputePipelines(device, cache, 1, &pipelineInfo, nullptr, pipeline);
+      recordCreation(std::chrono::steady_clock::now() - start, feedback);
+      return result;
+    }
+
+    void PipelineCache::recordCreation(std::chrono::steady_clock::duration elapsed,
+                                       const VkPipelineCreationFeedbackEXT& feedback)
+    {
+      creationNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                           std::memory_order_relaxed);
+      pipelinesCreated.fetch_add(1, std::memory_order_relaxed);
+      if((feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) &&
+         (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT))
+        {
+          cacheHits.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    bool PipelineCache::save()
+    {
+      size_t size = 0;
+      std::vector<char> data;
+      if(vkGetPipelineCacheData(device, cache, &size, nullptr) == VK_SUCCESS)
+        {
+          data.resize(size);
+          if(vkGetPipelineCacheData(device, cache, &size, data.data()) != VK_SUCCESS) { data.clear(); }
+          data.resize(std::min(size, data.size()));
+        }
+      if(data.empty())
+        {
+          std::cerr << "pipeline cache: failed to read cache data" << std::endl;
+          return false;
+        }
+
+      // Written next to the target and renamed over it, which replaces the file in one step on POSIX and Windows
+      std::string temporaryPath = path + ".tmp";
+      {
+        std::ofstream file{temporaryPath, std::ios::binary | std::ios::trunc};
+        file.write(data.data(), data.size());
+        file.flush();
+        if(!file)
+          {
+            std::cerr << "pipeline cache: failed to write " << temporaryPath << std::endl;
+            return false;
+          }
+      }
+
+      std::error_code error;
+      std::filesystem::rename(temporaryPath, path, error);
+      if(error)
+        {
+          std::cerr << "pipeline cache: failed to replace " << path << ": " << error.message() << std::endl;
+          std::filesystem::remove(temporaryPath, error);
+          return false;
+        }
+      return true;
+    }
+
+    PipelineCache::Stats PipelineCache::getStats() const
+    {
+      Stats stats{};
+      stats.pipelinesCreated = pipelinesCreated.load(std::memory_order_relaxed);
+      stats.cacheHits = cacheHits.load(std::memory_order_relaxed);
+      stats.cacheHitsKnown = creationFeedback;
+      stats.creationMs = creationNs.load(std::memory_order_relaxed) / 1e6;
+      stats.loadedBytes = loadedBytes;
+      return stats;
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,100 @@
+#pragma once
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief VkPipelineCache persisted to disk between runs.
+     *
+     * The cache file is loaded at startup and only handed to the driver if its header matches this device's vendor,
+     * device and pipeline cache UUID, a file from another GPU or driver version is ignored and replaced. On
+     * destruction its data is written to a temporary file that is then renamed over the old one, so a crash mid write
+     * never leaves a truncated cache behind. The driver synchronizes the cache, so pipelines may be created from
+     * several threads at once.
+     *
+     * Pipelines created through createGraphicsPipeline and createComputePipeline are timed, and counted as cache
+     * hits when the driver reports them through VK_EXT_pipeline_creation_feedback.
+     */
+    class PipelineCache
+    {
+    public:
+      static constexpr const char* DEFAULT_PATH = "pipeline_cache.bin";
+
+      struct Stats
+      {
+        uint32_t pipelinesCreated = 0;
+        uint32_t cacheHits = 0;
+        bool cacheHitsKnown = false; ///< False when the driver gives no creation feedback, cacheHits is then 0.
+        double creationMs = 0.0;     ///< CPU time spent inside vkCreate*Pipelines.
+        size_t loadedBytes = 0;      ///< Size of the cache file accepted at startup, 0 if none was.
+      };
+
+      /**
+       * @param creationFeedback VK_EXT_pipeline_creation_feedback is enabled on device.
+       */
+      PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string path,
+                    bool creationFeedback);
+      ~PipelineCache();
+
+      PipelineCache(const PipelineCache&) = delete;
+      PipelineCache& operator=(const PipelineCache&) = delete;
+
+      VkPipelineCache handle() const { return cache; }
+
+      /**
+       * @brief Creates a pipeline against the cache, recording how long it took and whether it was a cache hit.
+       * @return The vkCreateGraphicsPipelines result.
+       */
+      VkResult createGraphicsPipeline(const VkGraphicsPipelineCreateInfo& createInfo, VkPipeline* pipeline);
+
+      /**
+       * @brief Compute counterpart of createGraphicsPipeline.
+       * @return The vkCreateComputePipelines result.
+       */
+      VkResult createComputePipeline(const VkComputePipelineCreateInfo& createInfo, VkPipeline* pipeline);
+
+      /**
+       * @brief Writes the cache file atomically. Called on destruction.
+       * @return false if the file could not be written, the previous file is then left untouched.
+       */
+      bool save();
+
+      Stats getStats() const;
+
+    private:
+      /**
+       * @brief Checks a cache file's header against this device. Explains a rejection in reason.
+       */
+      bool isCompatible(const std::vector<char>& data, std::string& reason) const;
+
+      /**
+       * @brief Counts one created pipeline and its creation time, and a cache hit if feedback reports one.
+       */
+      void recordCreation(std::chrono::steady_clock::duration elapsed, const VkPipelineCreationFeedbackEXT& feedback);
+
+      VkDevice device;
+      VkPhysicalDeviceProperties properties;
+      std::string path;
+      bool creationFeedback;
+
+      VkPipelineCache cache = VK_NULL_HANDLE;
+
+      // Pipelines may be created from several threads at once
+      std::atomic<uint32_t> pipelinesCreated{0};
+      std::atomic<uint32_t> cacheHits{0};
+      std::atomic<uint64_t> creationNs{0};
+      size_t loadedBytes = 0;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
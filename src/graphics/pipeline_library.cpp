@@ -0,0 +1,294 @@
+#include "pipeline_library.hpp"
+
+// std
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    namespace
+    {
+      // FNV-1a fed field by field. Hashing whole create info structs would also hash their pointers and padding,
+      // neither of which is stable between runs
+      class StateHasher
+      {
+      public:
+        template <typename T> void add(const T& value)
+        {
+          static_assert(std::is_trivially_copyable_v<T>, "Only plain values can be hashed");
+          addBytes(&value, sizeof(T));
+        }
+
+        void addBytes(const void* data, size_t size)
+        {
+          const auto* bytes = static_cast<const uint8_t*>(data);
+          for(size_t i = 0; i < size; i++)
+            {
+              hash ^= bytes[i];
+              hash *= 1099511628211ull;
+            }
+        }
+
+        void addStencil(const VkStencilOpState& stencil)
+        {
+          add(stencil.failOp);
+          add(stencil.passOp);
+          add(stencil.depthFailOp);
+          add(stencil.compareOp);
+          add(stencil.compareMask);
+          add(stencil.writeMask);
+          add(stencil.reference);
+        }
+
+        void addSpecialization(const SpecializationConstants& constants)
+        {
+          VkSpecializationInfo info = constants.info();
+          add(info.mapEntryCount);
+          for(uint32_t i = 0; i < info.mapEntryCount; i++)
+            {
+              add(info.pMapEntries[i].constantID);
+              add(info.pMapEntries[i].offset);
+              add(info.pMapEntries[i].size);
+            }
+          add(info.dataSize);
+          addBytes(info.pData, info.dataSize);
+        }
+
+        uint64_t value() const { return hash; }
+
+      private:
+        uint64_t hash = 14695981039346656037ull;
+      };
+    } // namespace
+
+    PipelineLibrary::PipelineLibrary(VulkanDevice& device, Core::JobSystem& jobSystem)
+        : vulkanDevice{device}, jobs{jobSystem}
+    {
+    }
+
+    PipelineLibrary::~PipelineLibrary() { waitIdle(); }
+
+    PipelineLibrary::Key PipelineLibrary::hash(const PipelineDesc& desc)
+    {
+      assert(desc.config && "PipelineDesc without a config");
+      assert(desc.vertShader && desc.fragShader && "PipelineDesc shaders not loaded");
+      const PipelineConfigInfo& config = *desc.config;
+      StateHasher hasher;
+
+      // Shaders by content, so a rebuilt .spv is a new variant while a copy under another name is not. The registry
+      // hashed the code when loading it, which is the only time each file is read
+      hasher.add(desc.vertShader->contentHash());
+      hasher.add(desc.fragShader->contentHash());
+      hasher.addSpecialization(config.vertSpecialization);
+      hasher.addSpecialization(config.fragSpecialization);
+
+      for(const auto& binding : config.bindingDescriptions)
+        {
+          hasher.add(binding.binding);
+          hasher.add(binding.stride);
+          hasher.add(binding.inputRate);
+        }
+      for(const auto& attribute : config.attributeDescriptions)
+        {
+          hasher.add(attribute.location);
+          hasher.add(attribute.binding);
+          hasher.add(attribute.format);
+          hasher.add(attribute.offset);
+        }
+
+      hasher.add(config.inputAssemblyInfo.topology);
+      hasher.add(config.inputAssemblyInfo.primitiveRestartEnable);
+      hasher.add(config.viewportInfo.viewportCount);
+      hasher.add(config.viewportInfo.scissorCount);
+
+      const auto& rasterization = config.rasterizationInfo;
+      hasher.add(rasterization.depthClampEnable);
+      hasher.add(rasterization.rasterizerDiscardEnable);
+      hasher.add(rasterization.polygonMode);
+      hasher.add(rasterization.cullMode);
+      hasher.add(rasterization.frontFace);
+      hasher.add(rasterization.depthBiasEnable);
+      hasher.add(rasterization.depthBiasConstantFactor);
+      hasher.add(rasterization.depthBiasClamp);
+      hasher.add(rasterization.depthBiasSlopeFactor);
+      hasher.add(rasterization.lineWidth);
+
+      const auto& multisample = config.multisampleInfo;
+      hasher.add(multisample.rasterizationSamples);
+      hasher.add(multisample.sampleShadingEnable);
+      hasher.add(multisample.minSampleShading);
+      hasher.add(multisample.alphaToCoverageEnable);
+      hasher.add(multisample.alphaToOneEnable);
+
+      const auto& colorBlend = config.colorBlendInfo;
+      hasher.add(colorBlend.logicOpEnable);
+      hasher.add(colorBlend.logicOp);
+      hasher.add(colorBlend.blendConstants);
+      hasher.add(colorBlend.attachmentCount);
+      for(uint32_t i = 0; i < colorBlend.attachmentCount; i++)
+        {
+          const auto& attachment = colorBlend.pAttachments[i];
+          hasher.add(attachment.blendEnable);
+          hasher.add(attachment.srcColorBlendFactor);
+          hasher.add(attachment.dstColorBlendFactor);
+          hasher.add(attachment.colorBlendOp);
+          hasher.add(attachment.srcAlphaBlendFactor);
+          hasher.add(attachment.dstAlphaBlendFactor);
+          hasher.add(attachment.alphaBlendOp);
+          hasher.add(attachment.colorWriteMask);
+        }
+
+      const auto& depthStencil = config.depthStencilInfo;
+      hasher.add(depthStencil.depthTestEnable);
+      hasher.add(depthStencil.depthWriteEnable);
+      hasher.add(depthStencil.depthCompareOp);
+      hasher.add(depthStencil.depthBoundsTestEnable);
+      hasher.add(depthStencil.minDepthBounds);
+      hasher.add(depthStencil.maxDepthBounds);
+      hasher.add(depthStencil.stencilTestEnable);
+      hasher.addStencil(depthStencil.front);
+      hasher.addStencil(depthStencil.back);
+
+      for(VkDynamicState state : config.dynamicStateEnables) { hasher.add(state); }
+
+      // Layouts are not deduplicated, so the handle identifies one while it is alive. Owners call releaseLayout
+      // before destroying it, so a recycled handle never finds pipelines of the old layout. Render passes are only
+      // compared by what makes them compatible, so a swap chain recreated with the same formats reuses every pipeline
+      hasher.add(config.pipelineLayout);
+      hasher.add(config.renderPassFormats.color);
+      hasher.add(config.renderPassFormats.depth);
+      hasher.add(config.subpass);
+
+      return hasher.value();
+    }
+
+    PipelineLibrary::Entry& PipelineLibrary::findOrInsert(Key key, PipelineDesc& desc, bool& created)
+    {
+      requests.fetch_add(1, std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lock{mutex};
+      auto& slot = entries[key];
+      created = slot == nullptr;
+      if(created)
+        {
+          slot = std::make_unique<Entry>();
+          slot->layout = desc.config->pipelineLayout;
+          slot->desc = std::make_unique<PipelineDesc>(std::move(desc));
+        }
+      return *slot;
+    }
+
+    void PipelineLibrary::loadShaders(PipelineDesc& desc)
+    {
+      if(!desc.vertShader) { desc.vertShader = vulkanDevice.shaderRegistry().load(desc.vertFilepath); }
+      if(!desc.fragShader) { desc.fragShader = vulkanDevice.shaderRegistry().load(desc.fragFilepath); }
+    }
+
+    PipelineLibrary::Key PipelineLibrary::request(PipelineDesc desc)
+    {
+      loadShaders(desc);
+      Key key = hash(desc);
+      bool created;
+      Entry& entry = findOrInsert(key, desc, created);
+      if(!created) { return key; }
+
+      if(jobs.threadCount() == 1) { compile(entry); }
+      else { jobs.runBackground([this, &entry]() { compile(entry); }, &pending); }
+      return key;
+    }
+
+    PipelineLibrary::Key PipelineLibrary::compileNow(PipelineDesc desc)
+    {
+      loadShaders(desc);
+      Key key = hash(desc);
+      bool created;
+      Entry& entry = findOrInsert(key, desc, created);
+      if(created) { compile(entry); }
+      else if(entry.state.load(std::memory_order_acquire) == State::Compiling) { waitIdle(); }
+
+      if(entry.state.load(std::memory_order_acquire) != State::Ready)
+        {
+          throw std::runtime_error("failed to create graphics pipeline");
+        }
+      return key;
+    }
+
+    void PipelineLibrary::compile(Entry& entry)
+    {
+      // Runs on a worker, GraphicsPipeline only touches the shader registry and pipeline cache, which lock
+      try
+        {
+          const PipelineDesc& desc = *entry.desc;
+          entry.pipeline =
+            std::make_unique<GraphicsPipeline>(vulkanDevice, *desc.vertShader, *desc.fragShader, *desc.config);
+          entry.desc.reset();
+          entry.state.store(State::Ready, std::memory_order_release);
+        }
+      catch(const std::exception& error)
+        {
+          std::cerr << "pipeline library: " << error.what() << std::endl;
+          entry.desc.reset();
+          entry.state.store(State::Failed, std::memory_order_release);
+        }
+    }
+
+    GraphicsPipeline* PipelineLibrary::get(Key key, Key fallback)
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+
+      auto found = entries.find(key);
+      if(found != entries.end())
+        {
+          State state = found->second->state.load(std::memory_order_acquire);
+          if(state == State::Ready) { return found->second->pipeline.get(); }
+          if(state == State::Compiling) { stallsAvoided.fetch_add(1, std::memory_order_relaxed); }
+        }
+
+      auto fallbackEntry = entries.find(fallback);
+      assert(fallbackEntry != entries.end() &&
+             fallbackEntry->second->state.load(std::memory_order_acquire) == State::Ready &&
+             "Fallback pipeline must be compiled with compileNow");
+      return fallbackEntry->second->pipeline.get();
+    }
+
+    void PipelineLibrary::waitIdle() { jobs.wait(pending); }
+
+    void PipelineLibrary::releaseLayout(VkPipelineLayout layout)
+    {
+      // No worker may still be compiling into an entry that is about to go
+      waitIdle();
+
+      std::lock_guard<std::mutex> lock{mutex};
+      for(auto it = entries.begin(); it != entries.end();)
+        {
+          if(it->second->layout == layout) { it = entries.erase(it); }
+          else { it++; }
+        }
+    }
+
+    PipelineLibrary::Stats PipelineLibrary::getStats() const
+    {
+      Stats stats{};
+      stats.requests = requests.load(std::memory_order_relaxed);
+      stats.stallsAvoided = stallsAvoided.load(std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lock{mutex};
+      for(const auto& [key, entry] : entries)
+        {
+          switch(entry->state.load(std::memory_order_acquire))
+            {
+            case State::Compiling: stats.compiling++; break;
+            case State::Ready: stats.ready++; break;
+            case State::Failed: stats.failed++; break;
+            }
+        }
+      return stats;
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "graphics_pipeline.hpp"
+#include "../core/job_system.hpp"
+
+// std lib headers
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief Everything a pipeline is built from.
+     */
+    struct PipelineDesc
+    {
+      std::string vertFilepath;
+      std::string fragFilepath;
+      // On the heap so the pointers between its create infos stay valid while a worker compiles it
+      std::unique_ptr<PipelineConfigInfo> config;
+      // Loaded from the files by PipelineLibrary before hashing, held until the pipeline is compiled
+      std::shared_ptr<const ShaderModule> vertShader;
+      std::shared_ptr<const ShaderModule> fragShader;
+    };
+
+    /**
+     * @brief Graphics pipelines keyed by a stable hash of their state, compiled on JobSystem workers.
+     *
+     * The key covers every field of PipelineConfigInfo that ends up in the pipeline, the SPIR-V content of both
+     * stages, their specialization constants and the render pass's attachment formats. Requesting a variant that
+     * already exists, or is already compiling, costs a hash and a lookup.
+     *
+     * Draw code asks for a variant together with a fallback that was compiled up front. Until the variant is ready
+     * the fallback is returned instead of blocking the frame on the driver's compiler, and each such frame is
+     * counted as a stall avoided.
+     *
+     * Shader modules come from the device's ShaderRegistry, which keeps them past the compile so the next variant
+     * reuses them. Owners call ShaderRegistry::releaseUnused once they are done requesting a batch of pipelines.
+     */
+    class PipelineLibrary
+    {
+    public:
+      using Key = uint64_t;
+
+      struct Stats
+      {
+        uint32_t requests = 0;      ///< Calls to request and compileNow.
+        uint32_t ready = 0;         ///< Pipelines that can be bound.
+        uint32_t compiling = 0;     ///< Queued or compiling on a worker.
+        uint32_t failed = 0;        ///< Compiles that threw, their requests keep getting the fallback.
+        uint64_t stallsAvoided = 0; ///< Calls to get that returned the fallback because the variant was compiling.
+      };
+
+      PipelineLibrary(VulkanDevice& device, Core::JobSystem& jobSystem = Core::JobSystem::get());
+
+      /**
+       * @brief Waits for compiles still in flight.
+       */
+      ~PipelineLibrary();
+
+      PipelineLibrary(const PipelineLibrary&) = delete;
+      PipelineLibrary& operator=(const PipelineLibrary&) = delete;
+
+      /**
+       * @brief Stable key of desc. Its shader modules must be loaded, their content hashes stand in for the files.
+       */
+      static Key hash(const PipelineDesc& desc);
+
+      /**
+       * @brief Queues desc for compilation on a worker unless its key is already known.
+       *
+       * Compiles run as JobSystem background jobs, so frames waiting on their own jobs never pick one up. Without
+       * worker threads there is nobody to compile in the background, so it is compiled right away.
+       */
+      Key request(PipelineDesc desc);
+
+      /**
+       * @brief Compiles desc on the calling thread, or waits for it if it is already compiling. Meant for fallbacks.
+       * @throws std::runtime_error if compilation fails.
+       */
+      Key compileNow(PipelineDesc desc);
+
+      /**
+       * @brief The pipeline for key, or the one for fallback while key is still compiling (or failed to).
+       *
+       * fallback must be ready, compile it with compileNow.
+       */
+      GraphicsPipeline* get(Key key, Key fallback);
+
+      /**
+       * @brief Blocks until every queued compile has finished. Call before destroying layouts or render passes
+       * referenced by pending requests.
+       */
+      void waitIdle();
+
+      /**
+       * @brief Waits for pending compiles, then drops every pipeline built with layout. Call right before layout is
+       * destroyed: the driver may hand the same handle to a new layout, which must not find the old pipelines.
+       *
+       * Pipelines go through the DeletionQueue, so frames still in flight may keep drawing with them. Keys of the
+       * dropped pipelines must not be passed to get afterwards.
+       */
+      void releaseLayout(VkPipelineLayout layout);
+
+      Stats getStats() const;
+
+    private:
+      enum class State
+      {
+        Compiling,
+        Ready,
+        Failed,
+      };
+
+      struct Entry
+      {
+        std::atomic<State> state{State::Compiling};
+        std::unique_ptr<GraphicsPipeline> pipeline;
+        std::unique_ptr<PipelineDesc> desc; // Released once compiled
+        VkPipelineLayout layout = VK_NULL_HANDLE; // Part of the key, kept for releaseLayout
+      };
+
+      /**
+       * @brief Returns the entry for key, creating it from desc if there is none.
+       * @param[out] created True if the entry is new and must be compiled by the caller.
+       */
+      Entry& findOrInsert(Key key, PipelineDesc& desc, bool& created);
+      void loadShaders(PipelineDesc& desc);
+      void compile(Entry& entry);
+
+      VulkanDevice& vulkanDevice;
+      Core::JobSystem& jobs;
+      Core::JobCounter pending; // Every compile queued on the job system
+
+      mutable std::mutex mutex;
+      // Only erased by releaseLayout once compiles are done, so Entry references stay valid while compiling
+      std::unordered_map<Key, std::unique_ptr<Entry>> entries;
+
+      std::atomic<uint32_t> requests{0};
+      std::atomic<uint64_t> stallsAvoided{0};
+    };
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,32 @@
+#include "presentation_policy.hpp"
+
+// std
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    const char* presentModeName(VkPresentModeKHR mode)
+    {
+      switch(mode)
+        {
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "relaxed";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        default: return "unknown";
+        }
+    }
+
+    VkPresentModeKHR parsePresentMode(const std::string& name)
+    {
+      for(VkPresentModeKHR mode : {VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+                                   VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR})
+        {
+          if(name == presentModeName(mode)) { return mode; }
+        }
+      throw std::invalid_argument("unknown present mode: " + name);
+    }
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "render_target.hpp"
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <string>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief How frames are queued and presented, picked per deployment to trade throughput against latency.
+     *
+     * The defaults keep the previous behaviour: mailbox when the surface supports it, one image more than the
+     * surface minimum, two frames in flight and no frame rate cap.
+     */
+    struct PresentationPolicy
+    {
+      /// Preferred present mode. FIFO is used when the surface does not support it, it is the one mode every
+      /// surface has.
+      VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+
+      /// Swap chain images to ask for, clamped to what the surface allows. 0 asks for the surface minimum + 1.
+      uint32_t imageCount = 0;
+
+      /// Frames the CPU may record ahead of the GPU, 1 to RenderTarget::MAX_FRAMES_IN_FLIGHT. Fewer means less
+      /// latency, more lets the CPU and GPU overlap.
+      uint32_t framesInFlight = 2;
+
+      /// CPU side frame rate cap in frames per second, 0 disables it.
+      double frameRateCap = 0.0;
+    };
+
+    /**
+     * @brief Lower case name of mode as used on the command line, e.g. "mailbox".
+     */
+    const char* presentModeName(VkPresentModeKHR mode);
+
+    /**
+     * @brief Parses fifo, relaxed, mailbox or immediate.
+     * @throws std::invalid_argument for any other name.
+     */
+    VkPresentModeKHR parsePresentMode(const std::string& name);
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,68 @@
+#pragma once
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstddef>
+#include <cstdint>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief Attachment formats of a render pass. Render passes with equal formats are compatible, so a pipeline built
+     * against one can be used with any of them.
+     */
+    struct RenderPassFormats
+    {
+      VkFormat color = VK_FORMAT_UNDEFINED;
+      VkFormat depth = VK_FORMAT_UNDEFINED;
+    };
+
+    /**
+     * @brief Common interface for anything the Renderer can record frames into.
+     *
+     * Implemented by the window backed SwapChain and by the headless OffscreenTarget so the
+     * Renderer's beginFrame/endFrame contract does not depend on a window system.
+     */
+    class RenderTarget
+    {
+    public:
+      // Upper bound for per frame resources, PresentationPolicy::framesInFlight picks how many slots are cycled
+      static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+      virtual ~RenderTarget() = default;
+
+      virtual VkFramebuffer getFrameBuffer(int index) = 0;
+      virtual VkRenderPass getRenderPass() = 0;
+      virtual VkExtent2D getSwapChainExtent() = 0;
+      virtual size_t imageCount() = 0;
+      virtual RenderPassFormats getRenderPassFormats() = 0;
+
+      /**
+       * @brief Waits for the current frame slot and returns the image to render into.
+       * @param[out] imageIndex Index of the framebuffer to use for this frame.
+       */
+      virtual VkResult acquireNextImage(uint32_t* imageIndex) = 0;
+
+      /**
+       * @brief Submits the recorded frame and advances to the next frame slot.
+       * @param buffers Command buffer recorded for this frame.
+       * @param imageIndex Image returned by acquireNextImage.
+       */
+      virtual VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) = 0;
+
+      /**
+       * @brief Checks if the GPU is still executing the frame submitted before the current one.
+       */
+      virtual bool isPreviousFrameInFlight() const = 0;
+
+      /**
+       * @brief Time the CPU spent blocked waiting for a free frame slot during the last acquire/submit pair.
+       */
+      virtual double getFenceWaitMs() const = 0;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
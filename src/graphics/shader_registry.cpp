@@ -0,0 +1,113 @@
+#include "shader_registry.hpp"
+#include "../platform/mapped_file.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    namespace
+    {
+      constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+    } // namespace
+
+    ShaderRegistry::ShaderRegistry(VkDevice device) : device{device} {}
+
+    ShaderRegistry::~ShaderRegistry()
+    {
+      for(auto& [key, shaderModule] : modules)
+        {
+          // Every pipeline is built by now, a module still held elsewhere would outlive its device
+          assert(shaderModule.use_count() == 1 && "Shader module still held when the registry is destroyed");
+          vkDestroyShaderModule(device, shaderModule->module, nullptr);
+        }
+    }
+
+    uint64_t ShaderRegistry::hashCode(const uint32_t* code, size_t wordCount)
+    {
+      uint64_t hash = 14695981039346656037ull;
+      for(size_t i = 0; i < wordCount; i++)
+        {
+          hash ^= code[i];
+          hash *= 1099511628211ull;
+        }
+      return hash;
+    }
+
+    std::shared_ptr<const ShaderModule> ShaderRegistry::load(const std::string& filepath)
+    {
+      Platform::MappedFile file{filepath};
+
+      // The mapping is page aligned, so unlike a std::vector<char> it always satisfies pCode's 4 byte alignment
+      const auto* code = reinterpret_cast<const uint32_t*>(file.data());
+      if(file.size() < sizeof(uint32_t) || file.size() % sizeof(uint32_t) != 0 || code[0] != SPIRV_MAGIC)
+        {
+          throw std::runtime_error("invalid SPIR-V file: " + filepath);
+        }
+
+      size_t wordCount = file.size() / sizeof(uint32_t);
+      Key key{hashCode(code, wordCount), file.size()};
+
+      std::lock_guard<std::mutex> lock{mutex};
+      loads++;
+
+      auto [first, last] = modules.equal_range(key);
+      for(auto it = first; it != last; it++)
+        {
+          if(std::equal(code, code + wordCount, it->second->code.begin())) { return it->second; }
+        }
+
+      auto shaderModule = std::make_shared<ShaderModule>();
+      shaderModule->hash = key.first;
+      shaderModule->code.assign(code, code + wordCount);
+
+      VkShaderModuleCreateInfo createInfo{};
+      createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+      createInfo.codeSize = file.size();
+      createInfo.pCode = code;
+
+      if(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule->module) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to create shader module: " + filepath);
+        }
+      modulesCreated++;
+
+      modules.emplace(key, shaderModule);
+      return shaderModule;
+    }
+
+    uint32_t ShaderRegistry::releaseUnused()
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+
+      // Only the registry's own reference left, and new ones are only handed out under the lock
+      uint32_t released = 0;
+      for(auto it = modules.begin(); it != modules.end();)
+        {
+          if(it->second.use_count() == 1)
+            {
+              vkDestroyShaderModule(device, it->second->module, nullptr);
+              it = modules.erase(it);
+              released++;
+            }
+          else { it++; }
+        }
+      return released;
+    }
+
+    ShaderRegistry::Stats ShaderRegistry::getStats() const
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+
+      Stats stats{};
+      stats.loads = loads;
+      stats.modulesCreated = modulesCreated;
+      stats.liveModules = static_cast<uint32_t>(modules.size());
+      return stats;
+    }
+  } // namespace Graphics
+} // namespace GameEngine
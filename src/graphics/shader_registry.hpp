@@ -0,0 +1,149 @@
+#pragma once
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief Values for a shader's constant_id specialization constants, baked in when the pipeline is compiled.
+     *
+     * Lets one SPIR-V module produce several variants (feature toggles, array sizes, loop counts) without extra
+     * shader files. Empty by default, which leaves every constant at the default declared in the shader.
+     */
+    class SpecializationConstants
+    {
+    public:
+      /**
+       * @brief Sets constant constantId. Use uint32_t (or VkBool32) for bool constants, int32_t and float otherwise.
+       */
+      template <typename T> SpecializationConstants& set(uint32_t constantId, const T& value)
+      {
+        static_assert(std::is_trivially_copyable_v<T>, "Specialization constants must be plain scalars");
+
+        VkSpecializationMapEntry entry{};
+        entry.constantID = constantId;
+        entry.offset = static_cast<uint32_t>(data.size());
+        entry.size = sizeof(T);
+        entries.push_back(entry);
+
+        data.resize(data.size() + sizeof(T));
+        std::memcpy(data.data() + entry.offset, &value, sizeof(T));
+        return *this;
+      }
+
+      bool empty() const { return entries.empty(); }
+
+      /**
+       * @brief Info pointing into this object, valid while it is alive and unchanged.
+       */
+      VkSpecializationInfo info() const
+      {
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+        specializationInfo.pMapEntries = entries.data();
+        specializationInfo.dataSize = data.size();
+        specializationInfo.pData = data.data();
+        return specializationInfo;
+      }
+
+    private:
+      std::vector<VkSpecializationMapEntry> entries;
+      std::vector<uint8_t> data;
+    };
+
+    /**
+     * @brief A VkShaderModule shared by every pipeline built from the same SPIR-V.
+     */
+    class ShaderModule
+    {
+    public:
+      VkShaderModule handle() const { return module; }
+
+      /**
+       * @brief Hash of the SPIR-V the registry looked the module up by, stable between runs.
+       */
+      uint64_t contentHash() const { return hash; }
+
+    private:
+      friend class ShaderRegistry;
+
+      VkShaderModule module = VK_NULL_HANDLE;
+      uint64_t hash = 0;
+      std::vector<uint32_t> code; // Compared against on a hash match, so a collision never shares the wrong module
+    };
+
+    /**
+     * @brief Device wide cache of shader modules, deduplicated by the content of their SPIR-V.
+     *
+     * SPIR-V files are memory mapped, so pCode points straight at the page aligned mapping. Modules are looked up by a
+     * hash of the code and the bytes are compared on a match: pipelines loading the same file, or identical code
+     * under another name, share one VkShaderModule.
+     *
+     * The registry keeps every module it created until releaseUnused, so pipelines built one after another share
+     * modules too. Callers release after a batch of pipelines has been built, modules a pending build still holds
+     * are kept. Safe to use from several threads.
+     */
+    class ShaderRegistry
+    {
+    public:
+      struct Stats
+      {
+        uint32_t loads = 0;          ///< Calls to load.
+        uint32_t modulesCreated = 0; ///< vkCreateShaderModule calls, loads minus those that reused a module.
+        uint32_t liveModules = 0;    ///< Modules the registry currently holds.
+      };
+
+      explicit ShaderRegistry(VkDevice device);
+
+      /**
+       * @brief Destroys every module. None may be held outside the registry any more.
+       */
+      ~ShaderRegistry();
+
+      ShaderRegistry(const ShaderRegistry&) = delete;
+      ShaderRegistry& operator=(const ShaderRegistry&) = delete;
+
+      /**
+       * @brief Returns the module for the SPIR-V at filepath, reusing one with the same code.
+       * @throws std::runtime_error if the file cannot be mapped, is not SPIR-V, or module creation fails.
+       */
+      std::shared_ptr<const ShaderModule> load(const std::string& filepath);
+
+      /**
+       * @brief Destroys the modules nobody but the registry holds, call once a batch of pipelines is built.
+       * @return Number of modules destroyed.
+       */
+      uint32_t releaseUnused();
+
+      Stats getStats() const;
+
+    private:
+      // FNV-1a over the code's words together with its size. Different code with the same key is rare but possible,
+      // such modules sit side by side under one key
+      using Key = std::pair<uint64_t, size_t>;
+
+      static uint64_t hashCode(const uint32_t* code, size_t wordCount);
+
+      VkDevice device;
+
+      mutable std::mutex mutex;
+      std::multimap<Key, std::shared_ptr<ShaderModule>> modules;
+      uint32_t loads = 0;
+      uint32_t modulesCreated = 0;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
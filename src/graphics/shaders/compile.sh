@@ -6,14 +6,17 @@ GLSLC="/home/Angel/Programs/Vulkan_SDK/1.4.313.0/x86_64/bin/glslc"
 # Source shader file paths
 VERTEX_SHADER="simple_shader.vert"
 FRAGMENT_SHADER="simple_shader.frag"
+CULL_SHADER="cull.comp"
 
 # Output SPIR-V file paths
 OUTPUT_VERTEX_SPIRV="../../../build/Shaders/simple_shader.vert.spv"
 OUTPUT_FRAGMENT_SPIRV="../../../build/Shaders/simple_shader.frag.spv"
+OUTPUT_CULL_SPIRV="../../../build/Shaders/cull.comp.spv"
 
 # Compile shaders to SPIR-V
 $GLSLC $VERTEX_SHADER -o $OUTPUT_VERTEX_SPIRV
 $GLSLC $FRAGMENT_SHADER -o $OUTPUT_FRAGMENT_SPIRV
+$GLSLC $CULL_SHADER -o $OUTPUT_CULL_SPIRV
 
 echo "Shader compilation completed."
 
@@ -1,17 +1,34 @@
 #version 460
 
-layout(location = 0) in vec2 position;
+// Per vertex, binding 0 (Mesh::Vertex). Compact vertex formats store the position relative to the mesh bounds
+layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 
+// Per instance, binding 1 (RenderSystem::InstanceData)
+layout(location = 2) in mat4 instanceTransform;
+layout(location = 6) in vec4 instanceColor;
 
-// Order needs to match the simplePushConstantData struct.
-layout(push_constant) uniform Push {
-    mat2 transform;
-    vec2 offset;
-    vec3 color;
-} push;
+layout(location = 0) out vec3 fragColor;
+
+// Off in RenderSystem's fallback variant, which draws plain vertex colors while the full one compiles
+layout(constant_id = 0) const bool USE_INSTANCE_COLOR = true;
+
+// Written once per frame (RenderSystem::GlobalUbo), bound with a dynamic offset into the frame ring
+layout(set = 0, binding = 0) uniform GlobalUbo
+{
+    mat4 viewProjection;
+} ubo;
+
+// Pushed per draw (Mesh::Dequantization), maps the stored position back to model space
+layout(push_constant) uniform Dequantization
+{
+    vec4 scale;
+    vec4 offset;
+} dequantization;
 
 void main() 
 {
-    gl_Position = vec4(push.transform * position + push.offset, 0.0, 1.0);
+    vec3 modelPosition = position * dequantization.scale.xyz + dequantization.offset.xyz;
+    gl_Position = ubo.viewProjection * instanceTransform * vec4(modelPosition, 1.0);
+    fragColor = USE_INSTANCE_COLOR ? color * instanceColor.rgb : color;
 }
@@ -0,0 +1,308 @@
+#include "staging_ring.hpp"
+#include "timeline.hpp"
+#include "vulkan_device.hpp"
+
+// std
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+
+    StagingRing::StagingRing(VulkanDevice& deviceRef)
+        : device{deviceRef},
+          transferOwnership{deviceRef.needsOwnershipTransfer(QueueType::Transfer, QueueType::Graphics)}
+    {
+      // Own pools so batch command buffers can be reset individually without touching the device's pools
+      auto createCommandBuffers = [this](uint32_t queueFamily, VkCommandPool& pool)
+      {
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = queueFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+        if(vkCreateCommandPool(device.device(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
+          {
+            throw std::runtime_error("failed to create staging command pool!");
+          }
+
+        std::array<VkCommandBuffer, MAX_BATCHES_IN_FLIGHT> commandBuffers;
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = pool;
+        allocInfo.commandBufferCount = MAX_BATCHES_IN_FLIGHT;
+
+        if(vkAllocateCommandBuffers(device.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+          {
+            throw std::runtime_error("failed to allocate staging command buffers!");
+          }
+        return commandBuffers;
+      };
+
+      auto commandBuffers = createCommandBuffers(device.queueFamily(QueueType::Transfer), commandPool);
+      for(uint32_t i = 0; i < MAX_BATCHES_IN_FLIGHT; i++) { batches[i].commandBuffer = commandBuffers[i]; }
+
+      if(transferOwnership)
+        {
+          auto acquireCommandBuffers =
+            createCommandBuffers(device.queueFamily(QueueType::Graphics), acquireCommandPool);
+          for(uint32_t i = 0; i < MAX_BATCHES_IN_FLIGHT; i++)
+            {
+              batches[i].acquireCommandBuffer = acquireCommandBuffers[i];
+            }
+        }
+
+      device.createBuffer(CAPACITY, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ringBuffer,
+                          ringAllocation);
+
+      // Host visible allocations are persistently mapped by the allocator
+      mappedRing = static_cast<uint8_t*>(ringAllocation.mapped);
+    }
+
+    StagingRing::~StagingRing()
+    {
+      waitIdle();
+
+      vkDestroyCommandPool(device.device(), commandPool, nullptr);
+      if(acquireCommandPool != VK_NULL_HANDLE) { vkDestroyCommandPool(device.device(), acquireCommandPool, nullptr); }
+
+      device.destroyBuffer(ringBuffer, ringAllocation);
+    }
+
+    void StagingRing::uploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+    {
+      if(size == 0) { return; }
+
+      VkBufferCopy copyRegion{};
+      copyRegion.dstOffset = dstOffset;
+      copyRegion.size = size;
+
+      if(size > MAX_RING_UPLOAD)
+        {
+          // Too big to share the ring, stage it in a temporary buffer that dies with the batch
+          VkBuffer stagingBuffer;
+          Allocation stagingAllocation;
+          device.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              stagingBuffer, stagingAllocation);
+          memcpy(stagingAllocation.mapped, data, static_cast<size_t>(size));
+
+          VkCommandBuffer commandBuffer = recordingCommandBuffer();
+          recordingBatch().oversizedBuffers.push_back({stagingBuffer, stagingAllocation});
+          vkCmdCopyBuffer(commandBuffer, stagingBuffer, dstBuffer, 1, &copyRegion);
+        }
+      else
+        {
+          uint64_t ringOffset = allocate(size);
+          memcpy(mappedRing + ringOffset, data, static_cast<size_t>(size));
+
+          copyRegion.srcOffset = ringOffset;
+          vkCmdCopyBuffer(recordingCommandBuffer(), ringBuffer, dstBuffer, 1, &copyRegion);
+        }
+
+      if(transferOwnership)
+        {
+          std::vector<VkBuffer>& destinations = recordingBatch().destinations;
+          if(destinations.empty() || destinations.back() != dstBuffer) { destinations.push_back(dstBuffer); }
+        }
+
+      stats.uploads++;
+      stats.bytesUploaded += size;
+    }
+
+    void StagingRing::flush()
+    {
+      if(!recording) { return; }
+
+      Batch& batch = recordingBatch();
+
+      if(transferOwnership)
+        {
+          // Several uploads into one buffer need a single transfer
+          std::sort(batch.destinations.begin(), batch.destinations.end());
+          batch.destinations.erase(std::unique(batch.destinations.begin(), batch.destinations.end()),
+                                   batch.destinations.end());
+          for(VkBuffer buffer : batch.destinations)
+            {
+              device.releaseBufferOwnership(batch.commandBuffer, buffer, QueueType::Transfer, QueueType::Graphics,
+                                            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            }
+        }
+      else
+        {
+          // Make the copies visible to vertex input of every later submission on this queue
+          VkMemoryBarrier barrier{};
+          barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+          barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+          barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+          vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                               VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+      if(vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to record staging command buffer!");
+        }
+
+      VkSubmitInfo submitInfo{};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+      if(device.submit(QueueType::Transfer, submitInfo, &batch.value) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to submit staging command buffer!");
+        }
+      if(transferOwnership) { submitOwnershipAcquire(batch); }
+
+      batch.ringEnd = head;
+      batchesInFlight++;
+      recording = false;
+      stats.batchesSubmitted++;
+    }
+
+    void StagingRing::waitIdle()
+    {
+      flush();
+      while(batchesInFlight > 0) { waitOldestBatch(); }
+    }
+
+    void StagingRing::submitOwnershipAcquire(Batch& batch)
+    {
+      vkResetCommandBuffer(batch.acquireCommandBuffer, 0);
+
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      vkBeginCommandBuffer(batch.acquireCommandBuffer, &beginInfo);
+
+      for(VkBuffer buffer : batch.destinations)
+        {
+          device.acquireBufferOwnership(batch.acquireCommandBuffer, buffer, QueueType::Transfer, QueueType::Graphics,
+                                        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT);
+        }
+
+      if(vkEndCommandBuffer(batch.acquireCommandBuffer) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to record staging acquire command buffer!");
+        }
+
+      // Only vertex input waits for the copies, whatever the graphics queue is running meanwhile keeps going
+      VkSemaphore waitSemaphore = device.timeline(QueueType::Transfer).semaphore();
+      VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+      VkSubmitInfo submitInfo{};
+      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+      submitInfo.waitSemaphoreCount = 1;
+      submitInfo.pWaitSemaphores = &waitSemaphore;
+      submitInfo.pWaitDstStageMask = &waitStage;
+      submitInfo.commandBufferCount = 1;
+      submitInfo.pCommandBuffers = &batch.acquireCommandBuffer;
+
+      if(device.submit(QueueType::Graphics, submitInfo, &batch.acquireValue, &batch.value) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to submit staging acquire command buffer!");
+        }
+    }
+
+    VkCommandBuffer StagingRing::recordingCommandBuffer()
+    {
+      if(recording) { return recordingBatch().commandBuffer; }
+
+      retireCompletedBatches();
+      if(batchesInFlight == MAX_BATCHES_IN_FLIGHT)
+        {
+          stats.stalls++;
+          waitOldestBatch();
+        }
+
+      Batch& batch = recordingBatch();
+      vkResetCommandBuffer(batch.commandBuffer, 0);
+
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+
+      recording = true;
+      return batch.commandBuffer;
+    }
+
+    uint64_t StagingRing::allocate(VkDeviceSize size)
+    {
+      for(;;)
+        {
+          // Nothing pending, restart at the beginning so the whole capacity is available without wrapping
+          if(batchesInFlight == 0 && tail == head)
+            {
+              head = 0;
+              tail = 0;
+            }
+
+          uint64_t start = (head + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+          uint64_t ringOffset = start % CAPACITY;
+          if(ringOffset + size > CAPACITY) { start += CAPACITY - ringOffset; } // Never split an upload across the end
+
+          if(start + size - tail <= CAPACITY)
+            {
+              head = start + size;
+              return start % CAPACITY;
+            }
+
+          // Out of space: reclaim finished batches first, then wait on the oldest, and if the space is held by the
+          // batch being recorded submit it so it can be waited on
+          uint32_t inFlightBefore = batchesInFlight;
+          retireCompletedBatches();
+          if(batchesInFlight != inFlightBefore) { continue; }
+
+          if(batchesInFlight > 0)
+            {
+              stats.stalls++;
+              waitOldestBatch();
+            }
+          else { flush(); }
+        }
+    }
+
+    void StagingRing::retireCompletedBatches()
+    {
+      while(batchesInFlight > 0 && isBatchComplete(batches[oldestBatch])) { retireBatch(batches[oldestBatch]); }
+    }
+
+    bool StagingRing::isBatchComplete(const Batch& batch)
+    {
+      // The timelines cache what they have seen complete, so checking batch after batch rarely asks the driver
+      return device.timeline(QueueType::Transfer).isComplete(batch.value) &&
+             device.graphicsTimeline().isComplete(batch.acquireValue);
+    }
+
+    void StagingRing::waitOldestBatch()
+    {
+      if(batchesInFlight == 0) { return; }
+
+      Batch& batch = batches[oldestBatch];
+      device.timeline(QueueType::Transfer).wait(batch.value);
+      device.graphicsTimeline().wait(batch.acquireValue);
+      retireBatch(batch);
+    }
+
+    void StagingRing::retireBatch(Batch& batch)
+    {
+      for(auto& [buffer, allocation] : batch.oversizedBuffers) { device.destroyBuffer(buffer, allocation); }
+      batch.oversizedBuffers.clear();
+      batch.destinations.clear();
+
+      // Batches complete in submission order on a single queue, so the tail only moves forward
+      tail = batch.ringEnd;
+      oldestBatch = (oldestBatch + 1) % MAX_BATCHES_IN_FLIGHT;
+      batchesInFlight--;
+    }
+
+  } // namespace Graphics
+} // namespace GameEngine
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "memory_allocator.hpp"
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    class VulkanDevice;
+
+    /**
+     * @brief Persistently mapped staging buffer used as a ring to upload data into DEVICE_LOCAL buffers.
+     *
+     * Uploads are memcpy'd into the ring and their copies recorded into one command buffer per batch. flush submits
+     * the batch to the transfer queue through its timeline and never waits, so uploads overlap frames in flight.
+     * Ring space is handed back once the timeline has reached the batch's value.
+     *
+     * When the transfer queue is in a family of its own the batch releases every destination buffer to the
+     * graphics family, and a small acquire batch is submitted to the graphics queue right behind it, waiting on the
+     * transfer timeline. Otherwise the batch ends with a barrier making the copies visible to vertex input. Either
+     * way the graphics queue sees the uploads before any frame submitted after the flush.
+     *
+     * Only new or otherwise unused destinations may be written: the ring does not synchronise against frames still
+     * reading from the destination buffer. Not thread safe, call it from the thread that submits frames.
+     */
+    class StagingRing
+    {
+    public:
+      static constexpr VkDeviceSize CAPACITY = 32 * 1024 * 1024;
+      static constexpr VkDeviceSize ALIGNMENT = 16;
+      // Larger uploads get their own temporary staging buffer instead of stalling the ring
+      static constexpr VkDeviceSize MAX_RING_UPLOAD = CAPACITY / 4;
+      static constexpr uint32_t MAX_BATCHES_IN_FLIGHT = 4;
+
+      struct Stats
+      {
+        uint64_t bytesUploaded = 0;
+        uint32_t uploads = 0;
+        uint32_t batchesSubmitted = 0;
+        uint32_t stalls = 0; // Times the CPU had to wait on a batch for ring space
+      };
+
+      StagingRing(VulkanDevice& device);
+      ~StagingRing();
+
+      StagingRing(const StagingRing&) = delete;
+      StagingRing& operator=(const StagingRing&) = delete;
+
+      /**
+       * @brief Copies data into the ring and records a copy into dstBuffer for the next flush.
+       * @param dstBuffer Destination buffer, needs VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+       * @param dstOffset Byte offset into the destination buffer.
+       * @param data Source data, may be freed as soon as this returns.
+       * @param size Number of bytes to upload.
+       */
+      void uploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+      /**
+       * @brief Submits every upload recorded since the last flush. Does nothing if there are none.
+       */
+      void flush();
+
+      /**
+       * @brief Flushes and blocks until every submitted batch has completed.
+       */
+      void waitIdle();
+
+      const Stats& getStats() const { return stats; }
+
+    private:
+      struct Batch
+      {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE; // Graphics side of the ownership transfers
+        uint64_t value = 0;        // Transfer timeline value signaled when the copies complete
+        uint64_t acquireValue = 0; // Graphics timeline value of the acquire batch, 0 without ownership transfers
+        uint64_t ringEnd = 0; // Ring head when the batch was submitted, space up to here is free once it completes
+        std::vector<std::pair<VkBuffer, Allocation>> oversizedBuffers;
+        std::vector<VkBuffer> destinations; // Buffers written by the batch, released to the graphics family
+      };
+
+      VkCommandBuffer recordingCommandBuffer();
+      Batch& recordingBatch() { return batches[(oldestBatch + batchesInFlight) % MAX_BATCHES_IN_FLIGHT]; }
+      void submitOwnershipAcquire(Batch& batch);
+      bool isBatchComplete(const Batch& batch);
+      uint64_t allocate(VkDeviceSize size);
+      void retireCompletedBatches();
+      void waitOldestBatch();
+      void retireBatch(Batch& batch);
+
+      VulkanDevice& device;
+      bool transferOwnership; // The transfer queue is in another family than graphics
+      VkCommandPool commandPool = VK_NULL_HANDLE;
+      VkCommandPool acquireCommandPool = VK_NULL_HANDLE; // Graphics family, only with ownership transfers
+
+      VkBuffer ringBuffer = VK_NULL_HANDLE;
+      Allocation ringAllocation{};
+      uint8_t* mappedRing = nullptr;
+
+      // Monotonic byte positions, the ring offset is position % CAPACITY
+      uint64_t head = 0;
+      uint64_t tail = 0;
+
+      std::array<Batch, MAX_BATCHES_IN_FLIGHT> batches;
+      uint32_t oldestBatch = 0;
+      uint32_t batchesInFlight = 0;
+      bool recording = false;
+
+      Stats stats;
+    };
+  } // namespace Graphics
+} // namespace GameEngine
@@ -1,25 +1,31 @@
 #include "swap_chain.hpp"
+#include "timeline.hpp"
 
 // std
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <limits>
 #include <stdexcept>
+#include <utility>
 
 namespace GameEngine
 {
   namespace Graphics
   {
 
-    SwapChain::SwapChain(VulkanDevice& deviceRef, VkExtent2D extent) : device{deviceRef}, windowExtent{extent}
+    SwapChain::SwapChain(VulkanDevice& deviceRef, VkExtent2D extent, const PresentationPolicy& policy)
+        : policy{policy}, device{deviceRef}, windowExtent{extent}
     {
       SwapChain::init();
     }
 
-    SwapChain::SwapChain(VulkanDevice& deviceRef, VkExtent2D extent, std::shared_ptr<SwapChain> previous)
-        : device{deviceRef}, windowExtent{extent}, oldSwapChain{previous}
+    SwapChain::SwapChain(VulkanDevice& deviceRef, VkExtent2D extent, const PresentationPolicy& policy,
+                         std::shared_ptr<SwapChain> previous)
+        : policy{policy}, device{deviceRef}, windowExtent{extent}, oldSwapChain{previous}
     {
       SwapChain::init();
 
@@ -31,10 +37,20 @@ namespace GameEngine
     {
       createSwapChain();
       createImageViews();
-      createRenderPass();
+      swapChainDepthFormat = findDepthFormat();
+
+      // A resize keeps the formats, so the previous pass, and every pipeline built against it, stays valid
+      if(oldSwapChain != nullptr && compareSwapFormats(*oldSwapChain))
+        {
+          renderPass = std::exchange(oldSwapChain->renderPass, VK_NULL_HANDLE);
+        }
+      else { createRenderPass(); }
+
       createDepthResources();
       createFramebuffers();
-      createSyncObjects();
+
+      if(oldSwapChain != nullptr) { adoptSyncObjects(*oldSwapChain); }
+      else { createSyncObjects(); }
     }
 
     SwapChain::~SwapChain()
@@ -51,27 +67,28 @@ namespace GameEngine
       for(int i = 0; i < depthImages.size(); i++)
         {
           vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
-          vkDestroyImage(device.device(), depthImages[i], nullptr);
-          vkFreeMemory(device.device(), depthImageMemories[i], nullptr);
-          std::cout << "THIS IS THE PROBLEM AREA 2" << std::endl;
+          device.destroyImage(depthImages[i], depthImageAllocations[i]);
         }
 
       for(auto framebuffer : swapChainFramebuffers) { vkDestroyFramebuffer(device.device(), framebuffer, nullptr); }
 
-      vkDestroyRenderPass(device.device(), renderPass, nullptr);
+      if(renderPass != VK_NULL_HANDLE) { vkDestroyRenderPass(device.device(), renderPass, nullptr); }
 
-      // cleanup synchronization objects
-      for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+      // cleanup synchronization objects, unless the next swap chain took them over
+      for(size_t i = 0; i < imageAvailableSemaphores.size(); i++)
         {
           vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
           vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
-          vkDestroyFence(device.device(), inFlightFences[i], nullptr);
         }
     }
 
     VkResult SwapChain::acquireNextImage(uint32_t* imageIndex)
     {
-      vkWaitForFences(device.device(), 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+      // Only block on the frame that last used the slot we are about to reuse, the others keep running on the GPU
+      auto waitStart = std::chrono::steady_clock::now();
+      device.graphicsTimeline().wait(frameValues[currentFrame]);
+      fenceWaitMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
 
       VkResult result =
         vkAcquireNextImageKHR(device.device(), swapChain, std::numeric_limits<uint64_t>::max(),
@@ -83,12 +100,8 @@ namespace GameEngine
 
     VkResult SwapChain::submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex)
     {
-      if(imagesInFlight[*imageIndex] != VK_NULL_HANDLE)
-        {
-          vkWaitForFences(device.device(), 1, &imagesInFlight[*imageIndex], VK_TRUE, UINT64_MAX);
-        }
-      imagesInFlight[*imageIndex] = inFlightFences[currentFrame];
-
+      // No per image wait: everything a frame records against its image waits on that image's acquire semaphore, and
+      // the CPU side resources belong to the frame slot whose value acquireNextImage already waited for
       VkSubmitInfo submitInfo = {};
       submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
@@ -105,8 +118,7 @@ namespace GameEngine
       submitInfo.signalSemaphoreCount = 1;
       submitInfo.pSignalSemaphores = signalSemaphores;
 
-      vkResetFences(device.device(), 1, &inFlightFences[currentFrame]);
-      if(vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS)
+      if(device.graphicsTimeline().submit(submitInfo, &frameValues[currentFrame]) != VK_SUCCESS)
         {
           throw std::runtime_error("failed to submit draw command buffer!");
         }
@@ -125,20 +137,30 @@ namespace GameEngine
 
       auto result = vkQueuePresentKHR(device.presentQueue(), &presentInfo);
 
-      currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+      currentFrame = (currentFrame + 1) % policy.framesInFlight;
 
       return result;
     }
 
+    bool SwapChain::isPreviousFrameInFlight() const
+    {
+      size_t previousFrame = (currentFrame + policy.framesInFlight - 1) % policy.framesInFlight;
+      return !device.graphicsTimeline().isComplete(frameValues[previousFrame]);
+    }
+
     void SwapChain::createSwapChain()
     {
       SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
       VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-      VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+      presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
       VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
       uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+      if(policy.imageCount > 0)
+        {
+          imageCount = std::max(policy.imageCount, swapChainSupport.capabilities.minImageCount);
+        }
       if(swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
         {
           imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -222,7 +244,7 @@ namespace GameEngine
     void SwapChain::createRenderPass()
     {
       VkAttachmentDescription depthAttachment{};
-      depthAttachment.format = findDepthFormat();
+      depthAttachment.format = swapChainDepthFormat;
       depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
       depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
       depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -307,12 +329,11 @@ namespace GameEngine
 
     void SwapChain::createDepthResources()
     {
-      VkFormat depthFormat = findDepthFormat();
-      swapChainImageFormat = depthFormat;
+      VkFormat depthFormat = swapChainDepthFormat;
       VkExtent2D swapChainExtent = getSwapChainExtent();
 
       depthImages.resize(imageCount());
-      depthImageMemories.resize(imageCount());
+      depthImageAllocations.resize(imageCount());
       depthImageViews.resize(imageCount());
 
       for(int i = 0; i < depthImages.size(); i++)
@@ -334,7 +355,7 @@ namespace GameEngine
           imageInfo.flags = 0;
 
           device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImages[i],
-                                     depthImageMemories[i]);
+                                     depthImageAllocations[i]);
 
           VkImageViewCreateInfo viewInfo{};
           viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -356,29 +377,38 @@ namespace GameEngine
 
     void SwapChain::createSyncObjects()
     {
-      imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-      renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-      inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-      imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
+      imageAvailableSemaphores.resize(policy.framesInFlight);
+      renderFinishedSemaphores.resize(policy.framesInFlight);
+      frameValues.assign(policy.framesInFlight, 0); // 0 is reached from the start, no slot has to wait
 
       VkSemaphoreCreateInfo semaphoreInfo = {};
       semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-      VkFenceCreateInfo fenceInfo = {};
-      fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-      fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-      for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+      for(size_t i = 0; i < policy.framesInFlight; i++)
         {
           if(vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-             vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-             vkCreateFence(device.device(), &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+             vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS)
             {
               throw std::runtime_error("failed to create synchronization objects for a frame!");
             }
         }
     }
 
+    void SwapChain::adoptSyncObjects(SwapChain& previous)
+    {
+      // The timeline values belong to frames, not images: the next acquire of a slot still waits for the frame the
+      // old swap chain submitted from it. The semaphores are unsignaled between frames, since a present that returns
+      // out of date still waits on its semaphore
+      imageAvailableSemaphores = std::move(previous.imageAvailableSemaphores);
+      renderFinishedSemaphores = std::move(previous.renderFinishedSemaphores);
+      frameValues = std::move(previous.frameValues);
+      currentFrame = previous.currentFrame;
+
+      previous.imageAvailableSemaphores.clear();
+      previous.renderFinishedSemaphores.clear();
+      previous.frameValues.clear();
+    }
+
     VkSurfaceFormatKHR SwapChain::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
     {
       for(const auto& availableFormat : availableFormats)
@@ -397,21 +427,15 @@ namespace GameEngine
     {
       for(const auto& availablePresentMode : availablePresentModes)
         {
-          if(availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-            {
-              std::cout << "Present mode: Mailbox" << std::endl;
-              return availablePresentMode;
-            }
+          if(availablePresentMode == policy.presentMode) { return availablePresentMode; }
         }
 
-      // for (const auto &availablePresentMode : availablePresentModes) {
-      //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-      //     std::cout << "Present mode: Immediate" << std::endl;
-      //     return availablePresentMode;
-      //   }
-      // }
-
-      std::cout << "Present mode: V-Sync" << std::endl;
+      // Only worth mentioning once, not on every resize
+      if(oldSwapChain == nullptr)
+        {
+          std::cerr << "present mode " << presentModeName(policy.presentMode) << " is not supported, using fifo"
+                    << std::endl;
+        }
       return VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "presentation_policy.hpp"
+#include "render_target.hpp"
 #include "vulkan_device.hpp"
 
 // Vulkan headers
@@ -14,25 +16,34 @@ namespace GameEngine
   namespace Graphics
   {
 
-    class SwapChain
+    class SwapChain : public RenderTarget
     {
     public:
-      static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+      SwapChain(VulkanDevice& deviceRef, VkExtent2D windowExtent, const PresentationPolicy& policy);
 
-      SwapChain(VulkanDevice& deviceRef, VkExtent2D windowExtent);
-      // Constructor to take in the previous swap chain
-      SwapChain(VulkanDevice& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
+      /**
+       * @brief Replaces previous, which is retired but stays valid for the frames already recorded against it.
+       *
+       * The frame semaphores and timeline values move over from previous, so the frames still in flight keep
+       * pacing the CPU and the frame slot carries on where it was. When the formats did not change the render pass
+       * moves over as well, along with every pipeline built against it. previous keeps its images, depth buffers
+       * and framebuffers and can be destroyed once the frames using them have completed.
+       */
+      SwapChain(VulkanDevice& deviceRef, VkExtent2D windowExtent, const PresentationPolicy& policy,
+                std::shared_ptr<SwapChain> previous);
       ~SwapChain();
 
       SwapChain(const SwapChain&) = delete;
       SwapChain& operator=(const SwapChain&) = delete;
 
-      VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
-      VkRenderPass getRenderPass() { return renderPass; }
+      VkFramebuffer getFrameBuffer(int index) override { return swapChainFramebuffers[index]; }
+      VkRenderPass getRenderPass() override { return renderPass; }
       VkImageView getImageView(int index) { return swapChainImageViews[index]; }
-      size_t imageCount() { return swapChainImages.size(); }
+      size_t imageCount() override { return swapChainImages.size(); }
       VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
-      VkExtent2D getSwapChainExtent() { return swapChainExtent; }
+      VkPresentModeKHR getPresentMode() const { return presentMode; }
+      RenderPassFormats getRenderPassFormats() override { return {swapChainImageFormat, swapChainDepthFormat}; }
+      VkExtent2D getSwapChainExtent() override { return swapChainExtent; }
       uint32_t width() { return swapChainExtent.width; }
       uint32_t height() { return swapChainExtent.height; }
 
@@ -42,8 +53,11 @@ namespace GameEngine
       }
       VkFormat findDepthFormat();
 
-      VkResult acquireNextImage(uint32_t* imageIndex);
-      VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex);
+      VkResult acquireNextImage(uint32_t* imageIndex) override;
+      VkResult submitCommandBuffers(const VkCommandBuffer* buffers, uint32_t* imageIndex) override;
+
+      bool isPreviousFrameInFlight() const override;
+      double getFenceWaitMs() const override { return fenceWaitMs; }
 
       bool compareSwapFormats(const SwapChain& swapChain) const
       {
@@ -59,26 +73,29 @@ namespace GameEngine
       void createRenderPass();
       void createFramebuffers();
       void createSyncObjects();
+      void adoptSyncObjects(SwapChain& previous);
 
       // Helper functions
       VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
       /**
-       * @breif This is the present mode for frames
+       * @brief The policy's present mode if the surface supports it, FIFO otherwise.
        *
-       * Other Modes FIFO, Mailbox, Immediate. See notes.txt for pros and cons of each mode
+       * See notes.txt for pros and cons of each mode
        **/
       VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
       VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
+      PresentationPolicy policy;
+      VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
       VkFormat swapChainImageFormat;
       VkFormat swapChainDepthFormat;
       VkExtent2D swapChainExtent;
 
       std::vector<VkFramebuffer> swapChainFramebuffers;
-      VkRenderPass renderPass;
+      VkRenderPass renderPass = VK_NULL_HANDLE; // Null once handed to the next swap chain
 
       std::vector<VkImage> depthImages;
-      std::vector<VkDeviceMemory> depthImageMemories;
+      std::vector<Allocation> depthImageAllocations;
       std::vector<VkImageView> depthImageViews;
       std::vector<VkImage> swapChainImages;
       std::vector<VkImageView> swapChainImageViews;
@@ -96,9 +113,11 @@ namespace GameEngine
        **/
       std::vector<VkSemaphore> imageAvailableSemaphores;
       std::vector<VkSemaphore> renderFinishedSemaphores;
-      std::vector<VkFence> inFlightFences;
-      std::vector<VkFence> imagesInFlight;
+      // Graphics timeline value each frame slot's last submit signals, the slot is free again once it is reached
+      std::vector<uint64_t> frameValues;
       size_t currentFrame = 0;
+
+      double fenceWaitMs = 0.0; // Spent in acquireNextImage waiting for the frame slot to be free
     };
   } // namespace Graphics
 } // namespace GameEngine
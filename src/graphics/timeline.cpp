@@ -0,0 +1,118 @@
+#include "timeline.hpp"
+
+// std
+#include <array>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    Timeline::Timeline(VkDevice device, VkQueue queue) : device{device}, submitQueue{queue}
+    {
+      getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(
+        vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+      waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+      if(getSemaphoreCounterValue == nullptr || waitSemaphores == nullptr)
+        {
+          throw std::runtime_error("failed to load timeline semaphore functions!");
+        }
+
+      VkSemaphoreTypeCreateInfo typeInfo{};
+      typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+      typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+      typeInfo.initialValue = 0;
+
+      VkSemaphoreCreateInfo createInfo{};
+      createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      createInfo.pNext = &typeInfo;
+
+      if(vkCreateSemaphore(device, &createInfo, nullptr, &timeline) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to create timeline semaphore!");
+        }
+    }
+
+    Timeline::~Timeline() { vkDestroySemaphore(device, timeline, nullptr); }
+
+    VkResult Timeline::submit(const VkSubmitInfo& submitInfo, uint64_t* signaledValue, const uint64_t* waitValues)
+    {
+      assert(submitInfo.waitSemaphoreCount <= MAX_SUBMIT_SEMAPHORES &&
+             submitInfo.signalSemaphoreCount < MAX_SUBMIT_SEMAPHORES && "Too many semaphores for one submit");
+
+      // Binary semaphores ignore their values but the counts have to match
+      std::array<uint64_t, MAX_SUBMIT_SEMAPHORES> allWaitValues{};
+      std::array<uint64_t, MAX_SUBMIT_SEMAPHORES> signalValues{};
+      for(uint32_t i = 0; waitValues != nullptr && i < submitInfo.waitSemaphoreCount; i++)
+        {
+          allWaitValues[i] = waitValues[i];
+        }
+      std::array<VkSemaphore, MAX_SUBMIT_SEMAPHORES> signalSemaphores{};
+      for(uint32_t i = 0; i < submitInfo.signalSemaphoreCount; i++)
+        {
+          signalSemaphores[i] = submitInfo.pSignalSemaphores[i];
+        }
+      uint32_t signalCount = submitInfo.signalSemaphoreCount;
+      signalSemaphores[signalCount] = timeline;
+
+      VkTimelineSemaphoreSubmitInfo timelineInfo{};
+      timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+      timelineInfo.pNext = submitInfo.pNext;
+      timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+      timelineInfo.pWaitSemaphoreValues = allWaitValues.data();
+      timelineInfo.signalSemaphoreValueCount = signalCount + 1;
+      timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+      VkSubmitInfo timelineSubmit = submitInfo;
+      timelineSubmit.pNext = &timelineInfo;
+      timelineSubmit.signalSemaphoreCount = signalCount + 1;
+      timelineSubmit.pSignalSemaphores = signalSemaphores.data();
+
+      std::lock_guard<std::mutex> lock{submitMutex};
+      uint64_t value = lastSubmitted.load(std::memory_order_relaxed) + 1;
+      signalValues[signalCount] = value;
+
+      VkResult result = vkQueueSubmit(submitQueue, 1, &timelineSubmit, VK_NULL_HANDLE);
+      if(result == VK_SUCCESS)
+        {
+          lastSubmitted.store(value, std::memory_order_release);
+          if(signaledValue != nullptr) { *signaledValue = value; }
+        }
+      return result;
+    }
+
+    uint64_t Timeline::getCompleted() const
+    {
+      uint64_t value = 0;
+      getSemaphoreCounterValue(device, timeline, &value);
+
+      // Concurrent queries may finish out of order, never let the cached value go backwards
+      uint64_t known = knownCompleted.load(std::memory_order_relaxed);
+      while(value > known && !knownCompleted.compare_exchange_weak(known, value, std::memory_order_relaxed)) {}
+      return value > known ? value : known;
+    }
+
+    bool Timeline::isComplete(uint64_t value) const
+    {
+      if(value <= knownCompleted.load(std::memory_order_relaxed)) { return true; }
+      return value <= getCompleted();
+    }
+
+    void Timeline::wait(uint64_t value) const
+    {
+      if(isComplete(value)) { return; }
+
+      VkSemaphoreWaitInfo waitInfo{};
+      waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+      waitInfo.semaphoreCount = 1;
+      waitInfo.pSemaphores = &timeline;
+      waitInfo.pValues = &value;
+      waitSemaphores(device, &waitInfo, std::numeric_limits<uint64_t>::max());
+
+      uint64_t known = knownCompleted.load(std::memory_order_relaxed);
+      while(value > known && !knownCompleted.compare_exchange_weak(known, value, std::memory_order_relaxed)) {}
+    }
+  } // namespace Graphics
+} // namespace GameEngine
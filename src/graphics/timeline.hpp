@@ -0,0 +1,85 @@
+#pragma once
+
+// Vulkan headers
+#include <vulkan/vulkan.h>
+
+// std lib headers
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief A VK_KHR_timeline_semaphore counting the submissions made to one queue.
+     *
+     * Every submit through it signals the next value, so "has submission N finished" is a single comparison against
+     * the semaphore's counter instead of a fence per submission. Frames, uploads and deferred releases all remember
+     * the value of the submit that used them and wait on or poll for that value.
+     *
+     * Values only mean something for the queue they were submitted to: signals have to happen in increasing order,
+     * which only a single queue guarantees. Submitting is thread safe.
+     */
+    class Timeline
+    {
+    public:
+      // Semaphores a submit may wait on or signal besides the timeline itself
+      static constexpr uint32_t MAX_SUBMIT_SEMAPHORES = 8;
+
+      Timeline(VkDevice device, VkQueue queue);
+      ~Timeline();
+
+      Timeline(const Timeline&) = delete;
+      Timeline& operator=(const Timeline&) = delete;
+
+      VkSemaphore semaphore() const { return timeline; }
+      VkQueue queue() const { return submitQueue; }
+
+      /**
+       * @brief Submits submitInfo to the queue, additionally signaling the timeline with the next value.
+       *
+       * Binary semaphores in submitInfo keep working as before. To wait for work on another queue, add that queue's
+       * timeline semaphore to the wait semaphores and pass the value to wait for in waitValues.
+       * @param[out] signaledValue Value the timeline reaches once the submission has completed.
+       * @param waitValues One value per wait semaphore, ignored for binary ones. nullptr if every wait is binary.
+       */
+      VkResult submit(const VkSubmitInfo& submitInfo, uint64_t* signaledValue, const uint64_t* waitValues = nullptr);
+
+      /**
+       * @brief Value signaled by the most recent submit.
+       */
+      uint64_t getLastSubmitted() const { return lastSubmitted.load(std::memory_order_acquire); }
+
+      /**
+       * @brief Queries the semaphore's counter, every submission up to it has completed.
+       */
+      uint64_t getCompleted() const;
+
+      /**
+       * @brief Checks if the submission that signals value has completed, without asking the driver when a previous
+       * query already showed it did.
+       */
+      bool isComplete(uint64_t value) const;
+
+      /**
+       * @brief Blocks until the submission that signals value has completed. Values of 0 return immediately.
+       */
+      void wait(uint64_t value) const;
+
+    private:
+      VkDevice device;
+      VkQueue submitQueue;
+      VkSemaphore timeline = VK_NULL_HANDLE;
+
+      // Loaded from the device, the instance is created for Vulkan 1.0 where these only exist as extension functions
+      PFN_vkGetSemaphoreCounterValue getSemaphoreCounterValue = nullptr;
+      PFN_vkWaitSemaphores waitSemaphores = nullptr;
+
+      std::mutex submitMutex; // Values must reach the queue in the order they were handed out
+      std::atomic<uint64_t> lastSubmitted{0};
+      mutable std::atomic<uint64_t> knownCompleted{0};
+    };
+  } // namespace Graphics
+} // namespace GameEngine
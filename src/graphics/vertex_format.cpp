@@ -0,0 +1,37 @@
+#include "vertex_format.hpp"
+
+// std
+#include <stdexcept>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    const char* vertexFormatName(VertexFormat format)
+    {
+      switch(format)
+        {
+        case VertexFormat::Float32: return "float32";
+        case VertexFormat::Snorm16: return "snorm16";
+        case VertexFormat::Half: return "half";
+        default: return "unknown";
+        }
+    }
+
+    VertexFormat parseVertexFormat(const std::string& name)
+    {
+      for(VertexFormat format : {VertexFormat::Float32, VertexFormat::Snorm16, VertexFormat::Half})
+        {
+          if(name == vertexFormatName(format)) { return format; }
+        }
+      throw std::invalid_argument("unknown vertex format: " + name);
+    }
+
+    uint32_t vertexFormatStride(VertexFormat format)
+    {
+      // Positions: three floats, or four 16 bit values since three component 16 bit formats are optional for vertex
+      // buffers. Colors: three floats, or four bytes
+      return format == VertexFormat::Float32 ? 2 * 3 * sizeof(float) : 4 * sizeof(uint16_t) + 4 * sizeof(uint8_t);
+    }
+  } // namespace Graphics
+} // namespace GameEngine
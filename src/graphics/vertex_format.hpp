@@ -0,0 +1,42 @@
+#pragma once
+
+// std lib headers
+#include <cstdint>
+#include <string>
+
+namespace GameEngine
+{
+  namespace Graphics
+  {
+    /**
+     * @brief How a Mesh stores its vertices on the GPU. Chosen per mesh, pipelines drawing it must use the same one.
+     *
+     * The compact formats store positions relative to the mesh's bounding box, mapped to [-1, 1] per axis, and
+     * colors as R8G8B8A8_UNORM, 12 bytes per vertex instead of 24. The vertex shader maps positions back with the
+     * mesh's Mesh::Dequantization push constants. Every format is one the spec requires for vertex buffers, so none
+     * needs a support check.
+     */
+    enum class VertexFormat : uint32_t
+    {
+      Float32, ///< R32G32B32_SFLOAT position and color, exact.
+      Snorm16, ///< R16G16B16A16_SNORM position, steps of 1/32767 of the half extent on each axis.
+      Half,    ///< R16G16B16A16_SFLOAT position, finer near the box center and coarser towards its faces.
+    };
+
+    /**
+     * @brief Lower case name of format as used on the command line, e.g. "snorm16".
+     */
+    const char* vertexFormatName(VertexFormat format);
+
+    /**
+     * @brief Parses float32, snorm16 or half.
+     * @throws std::invalid_argument for any other name.
+     */
+    VertexFormat parseVertexFormat(const std::string& name);
+
+    /**
+     * @brief Bytes per vertex in the vertex buffer.
+     */
+    uint32_t vertexFormatStride(VertexFormat format);
+  } // namespace Graphics
+} // namespace GameEngine
@@ -1,8 +1,13 @@
 #include "vulkan_device.hpp"
+#include "deletion_queue.hpp"
+#include "staging_ring.hpp"
+#include "timeline.hpp"
 
 // std headers
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <map>
 #include <set>
 #include <unordered_set>
 
@@ -37,24 +42,47 @@ namespace GameEngine
   }
 
   // class member functions
-  Graphics::VulkanDevice::VulkanDevice(Platform::VulkanWindow& window) : window{window}
+  Graphics::VulkanDevice::VulkanDevice(Platform::VulkanWindow* window) : window{window}
   {
+    if(isHeadless()) { deviceExtensions.clear(); }
+    // Every queue submission is tracked through a timeline semaphore
+    deviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
     createInstance();      // Create vulkan instance (Connection between engine and vulkan)
     setupDebugMessenger(); // Vulkan has little validation so enable validation layers (Disable for release builds)
     createSurface();       // Linking engine window and vulkan
     pickPhysicalDevice();  // Picks device on system capable of working with vulkan
     createLogicalDevice(); // What features of our device we will use
     createCommandPool();   // helps with command buffer alloc
+    createQueueTimelines();
+    memoryAllocator_ = std::make_unique<MemoryAllocator>(physicalDevice, device_);
+    deletionQueue_ = std::make_unique<DeletionQueue>(*this);
+    stagingRing_ = std::make_unique<StagingRing>(*this);
+    pipelineCache_ = std::make_unique<PipelineCache>(device_, properties, PipelineCache::DEFAULT_PATH,
+                                                     pipelineCreationFeedback);
+    shaderRegistry_ = std::make_unique<ShaderRegistry>(device_);
   }
 
   Graphics::VulkanDevice::~VulkanDevice()
   {
+    // Whatever was released after the Renderer went away still needs the GPU to finish with it
+    vkDeviceWaitIdle(device_);
+    deletionQueue_.reset();
+    stagingRing_.reset(); // Waits for outstanding uploads before the device goes away
+    pipelineCache_.reset(); // Saves the cache for the next run
+    shaderRegistry_.reset();
+    memoryAllocator_.reset();
+    computeTimeline_.reset();
+    transferTimeline_.reset();
+    graphicsTimeline_.reset();
     vkDestroyCommandPool(device_, commandPool, nullptr);
+    if(transferCommandPool != VK_NULL_HANDLE) { vkDestroyCommandPool(device_, transferCommandPool, nullptr); }
+    if(computeCommandPool != VK_NULL_HANDLE) { vkDestroyCommandPool(device_, computeCommandPool, nullptr); }
     vkDestroyDevice(device_, nullptr);
 
     if(enableValidationLayers) { DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr); }
 
-    vkDestroySurfaceKHR(instance, surface_, nullptr);
+    if(surface_ != VK_NULL_HANDLE) { vkDestroySurfaceKHR(instance, surface_, nullptr); }
     vkDestroyInstance(instance, nullptr);
   }
 
@@ -132,32 +160,73 @@ namespace GameEngine
   {
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
-    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    // Queues to create per family. Transfer and compute each ask for a queue of their own and share the family's
+    // last one once it has run out, when they fell back to the graphics family they share its queue
+    std::map<uint32_t, uint32_t> queueCounts = {{indices.graphicsFamily, 1}, {indices.presentFamily, 1}};
+    auto requestQueue = [&](uint32_t family) -> uint32_t
+    {
+      if(family == indices.graphicsFamily) { return 0; }
+      uint32_t& count = queueCounts[family];
+      if(count < queueFamilies[family].queueCount) { count++; }
+      return count - 1;
+    };
+    uint32_t transferQueueIndex = requestQueue(indices.transferFamily);
+    uint32_t computeQueueIndex = requestQueue(indices.computeFamily);
+
+    uint32_t maxQueueCount = 0;
+    for(auto [queueFamily, queueCount] : queueCounts) { maxQueueCount = std::max(maxQueueCount, queueCount); }
+    std::vector<float> queuePriorities(maxQueueCount, 1.0f);
 
-    float queuePriority = 1.0f;
-    for(uint32_t queueFamily : uniqueQueueFamilies)
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    for(auto [queueFamily, queueCount] : queueCounts)
       {
         VkDeviceQueueCreateInfo queueCreateInfo = {};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount = queueCount;
+        queueCreateInfo.pQueuePriorities = queuePriorities.data();
         queueCreateInfos.push_back(queueCreateInfo);
       }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // Lets indirect draws start at any instance, GPU culling is turned off on the rare devices without it
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+    indirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+    // Lets one indirect call issue every level of a mesh, otherwise they are issued one call each
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &timelineFeatures;
 
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
+    // Optional extensions are enabled when present but never required of a device
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    pipelineCreationFeedback =
+      isDeviceExtensionAvailable(physicalDevice, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    if(pipelineCreationFeedback) { enabledExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME); }
+    bool drawIndirectCount = isDeviceExtensionAvailable(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if(drawIndirectCount) { enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME); }
+
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
     // might not really be necessary anymore because device specific validation layers
     // have been deprecated
@@ -173,26 +242,157 @@ namespace GameEngine
         throw std::runtime_error("failed to create logical device!");
       }
 
+    // Vulkan 1.0 instance, so the count draws are only reachable as extension functions
+    if(drawIndirectCount)
+      {
+        drawIndexedIndirectCount_ = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(
+          vkGetDeviceProcAddr(device_, "vkCmdDrawIndexedIndirectCountKHR"));
+        drawIndirectCount_ =
+          reinterpret_cast<PFN_vkCmdDrawIndirectCount>(vkGetDeviceProcAddr(device_, "vkCmdDrawIndirectCountKHR"));
+      }
+
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+    vkGetDeviceQueue(device_, indices.transferFamily, transferQueueIndex, &transferQueue_);
+    vkGetDeviceQueue(device_, indices.computeFamily, computeQueueIndex, &computeQueue_);
+    queueFamilyIndices_ = indices;
+
+    auto describe = [&](VkQueue queue) { return queue == graphicsQueue_ ? "shares graphics" : "dedicated"; };
+    std::cout << "queue families: graphics " << indices.graphicsFamily << ", transfer " << indices.transferFamily
+              << " (" << describe(transferQueue_) << "), compute " << indices.computeFamily << " ("
+              << describe(computeQueue_) << ")" << std::endl;
   }
 
   void Graphics::VulkanDevice::createCommandPool()
   {
-    QueueFamilyIndices queueFamilyIndices = findPhysicalQueueFamilies();
-
     VkCommandPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
+    poolInfo.queueFamilyIndex = queueFamilyIndices_.graphicsFamily;
     poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
     if(vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
       {
         throw std::runtime_error("failed to create command pool!");
       }
+
+    // Command buffers can only be submitted to queues of the family their pool was created for
+    if(queueFamilyIndices_.transferFamily != queueFamilyIndices_.graphicsFamily)
+      {
+        poolInfo.queueFamilyIndex = queueFamilyIndices_.transferFamily;
+        if(vkCreateCommandPool(device_, &poolInfo, nullptr, &transferCommandPool) != VK_SUCCESS)
+          {
+            throw std::runtime_error("failed to create transfer command pool!");
+          }
+      }
+    if(queueFamilyIndices_.computeFamily != queueFamilyIndices_.graphicsFamily &&
+       queueFamilyIndices_.computeFamily != queueFamilyIndices_.transferFamily)
+      {
+        poolInfo.queueFamilyIndex = queueFamilyIndices_.computeFamily;
+        if(vkCreateCommandPool(device_, &poolInfo, nullptr, &computeCommandPool) != VK_SUCCESS)
+          {
+            throw std::runtime_error("failed to create compute command pool!");
+          }
+      }
+  }
+
+  void Graphics::VulkanDevice::createQueueTimelines()
+  {
+    // One timeline per queue, types that share a queue have to share its timeline too
+    graphicsTimeline_ = std::make_unique<Timeline>(device_, graphicsQueue_);
+    if(transferQueue_ != graphicsQueue_) { transferTimeline_ = std::make_unique<Timeline>(device_, transferQueue_); }
+    if(computeQueue_ != graphicsQueue_ && computeQueue_ != transferQueue_)
+      {
+        computeTimeline_ = std::make_unique<Timeline>(device_, computeQueue_);
+      }
+  }
+
+  VkCommandPool Graphics::VulkanDevice::commandPoolFor(QueueType type)
+  {
+    uint32_t family = queueFamily(type);
+    if(family == queueFamilyIndices_.graphicsFamily) { return commandPool; }
+    if(family == queueFamilyIndices_.transferFamily) { return transferCommandPool; }
+    return computeCommandPool;
+  }
+
+  VkQueue Graphics::VulkanDevice::queue(QueueType type)
+  {
+    switch(type)
+      {
+      case QueueType::Transfer: return transferQueue_;
+      case QueueType::Compute: return computeQueue_;
+      default: return graphicsQueue_;
+      }
   }
 
-  void Graphics::VulkanDevice::createSurface() { window.createWindowSurface(instance, &surface_); }
+  uint32_t Graphics::VulkanDevice::queueFamily(QueueType type) const
+  {
+    switch(type)
+      {
+      case QueueType::Transfer: return queueFamilyIndices_.transferFamily;
+      case QueueType::Compute: return queueFamilyIndices_.computeFamily;
+      default: return queueFamilyIndices_.graphicsFamily;
+      }
+  }
+
+  Graphics::Timeline& Graphics::VulkanDevice::timeline(QueueType type)
+  {
+    VkQueue target = queue(type);
+    if(transferTimeline_ != nullptr && transferTimeline_->queue() == target) { return *transferTimeline_; }
+    if(computeTimeline_ != nullptr && computeTimeline_->queue() == target) { return *computeTimeline_; }
+    return *graphicsTimeline_;
+  }
+
+  bool Graphics::VulkanDevice::hasDedicatedQueue(QueueType type) { return queue(type) != graphicsQueue_; }
+
+  VkResult Graphics::VulkanDevice::submit(QueueType type, const VkSubmitInfo& submitInfo, uint64_t* signaledValue,
+                                          const uint64_t* waitValues)
+  {
+    return timeline(type).submit(submitInfo, signaledValue, waitValues);
+  }
+
+  void Graphics::VulkanDevice::releaseBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, QueueType src,
+                                                      QueueType dst, VkPipelineStageFlags srcStage,
+                                                      VkAccessFlags srcAccess)
+  {
+    if(!needsOwnershipTransfer(src, dst)) { return; }
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = 0; // Ignored for a release, visibility is the acquire's job
+    barrier.srcQueueFamilyIndex = queueFamily(src);
+    barrier.dstQueueFamilyIndex = queueFamily(dst);
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0,
+                         nullptr);
+  }
+
+  void Graphics::VulkanDevice::acquireBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, QueueType src,
+                                                      QueueType dst, VkPipelineStageFlags dstStage,
+                                                      VkAccessFlags dstAccess)
+  {
+    if(!needsOwnershipTransfer(src, dst)) { return; }
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0; // Ignored for an acquire, the release made the writes available
+    barrier.dstAccessMask = dstAccess;
+    barrier.srcQueueFamilyIndex = queueFamily(src);
+    barrier.dstQueueFamilyIndex = queueFamily(dst);
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    // Starting at dstStage chains the barrier to a semaphore wait on the same stages
+    vkCmdPipelineBarrier(commandBuffer, dstStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+  }
+
+  void Graphics::VulkanDevice::createSurface()
+  {
+    if(isHeadless()) { return; }
+    window->createWindowSurface(instance, &surface_);
+  }
 
   bool Graphics::VulkanDevice::isDeviceSuitable(VkPhysicalDevice device)
   {
@@ -200,8 +400,9 @@ namespace GameEngine
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if(extensionsSupported)
+    // Nothing gets presented without a window so any device with a graphics queue will do
+    bool swapChainAdequate = isHeadless();
+    if(extensionsSupported && !isHeadless())
       {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -266,13 +467,19 @@ namespace GameEngine
 
   std::vector<const char*> Graphics::VulkanDevice::getRequiredExtensions()
   {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char*> extensions;
 
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    if(!isHeadless())
+      {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+      }
 
     if(enableValidationLayers) { extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); }
+    // Required by VK_KHR_timeline_semaphore on a 1.0 instance
+    extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
     return extensions;
   }
@@ -316,6 +523,21 @@ namespace GameEngine
     return requiredExtensions.empty();
   }
 
+  bool Graphics::VulkanDevice::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName)
+  {
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+    for(const auto& extension : availableExtensions)
+      {
+        if(std::strcmp(extension.extensionName, extensionName) == 0) { return true; }
+      }
+    return false;
+  }
+
   Graphics::QueueFamilyIndices Graphics::VulkanDevice::findQueueFamilies(VkPhysicalDevice device)
   {
     QueueFamilyIndices indices;
@@ -335,7 +557,12 @@ namespace GameEngine
             indices.graphicsFamilyHasValue = true;
           }
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        if(isHeadless())
+          {
+            // Nothing to present to, report the graphics family so QueueFamilyIndices stays complete
+            presentSupport = indices.graphicsFamilyHasValue && indices.graphicsFamily == static_cast<uint32_t>(i);
+          }
+        else { vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport); }
         if(queueFamily.queueCount > 0 && presentSupport)
           {
             indices.presentFamily = i;
@@ -346,6 +573,29 @@ namespace GameEngine
         i++;
       }
 
+    // Families without graphics run next to it: transfer only ones are usually the copy engines, compute ones
+    // without graphics the async compute queues. Compute queues can copy too, so they stand in for a missing
+    // transfer only family
+    indices.transferFamily = indices.graphicsFamily;
+    indices.computeFamily = indices.graphicsFamily;
+    bool transferOnly = false;
+    for(uint32_t family = 0; indices.graphicsFamilyHasValue && family < queueFamilyCount; family++)
+      {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if(queueFamilies[family].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) { continue; }
+
+        if(flags & VK_QUEUE_COMPUTE_BIT)
+          {
+            if(indices.computeFamily == indices.graphicsFamily) { indices.computeFamily = family; }
+            if(indices.transferFamily == indices.graphicsFamily) { indices.transferFamily = family; }
+          }
+        else if((flags & VK_QUEUE_TRANSFER_BIT) && !transferOnly)
+          {
+            indices.transferFamily = family;
+            transferOnly = true;
+          }
+      }
+
     return indices;
   }
 
@@ -406,10 +656,9 @@ namespace GameEngine
     throw std::runtime_error("failed to find suitable memory type!");
   }
 
-  // TODO: Re-write when a "memory allocator" is being made
   void
   Graphics::VulkanDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                                       VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+                                       VkBuffer& buffer, Allocation& allocation)
   {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -426,26 +675,25 @@ namespace GameEngine
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
-    // Allocate memory of the proper size
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+    // Sub-allocate a range of a shared block instead of a vkAllocateMemory per buffer
+    allocation = memoryAllocator_->allocate(memRequirements, properties, true);
 
-    if(vkAllocateMemory(device_, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-      {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-      }
     // If above is successfull then bind the buffer to memory we just allocated
-    vkBindBufferMemory(device_, buffer, bufferMemory, 0);
+    vkBindBufferMemory(device_, buffer, allocation.memory, allocation.offset);
   }
 
-  VkCommandBuffer Graphics::VulkanDevice::beginSingleTimeCommands()
+  void Graphics::VulkanDevice::destroyBuffer(VkBuffer buffer, Allocation& allocation)
+  {
+    vkDestroyBuffer(device_, buffer, nullptr);
+    memoryAllocator_->free(allocation);
+  }
+
+  VkCommandBuffer Graphics::VulkanDevice::beginSingleTimeCommands(QueueType type)
   {
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
+    allocInfo.commandPool = commandPoolFor(type);
     allocInfo.commandBufferCount = 1;
 
     VkCommandBuffer commandBuffer;
@@ -459,7 +707,7 @@ namespace GameEngine
     return commandBuffer;
   }
 
-  void Graphics::VulkanDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer)
+  void Graphics::VulkanDevice::endSingleTimeCommands(VkCommandBuffer commandBuffer, QueueType type)
   {
     vkEndCommandBuffer(commandBuffer);
 
@@ -468,10 +716,16 @@ namespace GameEngine
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue_);
+    // Waits for this submission only, not for frames that may still be in flight on the same queue
+    uint64_t value = 0;
+    Timeline& queueTimeline = timeline(type);
+    if(queueTimeline.submit(submitInfo, &value) != VK_SUCCESS)
+      {
+        throw std::runtime_error("failed to submit single time command buffer!");
+      }
+    queueTimeline.wait(value);
 
-    vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
+    vkFreeCommandBuffers(device_, commandPoolFor(type), 1, &commandBuffer);
   }
 
   void Graphics::VulkanDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
@@ -510,7 +764,7 @@ namespace GameEngine
   }
 
   void Graphics::VulkanDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
-                                                   VkImage& image, VkDeviceMemory& imageMemory)
+                                                   VkImage& image, Allocation& allocation)
   {
     if(vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS)
       {
@@ -520,20 +774,20 @@ namespace GameEngine
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device_, image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+    // Optimal tiling images live in their own blocks so they never share a granularity page with buffers
+    allocation =
+      memoryAllocator_->allocate(memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_LINEAR);
 
-    if(vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-      {
-        throw std::runtime_error("failed to allocate image memory!");
-      }
-
-    if(vkBindImageMemory(device_, image, imageMemory, 0) != VK_SUCCESS)
+    if(vkBindImageMemory(device_, image, allocation.memory, allocation.offset) != VK_SUCCESS)
       {
         throw std::runtime_error("failed to bind image memory!");
       }
   }
 
+  void Graphics::VulkanDevice::destroyImage(VkImage image, Allocation& allocation)
+  {
+    vkDestroyImage(device_, image, nullptr);
+    memoryAllocator_->free(allocation);
+  }
+
 } // namespace GameEngine
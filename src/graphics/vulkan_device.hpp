@@ -1,15 +1,22 @@
 #pragma once
 
 #include "../platform/Window.hpp"
+#include "memory_allocator.hpp"
+#include "pipeline_cache.hpp"
+#include "shader_registry.hpp"
 
 // std lib headers
 // #include <string>
+#include <memory>
 #include <vector>
 
 namespace GameEngine
 {
   namespace Graphics
   {
+    class DeletionQueue;
+    class StagingRing;
+    class Timeline;
 
     struct SwapChainSupportDetails
     {
@@ -22,11 +29,24 @@ namespace GameEngine
     {
       uint32_t graphicsFamily;
       uint32_t presentFamily;
+      uint32_t transferFamily; // Transfer only family if there is one, graphicsFamily when there is none
+      uint32_t computeFamily;  // Compute family without graphics if there is one, graphicsFamily when there is none
       bool graphicsFamilyHasValue = false;
       bool presentFamilyHasValue = false;
       bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
     };
 
+    /**
+     * @brief The queues work can be submitted to. Transfer and Compute fall back to a queue of their own in a shared
+     * family, and then to the graphics queue, so every type can always be used.
+     */
+    enum class QueueType
+    {
+      Graphics,
+      Transfer,
+      Compute,
+    };
+
     class VulkanDevice
     {
     public:
@@ -36,7 +56,11 @@ namespace GameEngine
       const bool enableValidationLayers = true;
 #endif
 
-      VulkanDevice(Platform::VulkanWindow& window);
+      /**
+       * @brief Creates the instance, picks a GPU and creates the logical device.
+       * @param window Window to present to, or nullptr for a headless device without a surface.
+       */
+      VulkanDevice(Platform::VulkanWindow* window);
       ~VulkanDevice();
 
       // Not copyable or movable
@@ -47,9 +71,98 @@ namespace GameEngine
 
       VkCommandPool getCommandPool() { return commandPool; }
       VkDevice device() { return device_; }
+      VkPhysicalDevice getPhysicalDevice() { return physicalDevice; }
       VkSurfaceKHR surface() { return surface_; }
       VkQueue graphicsQueue() { return graphicsQueue_; }
       VkQueue presentQueue() { return presentQueue_; }
+      bool isHeadless() const { return window == nullptr; }
+
+      /**
+       * @brief Counts submissions to the graphics queue, everything submitted there goes through it.
+       */
+      Timeline& graphicsTimeline() { return *graphicsTimeline_; }
+
+      /**
+       * @brief Timeline of the queue behind type. Types sharing a queue share its timeline.
+       */
+      Timeline& timeline(QueueType type);
+      VkQueue queue(QueueType type);
+      uint32_t queueFamily(QueueType type) const;
+
+      /**
+       * @brief Checks if type runs on a queue of its own, so its work can overlap with graphics.
+       */
+      bool hasDedicatedQueue(QueueType type);
+
+      /**
+       * @brief Checks if resources used on both queue types need their ownership transferred between them.
+       */
+      bool needsOwnershipTransfer(QueueType src, QueueType dst) const { return queueFamily(src) != queueFamily(dst); }
+
+      /**
+       * @brief Submits to the queue behind type through its timeline, see Timeline::submit.
+       */
+      VkResult submit(QueueType type, const VkSubmitInfo& submitInfo, uint64_t* signaledValue,
+                      const uint64_t* waitValues = nullptr);
+
+      /**
+       * @brief Records the release half of a queue family ownership transfer of buffer from src to dst.
+       *
+       * Record it on a src command buffer after the last access there, then acquireBufferOwnership on dst in a submit
+       * that waits for this one. Records nothing when both types share a family, a regular barrier does the job then.
+       * @param srcStage Stages of the last access on src.
+       * @param srcAccess Writes on src that have to be made available.
+       */
+      void releaseBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, QueueType src, QueueType dst,
+                                  VkPipelineStageFlags srcStage, VkAccessFlags srcAccess);
+
+      /**
+       * @brief Records the acquire half of the transfer started by releaseBufferOwnership.
+       * @param dstStage Stages of the first access on dst, the submit's semaphore wait should use the same ones.
+       * @param dstAccess Accesses on dst the writes are made visible to.
+       */
+      void acquireBufferOwnership(VkCommandBuffer commandBuffer, VkBuffer buffer, QueueType src, QueueType dst,
+                                  VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+      /**
+       * @brief drawIndirectFirstInstance is enabled, without it indirect draws cannot pick their range of instances.
+       */
+      bool supportsIndirectFirstInstance() const { return indirectFirstInstance; }
+
+      /**
+       * @brief multiDrawIndirect is enabled, without it indirect calls take at most one command.
+       */
+      bool supportsMultiDrawIndirect() const { return multiDrawIndirect; }
+
+      /**
+       * @brief vkCmdDrawIndexedIndirectCountKHR, nullptr when VK_KHR_draw_indirect_count is not available.
+       */
+      PFN_vkCmdDrawIndexedIndirectCount cmdDrawIndexedIndirectCount() const { return drawIndexedIndirectCount_; }
+
+      /**
+       * @brief vkCmdDrawIndirectCountKHR, nullptr when VK_KHR_draw_indirect_count is not available.
+       */
+      PFN_vkCmdDrawIndirectCount cmdDrawIndirectCount() const { return drawIndirectCount_; }
+
+      /**
+       * @brief Shared staging ring for uploads into DEVICE_LOCAL buffers, flushed by the Renderer every frame.
+       */
+      StagingRing& stagingRing() { return *stagingRing_; }
+
+      /**
+       * @brief Destroys resources once the frames that use them are done, collected by the Renderer every frame.
+       */
+      DeletionQueue& deletionQueue() { return *deletionQueue_; }
+
+      /**
+       * @brief Pipeline cache shared by every pipeline, loaded from and saved to PipelineCache::DEFAULT_PATH.
+       */
+      PipelineCache& pipelineCache() { return *pipelineCache_; }
+
+      /**
+       * @brief Shader modules shared across pipelines, deduplicated by their SPIR-V.
+       */
+      ShaderRegistry& shaderRegistry() { return *shaderRegistry_; }
 
       SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
       uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -57,29 +170,41 @@ namespace GameEngine
       VkFormat
       findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
+      /**
+       * @brief Pooled allocator backing createBuffer and createImageWithInfo, exposes per heap statistics.
+       */
+      MemoryAllocator& memoryAllocator() { return *memoryAllocator_; }
+
       /**
        * @brief Creates a Vulkan buffer with specified size, usage, and memory properties.
        * @param size Size of the buffer in bytes.
        * @param usage Vulkan buffer usage flags (e.g., VK_BUFFER_USAGE_VERTEX_BUFFER_BIT).
        * @param properties Vulkan memory property flags (e.g., VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT).
        * @param buffer Reference to the created Vulkan buffer handle.
-       * @param bufferMemory Reference to the allocated Vulkan device memory for the buffer.
+       * @param allocation Receives the sub-allocated memory range, host visible memory comes back mapped.
        */
 
       void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                        VkDeviceMemory& bufferMemory);
+                        Allocation& allocation);
+
+      /**
+       * @brief Destroys a buffer created with createBuffer and returns its memory to the allocator.
+       */
+      void destroyBuffer(VkBuffer buffer, Allocation& allocation);
 
       /**
        * @brief Begins a single-time-use Vulkan command buffer for one-off operations.
+       * @param type Queue the command buffer will be submitted to.
        * @return The allocated VkCommandBuffer handle.
        */
-      VkCommandBuffer beginSingleTimeCommands();
+      VkCommandBuffer beginSingleTimeCommands(QueueType type = QueueType::Graphics);
 
       /**
-       * @brief Ends and submits a single-time-use Vulkan command buffer.
+       * @brief Ends and submits a single-time-use Vulkan command buffer, then waits for it to complete.
        * @param commandBuffer The VkCommandBuffer to end and submit.
+       * @param type Queue passed to beginSingleTimeCommands.
        */
-      void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+      void endSingleTimeCommands(VkCommandBuffer commandBuffer, QueueType type = QueueType::Graphics);
 
       /**
        * @brief Copies data from a source Vulkan buffer to a destination buffer.
@@ -104,10 +229,15 @@ namespace GameEngine
        * @param imageInfo Vulkan image creation info structure.
        * @param properties Vulkan memory property flags (e.g., VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT).
        * @param image Reference to the created VkImage handle.
-       * @param imageMemory Reference to the allocated Vulkan device memory for the image.
+       * @param allocation Receives the memory range, large images get a dedicated allocation.
        */
       void createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image,
-                               VkDeviceMemory& imageMemory);
+                               Allocation& allocation);
+
+      /**
+       * @brief Destroys an image created with createImageWithInfo and returns its memory to the allocator.
+       */
+      void destroyImage(VkImage image, Allocation& allocation);
 
       /**
        * @brief Stores properties of the physical Vulkan device.
@@ -121,6 +251,8 @@ namespace GameEngine
       void pickPhysicalDevice();
       void createLogicalDevice();
       void createCommandPool();
+      void createQueueTimelines();
+      VkCommandPool commandPoolFor(QueueType type);
 
       // helper functions
       bool isDeviceSuitable(VkPhysicalDevice device);
@@ -130,21 +262,42 @@ namespace GameEngine
       void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
       void hasGflwRequiredInstanceExtensions();
       bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+      bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
       SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
       VkInstance instance;
       VkDebugUtilsMessengerEXT debugMessenger;
       VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-      GameEngine::Platform::VulkanWindow& window;
+      GameEngine::Platform::VulkanWindow* window;
       VkCommandPool commandPool;
+      VkCommandPool transferCommandPool = VK_NULL_HANDLE; // Null while transfers use the graphics family
+      VkCommandPool computeCommandPool = VK_NULL_HANDLE;  // Null while compute uses the graphics family
 
       VkDevice device_;
-      VkSurfaceKHR surface_;
+      VkSurfaceKHR surface_ = VK_NULL_HANDLE;
       VkQueue graphicsQueue_;
       VkQueue presentQueue_;
+      VkQueue transferQueue_;
+      VkQueue computeQueue_;
+      QueueFamilyIndices queueFamilyIndices_;
+
+      std::unique_ptr<Timeline> graphicsTimeline_;
+      std::unique_ptr<Timeline> transferTimeline_; // Null when transfers go to the graphics queue
+      std::unique_ptr<Timeline> computeTimeline_;  // Null when compute goes to the graphics or transfer queue
+      std::unique_ptr<MemoryAllocator> memoryAllocator_;
+      std::unique_ptr<DeletionQueue> deletionQueue_;
+      std::unique_ptr<StagingRing> stagingRing_;
+      std::unique_ptr<PipelineCache> pipelineCache_;
+      std::unique_ptr<ShaderRegistry> shaderRegistry_;
+      bool pipelineCreationFeedback = false; // VK_EXT_pipeline_creation_feedback is enabled
+      bool indirectFirstInstance = false;    // drawIndirectFirstInstance is enabled
+      bool multiDrawIndirect = false;        // multiDrawIndirect is enabled
+      PFN_vkCmdDrawIndexedIndirectCount drawIndexedIndirectCount_ = nullptr; // Null without VK_KHR_draw_indirect_count
+      PFN_vkCmdDrawIndirectCount drawIndirectCount_ = nullptr;
 
       const std::vector<const char*> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-      const std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+      // Headless devices never present so the swap chain extension is dropped for them
+      std::vector<const char*> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
     };
   } // namespace Graphics
 } // namespace GameEngine
@@ -1,17 +1,133 @@
 
 #include <iostream>
 #include "./core/application.hpp"
+#include "./core/ecs_benchmark.hpp"
 
 // std
 #include <cstdlib>
 #include <stdexcept>
+#include <string>
 
-int main()
+static void printUsage(const char* program)
 {
-  GameEngine::Core::Application app{};
+  std::cerr << "usage: " << program << " [--headless] [--frames N] [--capture file.ppm] [--golden file.ppm]"
+            << " [--trace file.json] [--model file] [--gpu-culling]\n"
+            << "       [--vertex-format format] [--present-mode mode] [--swap-images N] [--frames-in-flight N]"
+            << " [--fps-cap N]\n"
+            << "  --headless          render offscreen without a window\n"
+            << "  --frames N          number of frames to render when headless (default 600)\n"
+            << "  --capture file.ppm  write the last headless frame to a PPM file\n"
+            << "  --golden file.ppm   fail if the last headless frame differs from a PPM file\n"
+            << "  --trace file.json   write a Chrome trace on exit (F12 also dumps one while running)\n"
+            << "  --model file        load an .obj, .gltf or .glb model instead of the built in cube\n"
+            << "  --gpu-culling       cull in a compute shader and draw indirectly, one draw per mesh\n"
+            << "  --vertex-format format  float32 (default), or snorm16 or half for 12 byte quantized vertices\n"
+            << "  --present-mode mode fifo, relaxed, mailbox (default) or immediate, falls back to fifo\n"
+            << "  --swap-images N     swap chain images to request (default surface minimum + 1)\n"
+            << "  --frames-in-flight N  frames the CPU may record ahead of the GPU, 1 to 3 (default 2)\n"
+            << "  --fps-cap N         limit the frame rate to N frames per second (default off)\n"
+            << "       " << program << " --bench-ecs [N] | --bench-transforms [N] | --bench-jobs [N]\n"
+            << "  --bench-ecs [N]         time transform iteration over N entities (default 1000000) and exit\n"
+            << "  --bench-transforms [N]  time SIMD model matrix rebuilds for N transforms (default 1000000)\n"
+            << "  --bench-jobs [N]        time transforms and culling of N entities on 1 to all cores\n";
+}
+
+static GameEngine::Core::ApplicationConfig parseArguments(int argc, char** argv)
+{
+  GameEngine::Core::ApplicationConfig config{};
+
+  for(int i = 1; i < argc; i++)
+    {
+      std::string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+
+      if(arg == "--headless") { config.headless = true; }
+      else if(arg == "--frames" && hasValue) { config.frameCount = static_cast<uint32_t>(std::stoul(argv[++i])); }
+      else if(arg == "--capture" && hasValue) { config.capturePath = argv[++i]; }
+      else if(arg == "--golden" && hasValue) { config.goldenPath = argv[++i]; }
+      else if(arg == "--trace" && hasValue) { config.tracePath = argv[++i]; }
+      else if(arg == "--model" && hasValue) { config.modelPath = argv[++i]; }
+      else if(arg == "--gpu-culling") { config.gpuCulling = true; }
+      else if(arg == "--vertex-format" && hasValue)
+        {
+          config.vertexFormat = GameEngine::Graphics::parseVertexFormat(argv[++i]);
+        }
+      else if(arg == "--present-mode" && hasValue)
+        {
+          config.presentation.presentMode = GameEngine::Graphics::parsePresentMode(argv[++i]);
+        }
+      else if(arg == "--swap-images" && hasValue)
+        {
+          config.presentation.imageCount = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+      else if(arg == "--frames-in-flight" && hasValue)
+        {
+          config.presentation.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+        }
+      else if(arg == "--fps-cap" && hasValue) { config.presentation.frameRateCap = std::stod(argv[++i]); }
+      else { throw std::invalid_argument("unknown or incomplete argument: " + arg); }
+    }
+
+  uint32_t maxFramesInFlight = GameEngine::Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT;
+  if(config.presentation.framesInFlight == 0 || config.presentation.framesInFlight > maxFramesInFlight)
+    {
+      throw std::invalid_argument("--frames-in-flight must be between 1 and " + std::to_string(maxFramesInFlight));
+    }
+
+  if(!config.headless && (!config.capturePath.empty() || !config.goldenPath.empty()))
+    {
+      throw std::invalid_argument("--capture and --golden require --headless");
+    }
+
+  return config;
+}
+
+/**
+ * @brief Runs a CPU benchmark instead of the engine if the first argument asks for one.
+ * @return true if a benchmark was run.
+ */
+static bool runBenchmark(int argc, char** argv)
+{
+  if(argc < 2) { return false; }
+
+  std::string mode = argv[1];
+  uint32_t count = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 0;
+
+  if(mode == "--bench-ecs") { GameEngine::Core::runEcsBenchmark(count > 0 ? count : 1000000); }
+  else if(mode == "--bench-transforms") { GameEngine::Core::runTransformBenchmark(count > 0 ? count : 1000000); }
+  else if(mode == "--bench-jobs") { GameEngine::Core::runJobBenchmark(count > 0 ? count : 1000000); }
+  else { return false; }
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  try
+    {
+      if(runBenchmark(argc, argv)) { return EXIT_SUCCESS; }
+    }
+  catch(const std::exception& e)
+    {
+      std::cerr << e.what() << '\n';
+      printUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  GameEngine::Core::ApplicationConfig config;
+  try
+    {
+      config = parseArguments(argc, argv);
+    }
+  catch(const std::exception& e)
+    {
+      std::cerr << e.what() << '\n';
+      printUsage(argv[0]);
+      return EXIT_FAILURE;
+    }
 
   try
     {
+      GameEngine::Core::Application app{config};
       app.run();
     }
   catch(const std::exception& e)
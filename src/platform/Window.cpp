@@ -36,6 +36,8 @@ namespace GameEngine
         }
     }
 
+    GLFWwindow* VulkanWindow::getNativeHandle() const { return window; }
+
     void VulkanWindow::framebufferResizeCallback(GLFWwindow* window, int width, int height)
     {
       auto lveWindow = reinterpret_cast<VulkanWindow*>(glfwGetWindowUserPointer(window));
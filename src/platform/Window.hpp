@@ -51,6 +51,7 @@ namespace GameEngine
        */
       bool shouldClose() { return glfwWindowShouldClose(window); };
       VkExtent2D getExtent() { return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)}; }
+      bool isMinimized() const { return width == 0 || height == 0; }
 
       /**
        * @brief Checks if the window should resized.
@@ -0,0 +1,52 @@
+#include "mapped_file.hpp"
+
+// std
+#include <stdexcept>
+
+// POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace GameEngine
+{
+  namespace Platform
+  {
+    MappedFile::MappedFile(const std::string& filepath) : filepath{filepath}
+    {
+      int fd = open(filepath.c_str(), O_RDONLY);
+      if(fd < 0) { throw std::runtime_error("failed to open file: " + filepath); }
+
+      struct stat fileStat;
+      if(fstat(fd, &fileStat) != 0)
+        {
+          close(fd);
+          throw std::runtime_error("failed to stat file: " + filepath);
+        }
+      length = static_cast<size_t>(fileStat.st_size);
+
+      // mmap of an empty file fails, an empty mapping is still a valid (empty) file
+      if(length > 0)
+        {
+          void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+          if(mapping == MAP_FAILED)
+            {
+              close(fd);
+              throw std::runtime_error("failed to map file: " + filepath);
+            }
+          // The whole file is about to be parsed, let the kernel start reading it in right away
+          madvise(mapping, length, MADV_WILLNEED);
+          bytes = static_cast<const uint8_t*>(mapping);
+        }
+
+      // The mapping keeps its own reference to the file
+      close(fd);
+    }
+
+    MappedFile::~MappedFile()
+    {
+      if(bytes != nullptr) { munmap(const_cast<uint8_t*>(bytes), length); }
+    }
+  } // namespace Platform
+} // namespace GameEngine
@@ -0,0 +1,41 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace GameEngine
+{
+  namespace Platform
+  {
+    /**
+     * @brief Read only memory mapping of a whole file.
+     *
+     * Pages are faulted in by the OS on first touch, so parsers can read straight from the mapping without copying
+     * the file into a heap buffer first. The mapping lives until the MappedFile is destroyed.
+     */
+    class MappedFile
+    {
+    public:
+      /**
+       * @brief Maps the file at filepath.
+       * @throws std::runtime_error if the file cannot be opened or mapped.
+       */
+      explicit MappedFile(const std::string& filepath);
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      const uint8_t* data() const { return bytes; }
+      size_t size() const { return length; }
+      const std::string& path() const { return filepath; }
+
+    private:
+      std::string filepath;
+      const uint8_t* bytes = nullptr;
+      size_t length = 0;
+    };
+  } // namespace Platform
+} // namespace GameEngine
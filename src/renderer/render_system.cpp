@@ -1,4 +1,6 @@
 #include "render_system.hpp"
+#include "../graphics/deletion_queue.hpp"
+#include "../core/profiler.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -7,42 +9,122 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
 #include <stdexcept>
 
 namespace GameEngine
 {
   namespace Core
   {
-    // This needs to align with Vulkan specification which requires 16 byte padding
-    struct SimplePushConstantData
+    RenderSystem::RenderSystem(Graphics::VulkanDevice& device, Graphics::PipelineLibrary& pipelineLibrary,
+                               VkRenderPass renderPass, Graphics::RenderPassFormats renderPassFormats,
+                               bool gpuCulling, Graphics::VertexFormat vertexFormat)
+        : vulkanDevice{device}, pipelines{pipelineLibrary}, gpuCulling{gpuCulling}, vertexFormat{vertexFormat},
+          frameRing{device}
     {
-      glm::mat4 transform{1.0f}; // default initialization to identity matrix
-      float padding2[2];         // Offset the color to compensate for vec2
-      glm::vec3 color;           // TODO: May not need this as we have per vertex coloring
-    };
+      if(this->gpuCulling && !vulkanDevice.supportsIndirectFirstInstance())
+        {
+          std::cerr << "render system: drawIndirectFirstInstance is not supported, culling on the CPU" << std::endl;
+          this->gpuCulling = false;
+        }
 
-    RenderSystem::RenderSystem(Graphics::VulkanDevice& device, VkRenderPass renderPass) : vulkanDevice{device}
-    {
+      createDescriptors();
       createPipelineLayout();
-      createPipeline(renderPass);
+      createPipelines(renderPass, renderPassFormats);
+      if(this->gpuCulling) { createCullPipeline(); }
+    }
+
+    RenderSystem::~RenderSystem()
+    {
+      // Waits for variants still compiling against the layout, and forgets them so its handle can be reused
+      pipelines.releaseLayout(pipelineLayout);
+      vulkanDevice.deletionQueue().releasePipelineLayout(pipelineLayout);
+      if(cullPipelineLayout != VK_NULL_HANDLE)
+        {
+          vulkanDevice.deletionQueue().releasePipelineLayout(cullPipelineLayout);
+        }
+      if(objectBuffer != VK_NULL_HANDLE) { vulkanDevice.deletionQueue().releaseBuffer(objectBuffer, objectAllocation); }
     }
 
-    RenderSystem::~RenderSystem() { vkDestroyPipelineLayout(vulkanDevice.device(), pipelineLayout, nullptr); }
+    std::vector<VkVertexInputBindingDescription> RenderSystem::InstanceData::getBindingDescriptions()
+    {
+      std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+      bindingDescriptions[0].binding = INSTANCE_BINDING;
+      bindingDescriptions[0].stride = sizeof(InstanceData);
+      bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+      return bindingDescriptions;
+    }
+
+    std::vector<VkVertexInputAttributeDescription> RenderSystem::InstanceData::getAttributeDescriptions()
+    {
+      std::vector<VkVertexInputAttributeDescription> attributeDescriptions(5);
+
+      // A mat4 input takes one location per column
+      for(uint32_t column = 0; column < 4; column++)
+        {
+          attributeDescriptions[column].binding = INSTANCE_BINDING;
+          attributeDescriptions[column].location = 2 + column;
+          attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+          attributeDescriptions[column].offset = offsetof(InstanceData, transform) + sizeof(glm::vec4) * column;
+        }
+
+      attributeDescriptions[4].binding = INSTANCE_BINDING;
+      attributeDescriptions[4].location = 6;
+      attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+      attributeDescriptions[4].offset = offsetof(InstanceData, color);
+
+      return attributeDescriptions;
+    }
+
+    // Descriptors
+    void RenderSystem::createDescriptors()
+    {
+      globalSetLayout = Graphics::DescriptorSetLayout::Builder(vulkanDevice)
+                          .addBinding(GLOBAL_UBO_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                      VK_SHADER_STAGE_VERTEX_BIT)
+                          .build();
+
+      // Room for the cull sets too, the GPU path allocates them from the same pool
+      descriptorPool = Graphics::DescriptorPool::Builder(vulkanDevice)
+                         .setMaxSets(2 * Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+                                      Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                      CULL_BINDING_COUNT * Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT)
+                         .build();
+
+      for(int i = 0; i < Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT; i++)
+        {
+          globalSets[i] = descriptorPool->allocateDescriptorSet(globalSetLayout->getDescriptorSetLayout());
+          writeGlobalSet(i);
+        }
+    }
+
+    void RenderSystem::writeGlobalSet(int frameIndex)
+    {
+      // The range is one GlobalUbo, where in the buffer it lives is chosen per frame by the dynamic offset
+      VkDescriptorBufferInfo bufferInfo{frameRing.getBuffer(frameIndex), 0, sizeof(GlobalUbo)};
+      Graphics::DescriptorWriter(*globalSetLayout)
+        .writeBuffer(GLOBAL_UBO_BINDING, bufferInfo)
+        .overwrite(globalSets[frameIndex]);
+    }
 
     // Pipeline Layout
     void RenderSystem::createPipelineLayout()
     {
-      VkPushConstantRange pushConstantRange{};
-      pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-      pushConstantRange.offset = 0;
-      pushConstantRange.size = sizeof(SimplePushConstantData);
-
+      VkDescriptorSetLayout setLayouts[] = {globalSetLayout->getDescriptorSetLayout()};
+      // Per object data comes in through the instance buffer, push constants only carry the mesh's dequantization
+      VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Graphics::Mesh::Dequantization)};
       VkPipelineLayoutCreateInfo pipelineLayoutInfo{}; // struct
 
       // Struct member variables
       pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-      pipelineLayoutInfo.setLayoutCount = 0;
-      pipelineLayoutInfo.pSetLayouts = nullptr;
+      pipelineLayoutInfo.setLayoutCount = 1;
+      pipelineLayoutInfo.pSetLayouts = setLayouts;
       pipelineLayoutInfo.pushConstantRangeCount = 1;
       pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -52,41 +134,678 @@ namespace GameEngine
         };
     }
 
-    // Pipeline
-    void RenderSystem::createPipeline(VkRenderPass renderPass)
+    // Pipelines
+    void RenderSystem::createPipelines(VkRenderPass renderPass, Graphics::RenderPassFormats renderPassFormats)
     {
       assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-      Graphics::PipelineConfigInfo pipelineConfig{};
-      Graphics::GraphicsPipeline::defaultPipelineConfigInfo(pipelineConfig);
-      pipelineConfig.renderPass = renderPass;
-      pipelineConfig.pipelineLayout = pipelineLayout;
-      pipeline = std::make_unique<Graphics::GraphicsPipeline>(vulkanDevice, "Shaders/simple_shader.vert.spv",
-                                                              "Shaders/simple_shader.frag.spv", pipelineConfig);
+      auto makeDesc = [&](bool useInstanceColor)
+      {
+        Graphics::PipelineDesc desc{"Shaders/simple_shader.vert.spv", "Shaders/simple_shader.frag.spv",
+                                    std::make_unique<Graphics::PipelineConfigInfo>()};
+        Graphics::PipelineConfigInfo& pipelineConfig = *desc.config;
+        Graphics::GraphicsPipeline::defaultPipelineConfigInfo(pipelineConfig);
+        pipelineConfig.renderPass = renderPass;
+        pipelineConfig.renderPassFormats = renderPassFormats;
+        pipelineConfig.pipelineLayout = pipelineLayout;
+        pipelineConfig.vertSpecialization.set<VkBool32>(USE_INSTANCE_COLOR_CONSTANT, useInstanceColor);
+        pipelineConfig.bindingDescriptions = Graphics::Mesh::Vertex::getBindingDescriptions(vertexFormat);
+        pipelineConfig.attributeDescriptions = Graphics::Mesh::Vertex::getAttributeDescriptions(vertexFormat);
+
+        auto instanceBindings = InstanceData::getBindingDescriptions();
+        auto instanceAttributes = InstanceData::getAttributeDescriptions();
+        pipelineConfig.bindingDescriptions.insert(pipelineConfig.bindingDescriptions.end(), instanceBindings.begin(),
+                                                  instanceBindings.end());
+        pipelineConfig.attributeDescriptions.insert(pipelineConfig.attributeDescriptions.end(),
+                                                    instanceAttributes.begin(), instanceAttributes.end());
+        return desc;
+      };
+
+      // Both variants share layout and vertex input, so they bind interchangeably. The fallback's shader modules
+      // stay in the registry, so the variant's request loads them without creating new ones
+      fallbackPipeline = pipelines.compileNow(makeDesc(false));
+      pipeline = pipelines.request(makeDesc(true));
+
+      // Drops modules only the previous render pass's pipelines used, the variant's desc still holds its own
+      vulkanDevice.shaderRegistry().releaseUnused();
     };
 
-    void RenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, std::vector<Core::GameObject>& gameObjects)
+    void RenderSystem::createCullPipeline()
     {
-      pipeline->bind(commandBuffer);
+      static_assert(sizeof(CullObject) == 112, "CullObject must match cull.comp's std430 layout");
+      static_assert(sizeof(CullMesh) == 16, "CullMesh must match cull.comp's std430 layout");
+      static_assert(sizeof(CullLod) == 32, "CullLod must match cull.comp's std430 layout");
+      static_assert(sizeof(CullConstants) == 128, "CullConstants must fit the guaranteed push constant size");
 
-      // Loop over game objects
-      for(auto& obj : gameObjects)
+      Graphics::DescriptorSetLayout::Builder builder{vulkanDevice};
+      for(uint32_t binding = 0; binding < CULL_BINDING_COUNT; binding++)
+        {
+          builder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+        }
+      cullSetLayout = builder.build();
+      for(auto& set : cullSets)
         {
-          obj.transform.rotation.y = glm::mod(obj.transform.rotation.y + 0.0001f, glm::two_pi<float>());
-          obj.transform.rotation.z = glm::mod(obj.transform.rotation.z + 0.0001f, glm::two_pi<float>());
+          set = descriptorPool->allocateDescriptorSet(cullSetLayout->getDescriptorSetLayout());
+        }
 
-          SimplePushConstantData push{};
-          // Order must match the uniform push constant in the shader.vert
-          push.color = obj.color;
-          push.transform = obj.transform.mat4();
+      VkDescriptorSetLayout setLayouts[] = {cullSetLayout->getDescriptorSetLayout()};
+      VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants)};
 
-          vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                             0, sizeof(SimplePushConstantData), &push);
+      VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+      pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+      pipelineLayoutInfo.setLayoutCount = 1;
+      pipelineLayoutInfo.pSetLayouts = setLayouts;
+      pipelineLayoutInfo.pushConstantRangeCount = 1;
+      pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-          obj.model->bind(commandBuffer);
-          obj.model->draw(commandBuffer);
+      if(vkCreatePipelineLayout(vulkanDevice.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) !=
+         VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to create cull pipeline layout!");
         }
-    };
+
+      cullPipeline =
+        std::make_unique<Graphics::ComputePipeline>(vulkanDevice, "Shaders/cull.comp.spv", cullPipelineLayout);
+      vulkanDevice.shaderRegistry().releaseUnused();
+    }
+
+    void RenderSystem::cullEntities(Renderer::Renderer& renderer, Registry& registry, TransformSystem& transforms,
+                                    const glm::mat4& viewProjection)
+    {
+      PROFILE_SCOPE("RenderSystem::cullEntities");
+
+      // Clip space w is the view depth. A length of one at depth w spans |row 1| * height / 2 / w pixels
+      glm::vec4 depthRow{viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]};
+      glm::vec3 heightRow{viewProjection[0][1], viewProjection[1][1], viewProjection[2][1]};
+      float pixelsAtUnitDepth = glm::length(heightRow) * 0.5f * static_cast<float>(renderer.getExtent().height);
+
+      drawBatches.clear();
+      if(gpuCulling)
+        {
+          syncObjects(registry, transforms);
+          lastCandidateCount = static_cast<uint32_t>(objectSlots.size());
+          cullOnGpu(renderer, transforms, viewProjection, depthRow, pixelsAtUnitDepth);
+          return;
+        }
+
+      instanceScratch.clear();
+      meshScratch.clear();
+      lodScratch.clear();
+      sphereScratch.clear();
+      auto& colors = registry.pool<ColorComponent>();
+      registry.view<MeshComponent>().each(
+        [&](Entity entity, MeshComponent& mesh)
+        {
+          if(!mesh.mesh || !transforms.contains(entity)) { return; }
+
+          const ColorComponent* color = colors.tryGet(entity);
+          const Graphics::Mesh::Bounds& bounds = mesh.mesh->getBounds();
+          const glm::mat4& matrix = transforms.getMatrix(entity);
+
+          if(mesh.mesh->getLodCount() > 1)
+            {
+              // Measured at the sphere's nearest point, so entities the camera is close to or inside stay detailed
+              float scale = std::sqrt(std::max({glm::dot(glm::vec3{matrix[0]}, glm::vec3{matrix[0]}),
+                                                glm::dot(glm::vec3{matrix[1]}, glm::vec3{matrix[1]}),
+                                                glm::dot(glm::vec3{matrix[2]}, glm::vec3{matrix[2]})}));
+              float depth = glm::dot(depthRow, matrix * glm::vec4{bounds.center, 1.0f}) - bounds.radius * scale;
+              float pixelsPerUnit = pixelsAtUnitDepth * scale / std::max(depth, 1e-3f);
+              mesh.lod = selectLod(*mesh.mesh, mesh.lod, pixelsPerUnit);
+            }
+          else { mesh.lod = 0; }
+
+          meshScratch.push_back(mesh.mesh.get());
+          lodScratch.push_back(mesh.lod);
+          sphereScratch.emplace_back(bounds.center, bounds.radius);
+          instanceScratch.push_back({matrix, glm::vec4{color ? color->color : glm::vec3{1.0f}, 1.0f}});
+        });
+      lastCandidateCount = static_cast<uint32_t>(instanceScratch.size());
+
+      cullOnCpu(renderer.getFrameIndex(), viewProjection);
+    }
+
+    uint32_t RenderSystem::vertexBytes(const Graphics::Mesh& mesh, uint32_t lod)
+    {
+      uint32_t vertices = mesh.getIndexCount() > 0 ? mesh.getLod(lod).vertexCount : mesh.getVertexCount();
+      return vertices * Graphics::vertexFormatStride(mesh.getVertexFormat());
+    }
+
+    uint32_t RenderSystem::selectLod(const Graphics::Mesh& mesh, uint32_t currentLod, float pixelsPerUnit)
+    {
+      uint32_t lod = std::min(currentLod, mesh.getLodCount() - 1);
+      while(lod > 0 && mesh.getLod(lod).error * pixelsPerUnit > LOD_ERROR_PIXELS) { lod--; }
+      while(lod + 1 < mesh.getLodCount() &&
+            mesh.getLod(lod + 1).error * pixelsPerUnit <= LOD_ERROR_PIXELS * (1.0f - LOD_HYSTERESIS))
+        {
+          lod++;
+        }
+      return lod;
+    }
+
+    void RenderSystem::cullOnCpu(int frameIndex, const glm::mat4& viewProjection)
+    {
+      // The culler reads the matrices straight out of the instance data instead of a separate copy
+      static_assert(sizeof(InstanceData) % sizeof(float) == 0 && offsetof(InstanceData, transform) == 0);
+      CullInput cullInput{};
+      cullInput.matrices = reinterpret_cast<const float*>(instanceScratch.data());
+      cullInput.matrixStride = sizeof(InstanceData) / sizeof(float);
+      cullInput.spheres = sphereScratch.data();
+      cullInput.count = instanceScratch.size();
+      {
+        PROFILE_SCOPE("RenderSystem::cull");
+        culler.cull(Frustum::fromViewProjection(viewProjection), cullInput, visibleScratch);
+      }
+      lastVisibleCount = static_cast<uint32_t>(visibleScratch.size());
+
+      // Group the survivors by mesh and level. Sorting small (key, index) pairs is cheaper than sorting the
+      // instances, and keeps each draw's instances contiguous in the instance buffer
+      drawOrder.clear();
+      for(uint32_t index : visibleScratch)
+        {
+          drawOrder.emplace_back(DrawKey{meshScratch[index], lodScratch[index]}, index);
+        }
+      std::sort(drawOrder.begin(), drawOrder.end());
+
+      lastDrawCount = 0;
+      lastTriangleCount = 0;
+      lastFullTriangleCount = 0;
+      lastVertexBytes = 0;
+      if(drawOrder.empty()) { return; }
+
+      // Everything this frame writes is known now, so the ring is sized once and never overflows mid frame
+      VkDeviceSize alignment = frameRing.getDescriptorAlignment();
+      VkDeviceSize frameBytes =
+        Graphics::FrameRing::alignUp(sizeof(GlobalUbo), alignment) + drawOrder.size() * sizeof(InstanceData);
+      if(frameRing.begin(frameIndex, frameBytes)) { writeGlobalSet(frameIndex); }
+
+      Graphics::FrameRing::Slice globalSlice = frameRing.allocate(sizeof(GlobalUbo), alignment);
+      static_cast<GlobalUbo*>(globalSlice.data)->viewProjection = viewProjection;
+      globalOffset = static_cast<uint32_t>(globalSlice.offset);
+
+      instanceSlice = frameRing.allocate(drawOrder.size() * sizeof(InstanceData), alignof(InstanceData));
+      auto* instances = static_cast<InstanceData*>(instanceSlice.data);
+      for(size_t i = 0; i < drawOrder.size(); i++) { instances[i] = instanceScratch[drawOrder[i].second]; }
+
+      size_t first = 0;
+      while(first < drawOrder.size())
+        {
+          DrawKey key = drawOrder[first].first;
+          size_t last = first;
+          while(last < drawOrder.size() && drawOrder[last].first == key) { last++; }
+
+          uint32_t instanceCount = static_cast<uint32_t>(last - first);
+          drawBatches.push_back({key.mesh, key.lod, static_cast<uint32_t>(first), instanceCount});
+          lastTriangleCount += instanceCount * key.mesh->getTriangleCount(key.lod);
+          lastFullTriangleCount += instanceCount * key.mesh->getTriangleCount();
+          lastVertexBytes += uint64_t{instanceCount} * vertexBytes(*key.mesh, key.lod);
+          first = last;
+        }
+      lastDrawCount = static_cast<uint32_t>(drawBatches.size());
+    }
+
+    void RenderSystem::syncObjects(Registry& registry, TransformSystem& transforms)
+    {
+      PROFILE_SCOPE("RenderSystem::syncObjects");
+      auto& meshes = registry.pool<MeshComponent>();
+      auto& colors = registry.pool<ColorComponent>();
+      auto colorOf = [](const ColorComponent* color)
+      { return glm::vec4{color ? color->color : glm::vec3{1.0f}, 1.0f}; };
+      auto slotOf = [this](Entity entity)
+      {
+        uint32_t index = entity & (Registry::MAX_ENTITIES - 1);
+        uint32_t slot = index < slotOfEntity.size() ? slotOfEntity[index] : NO_SLOT;
+        return slot != NO_SLOT && objectSlots[slot].entity == entity ? slot : NO_SLOT;
+      };
+
+      // Components came, went or were replaced, or more transforms changed than were listed. Walking the mesh pool
+      // finds out which, frames without such changes only look at the listed transforms
+      if(transforms.allChanged() || meshes.getVersion() != meshPoolVersion || colors.getVersion() != colorPoolVersion)
+        {
+          syncStamp++;
+          registry.view<MeshComponent>().each(
+            [&](Entity entity, MeshComponent& mesh)
+            {
+              if(!mesh.mesh || !transforms.contains(entity)) { return; }
+
+              glm::vec4 color = colorOf(colors.tryGet(entity));
+              uint32_t slot = slotOf(entity);
+              if(slot == NO_SLOT) { slot = addObject(entity, mesh.mesh, color); }
+              else
+                {
+                  ObjectSlot& object = objectSlots[slot];
+                  if(meshSlots[object.mesh].mesh != mesh.mesh)
+                    {
+                      meshSlots[object.mesh].objectCount--;
+                      object.mesh = findOrAddMesh(mesh.mesh);
+                      markObjectDirty(slot);
+                    }
+                  if(object.color != color)
+                    {
+                      object.color = color;
+                      markObjectDirty(slot);
+                    }
+                }
+              objectSlots[slot].seen = syncStamp;
+            });
+
+          // Backwards, so the slot moved into a hole has already been looked at
+          for(uint32_t slot = static_cast<uint32_t>(objectSlots.size()); slot-- > 0;)
+            {
+              if(objectSlots[slot].seen != syncStamp) { removeObject(slot); }
+            }
+          compactMeshes();
+
+          if(transforms.allChanged()) { uploadAllObjects = true; }
+          meshPoolVersion = meshes.getVersion();
+          colorPoolVersion = colors.getVersion();
+        }
+      else
+        {
+          for(Entity entity : transforms.changedEntities())
+            {
+              uint32_t slot = slotOf(entity);
+              if(slot != NO_SLOT)
+                {
+                  if(transforms.contains(entity)) { markObjectDirty(slot); }
+                  else { removeObject(slot); }
+                  continue;
+                }
+
+              // A transform given to an entity that already had its mesh
+              MeshComponent* mesh = meshes.tryGet(entity);
+              if(mesh && mesh->mesh && transforms.contains(entity))
+                {
+                  addObject(entity, mesh->mesh, colorOf(colors.tryGet(entity)));
+                }
+            }
+        }
+      transforms.clearChanges();
+    }
+
+    uint32_t RenderSystem::addObject(Entity entity, const std::shared_ptr<Graphics::Mesh>& mesh, const glm::vec4& color)
+    {
+      uint32_t index = entity & (Registry::MAX_ENTITIES - 1);
+      if(index >= slotOfEntity.size())
+        {
+          slotOfEntity.resize(std::max<size_t>(index + 1, slotOfEntity.size() * 2), NO_SLOT);
+        }
+
+      uint32_t slot = static_cast<uint32_t>(objectSlots.size());
+      objectSlots.push_back({entity, findOrAddMesh(mesh), color, syncStamp});
+      slotOfEntity[index] = slot;
+      markObjectDirty(slot);
+      return slot;
+    }
+
+    void RenderSystem::removeObject(uint32_t slot)
+    {
+      meshSlots[objectSlots[slot].mesh].objectCount--;
+      uint32_t& removed = slotOfEntity[objectSlots[slot].entity & (Registry::MAX_ENTITIES - 1)];
+      if(removed == slot) { removed = NO_SLOT; }
+
+      // The last slot fills the hole and is copied to its new place, keeping the slots packed for the dispatch
+      uint32_t last = static_cast<uint32_t>(objectSlots.size() - 1);
+      if(slot != last)
+        {
+          objectSlots[slot] = objectSlots[last];
+          objectSlots[slot].dirty = false;
+          uint32_t& moved = slotOfEntity[objectSlots[slot].entity & (Registry::MAX_ENTITIES - 1)];
+          if(moved == last) { moved = slot; }
+          markObjectDirty(slot);
+        }
+      objectSlots.pop_back();
+    }
+
+    void RenderSystem::markObjectDirty(uint32_t slot)
+    {
+      if(objectSlots[slot].dirty) { return; }
+      objectSlots[slot].dirty = true;
+      dirtySlots.push_back(slot);
+    }
+
+    uint32_t RenderSystem::findOrAddMesh(const std::shared_ptr<Graphics::Mesh>& mesh)
+    {
+      auto [it, inserted] = meshSlotOf.try_emplace(mesh.get(), static_cast<uint32_t>(meshSlots.size()));
+      if(inserted) { meshSlots.push_back({mesh, 0}); }
+      meshSlots[it->second].objectCount++;
+      return it->second;
+    }
+
+    void RenderSystem::compactMeshes()
+    {
+      if(std::none_of(meshSlots.begin(), meshSlots.end(), [](const MeshSlot& mesh) { return mesh.objectCount == 0; }))
+        {
+          return;
+        }
+
+      std::vector<uint32_t> remap(meshSlots.size(), NO_SLOT);
+      uint32_t kept = 0;
+      for(uint32_t i = 0; i < meshSlots.size(); i++)
+        {
+          if(meshSlots[i].objectCount == 0) { continue; }
+          remap[i] = kept;
+          if(kept != i) { meshSlots[kept] = std::move(meshSlots[i]); }
+          kept++;
+        }
+      meshSlots.resize(kept);
+
+      meshSlotOf.clear();
+      for(uint32_t i = 0; i < kept; i++) { meshSlotOf[meshSlots[i].mesh.get()] = i; }
+      for(uint32_t slot = 0; slot < objectSlots.size(); slot++)
+        {
+          uint32_t mesh = remap[objectSlots[slot].mesh];
+          if(mesh == objectSlots[slot].mesh) { continue; }
+          objectSlots[slot].mesh = mesh;
+          markObjectDirty(slot);
+        }
+    }
+
+    uint32_t RenderSystem::collectObjectUploads()
+    {
+      // A new buffer starts out empty, so every slot is copied into it. Grown ahead so spawning a few entities at a
+      // time does not recreate it every frame
+      constexpr uint32_t MIN_OBJECT_CAPACITY = 1024;
+      uint32_t objectCount = static_cast<uint32_t>(objectSlots.size());
+      if(objectCount > objectCapacity)
+        {
+          if(objectBuffer != VK_NULL_HANDLE)
+            {
+              vulkanDevice.deletionQueue().releaseBuffer(objectBuffer, objectAllocation);
+            }
+          objectCapacity = std::max({objectCount, objectCapacity * 2, MIN_OBJECT_CAPACITY});
+          vulkanDevice.createBuffer(objectCapacity * sizeof(CullObject),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, objectBuffer, objectAllocation);
+          uploadAllObjects = true;
+        }
+
+      // Only slots still flagged count, which drops repeats and slots removed since they were listed
+      uint32_t kept = 0;
+      for(uint32_t slot : dirtySlots)
+        {
+          if(slot >= objectCount || !objectSlots[slot].dirty) { continue; }
+          objectSlots[slot].dirty = false;
+          dirtySlots[kept++] = slot;
+        }
+      dirtySlots.resize(kept);
+      return uploadAllObjects ? objectCount : kept;
+    }
+
+    void RenderSystem::uploadObjects(VkCommandBuffer commandBuffer, const TransformSystem& transforms,
+                                     const Graphics::FrameRing::Slice& uploadSlice)
+    {
+      auto* uploads = static_cast<CullObject*>(uploadSlice.data);
+      auto writeObject = [&](CullObject& object, uint32_t slot)
+      {
+        const ObjectSlot& source = objectSlots[slot];
+        const Graphics::Mesh::Bounds& bounds = meshSlots[source.mesh].mesh->getBounds();
+        object = {transforms.getMatrix(source.entity), source.color, glm::vec4{bounds.center, bounds.radius},
+                  source.mesh};
+      };
+
+      // A full upload also resets every level. Single slots stop short of lod, which belongs to cull.comp
+      objectCopies.clear();
+      if(uploadAllObjects)
+        {
+          for(uint32_t slot = 0; slot < objectSlots.size(); slot++) { writeObject(uploads[slot], slot); }
+          objectCopies.push_back({uploadSlice.offset, 0, objectSlots.size() * sizeof(CullObject)});
+        }
+      else
+        {
+          for(uint32_t i = 0; i < dirtySlots.size(); i++)
+            {
+              writeObject(uploads[i], dirtySlots[i]);
+              objectCopies.push_back({uploadSlice.offset + i * sizeof(CullObject), dirtySlots[i] * sizeof(CullObject),
+                                      offsetof(CullObject, lod)});
+            }
+        }
+      dirtySlots.clear();
+      uploadAllObjects = false;
+      if(objectCopies.empty()) { return; }
+
+      // Passes of earlier frames may still be reading the slots or writing their levels
+      VkMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                           &barrier, 0, nullptr, 0, nullptr);
+      vkCmdCopyBuffer(commandBuffer, uploadSlice.buffer, objectBuffer, static_cast<uint32_t>(objectCopies.size()),
+                      objectCopies.data());
+    }
+
+    void RenderSystem::cullOnGpu(Renderer::Renderer& renderer, const TransformSystem& transforms,
+                                 const glm::mat4& viewProjection, const glm::vec4& depthRow, float pixelsAtUnitDepth)
+    {
+      PROFILE_SCOPE("RenderSystem::cullOnGpu");
+      int frameIndex = renderer.getFrameIndex();
+
+      // Before begin, which may replace the buffer the counts are in
+      readBackCullStats(frameIndex);
+      CullReadback& readback = cullReadbacks[frameIndex];
+      readback.costs.clear();
+      lastDrawCount = 0;
+      if(objectSlots.empty())
+        {
+          dirtySlots.clear();
+          uploadAllObjects = false;
+          lastVisibleCount = 0;
+          lastTriangleCount = 0;
+          lastFullTriangleCount = 0;
+          lastVertexBytes = 0;
+          return;
+        }
+
+      uint32_t uploadCount = collectObjectUploads();
+      size_t objectCount = objectSlots.size();
+      size_t meshCount = meshSlots.size();
+      size_t lodCount = 0;
+      for(const MeshSlot& mesh : meshSlots)
+        {
+          if(mesh.objectCount > 0) { lodCount += mesh.mesh->getLodCount(); }
+        }
+
+      VkDeviceSize alignment = frameRing.getDescriptorAlignment();
+      auto aligned = [alignment](VkDeviceSize size) { return Graphics::FrameRing::alignUp(size, alignment); };
+      VkDeviceSize frameBytes = aligned(sizeof(GlobalUbo)) + aligned(uploadCount * sizeof(CullObject)) +
+                                aligned(meshCount * sizeof(CullMesh)) + aligned(lodCount * sizeof(CullLod)) +
+                                aligned(objectCount * sizeof(uint32_t)) +
+                                aligned(lodCount * sizeof(VkDrawIndexedIndirectCommand)) +
+                                aligned(meshCount * sizeof(uint32_t)) + objectCount * sizeof(InstanceData);
+      if(frameRing.begin(frameIndex, frameBytes)) { writeGlobalSet(frameIndex); }
+
+      Graphics::FrameRing::Slice globalSlice = frameRing.allocate(sizeof(GlobalUbo), alignment);
+      static_cast<GlobalUbo*>(globalSlice.data)->viewProjection = viewProjection;
+      globalOffset = static_cast<uint32_t>(globalSlice.offset);
+
+      VkCommandBuffer commandBuffer = renderer.getCurrentCommandBuffer();
+      uploadObjects(commandBuffer, transforms, frameRing.allocate(uploadCount * sizeof(CullObject), alignment));
+
+      // Rewritten every frame, it is a handful of records per mesh. The levels' instance counts start at 0 and each
+      // mesh's range holds all of its objects, whichever levels they end up at
+      Graphics::FrameRing::Slice meshSlice = frameRing.allocate(meshCount * sizeof(CullMesh), alignment);
+      Graphics::FrameRing::Slice lodSlice = frameRing.allocate(lodCount * sizeof(CullLod), alignment);
+      auto* cullMeshes = static_cast<CullMesh*>(meshSlice.data);
+      auto* cullLods = static_cast<CullLod*>(lodSlice.data);
+      uint32_t firstLod = 0;
+      uint32_t firstInstance = 0;
+      for(uint32_t i = 0; i < meshCount; i++)
+        {
+          // Meshes nobody draws any more get no levels until the next walk drops them
+          const MeshSlot& mesh = meshSlots[i];
+          uint32_t meshLods = mesh.objectCount > 0 ? mesh.mesh->getLodCount() : 0;
+          cullMeshes[i] = {firstLod, meshLods, firstInstance};
+          for(uint32_t lod = 0; lod < meshLods; lod++)
+            {
+              CullLod& cullLod = cullLods[firstLod + lod];
+              mesh.mesh->writeIndirectCommand(cullLod.command, firstInstance, lod);
+              cullLod.error = mesh.mesh->getLod(lod).error;
+              readback.costs.push_back({mesh.mesh->getTriangleCount(), mesh.mesh->getTriangleCount(lod),
+                                        vertexBytes(*mesh.mesh, lod)});
+            }
+          if(meshLods > 0)
+            {
+              drawBatches.push_back({mesh.mesh.get(), 0, firstInstance, mesh.objectCount, firstLod, i});
+            }
+          firstLod += meshLods;
+          firstInstance += mesh.objectCount;
+        }
+      readback.lodsOffset = lodSlice.offset;
+
+      // Only the GPU writes these
+      Graphics::FrameRing::Slice visibilitySlice = frameRing.allocate(objectCount * sizeof(uint32_t), alignment);
+      drawSlice = frameRing.allocate(lodCount * sizeof(VkDrawIndexedIndirectCommand), alignment);
+      countSlice = frameRing.allocate(meshCount * sizeof(uint32_t), alignment);
+      instanceSlice = frameRing.allocate(objectCount * sizeof(InstanceData), alignment);
+
+      // The slices move with the object and mesh counts, so the set is pointed at them every frame
+      VkDescriptorBufferInfo objectInfo{objectBuffer, 0, objectCount * sizeof(CullObject)};
+      VkDescriptorBufferInfo meshInfo{meshSlice.buffer, meshSlice.offset, meshCount * sizeof(CullMesh)};
+      VkDescriptorBufferInfo lodInfo{lodSlice.buffer, lodSlice.offset, lodCount * sizeof(CullLod)};
+      VkDescriptorBufferInfo visibilityInfo{visibilitySlice.buffer, visibilitySlice.offset,
+                                            objectCount * sizeof(uint32_t)};
+      VkDescriptorBufferInfo drawInfo{drawSlice.buffer, drawSlice.offset,
+                                      lodCount * sizeof(VkDrawIndexedIndirectCommand)};
+      VkDescriptorBufferInfo countInfo{countSlice.buffer, countSlice.offset, meshCount * sizeof(uint32_t)};
+      VkDescriptorBufferInfo instanceInfo{instanceSlice.buffer, instanceSlice.offset,
+                                          objectCount * sizeof(InstanceData)};
+      Graphics::DescriptorWriter(*cullSetLayout)
+        .writeBuffer(CULL_OBJECTS_BINDING, objectInfo)
+        .writeBuffer(CULL_MESHES_BINDING, meshInfo)
+        .writeBuffer(CULL_LODS_BINDING, lodInfo)
+        .writeBuffer(CULL_VISIBILITY_BINDING, visibilityInfo)
+        .writeBuffer(CULL_DRAWS_BINDING, drawInfo)
+        .writeBuffer(CULL_COUNTS_BINDING, countInfo)
+        .writeBuffer(CULL_INSTANCES_BINDING, instanceInfo)
+        .overwrite(cullSets[frameIndex]);
+
+      CullConstants constants{};
+      constants.planes = Frustum::fromViewProjection(viewProjection).planes;
+      constants.depthRow = depthRow;
+      constants.objectCount = static_cast<uint32_t>(objectCount);
+      constants.meshCount = static_cast<uint32_t>(meshCount);
+      constants.pixelsAtUnitDepth = pixelsAtUnitDepth;
+
+      // The first pass reads the copied slots and the levels earlier frames wrote, the second what the first wrote
+      VkMemoryBarrier barrier{};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+      auto dispatch = [&](uint32_t pass, size_t invocations)
+      {
+        constants.pass = pass;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants),
+                           &constants);
+        vkCmdDispatch(commandBuffer, static_cast<uint32_t>((invocations + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1,
+                      1);
+      };
+
+      cullPipeline->bind(commandBuffer);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1,
+                              &cullSets[frameIndex], 0, nullptr);
+      dispatch(CULL_PASS_CULL, objectCount);
+      dispatch(CULL_PASS_WRITE, std::max(objectCount, meshCount));
+
+      // The draws read the commands, counts and instances, and the host reads the level counts back once the frame
+      // is done
+      barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      barrier.dstAccessMask =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+      vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                           VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                           0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+      lastDrawCount = static_cast<uint32_t>(drawBatches.size());
+    }
+
+    void RenderSystem::readBackCullStats(int frameIndex)
+    {
+      const CullReadback& readback = cullReadbacks[frameIndex];
+      if(readback.costs.empty()) { return; }
+
+      // The slot's frame has completed, so its levels hold the final instance counts. They lag the frame being
+      // recorded by the frames in flight, close enough for statistics
+      const auto* lods = reinterpret_cast<const CullLod*>(
+        static_cast<const uint8_t*>(frameRing.getMappedData(frameIndex)) + readback.lodsOffset);
+      lastVisibleCount = 0;
+      lastTriangleCount = 0;
+      lastFullTriangleCount = 0;
+      lastVertexBytes = 0;
+      for(size_t i = 0; i < readback.costs.size(); i++)
+        {
+          uint32_t instanceCount = lods[i].command.instanceCount;
+          lastVisibleCount += instanceCount;
+          lastFullTriangleCount += instanceCount * readback.costs[i].fullTriangles;
+          lastTriangleCount += instanceCount * readback.costs[i].triangles;
+          lastVertexBytes += uint64_t{instanceCount} * readback.costs[i].vertexBytes;
+        }
+    }
+
+    void RenderSystem::renderEntities(Renderer::Renderer& renderer)
+    {
+      PROFILE_SCOPE("RenderSystem::renderEntities");
+      if(drawBatches.empty()) { return; }
+
+      Graphics::GraphicsPipeline* activePipeline = pipelines.get(pipeline, fallbackPipeline);
+
+      // Small scenes stay on this thread in one secondary, large ones are recorded in parallel
+      secondaries.clear();
+      {
+        PROFILE_SCOPE("RenderSystem::record");
+        JobSystem::get().parallelFor(drawBatches.size(), MIN_DRAWS_PER_JOB,
+                                     [&](size_t begin, size_t end)
+                                     {
+                                       VkCommandBuffer secondary =
+                                         recordBatches(renderer, *activePipeline, begin, end);
+                                       std::lock_guard<std::mutex> lock{secondariesMutex};
+                                       secondaries.emplace_back(begin, secondary);
+                                     });
+      }
+      std::sort(secondaries.begin(), secondaries.end());
+
+      executeScratch.clear();
+      for(auto& [begin, secondary] : secondaries) { executeScratch.push_back(secondary); }
+      vkCmdExecuteCommands(renderer.getCurrentCommandBuffer(), static_cast<uint32_t>(executeScratch.size()),
+                           executeScratch.data());
+    }
+
+    VkCommandBuffer RenderSystem::recordBatches(Renderer::Renderer& renderer, Graphics::GraphicsPipeline& pipeline,
+                                                size_t begin, size_t end)
+    {
+      VkCommandBuffer commandBuffer = renderer.beginSecondaryCommandBuffer();
+
+      // Secondaries inherit no bound state from the primary or each other, so every one binds everything
+      pipeline.bind(commandBuffer);
+      vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, GLOBAL_SET, 1,
+                              &globalSets[renderer.getFrameIndex()], 1, &globalOffset);
+      vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BINDING, 1, &instanceSlice.buffer, &instanceSlice.offset);
+
+      for(size_t i = begin; i < end; i++)
+        {
+          const DrawBatch& batch = drawBatches[i];
+          assert(batch.mesh->getVertexFormat() == vertexFormat && "Mesh vertex format does not match the pipelines");
+          batch.mesh->bind(commandBuffer);
+          vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                             sizeof(Graphics::Mesh::Dequantization), &batch.mesh->getDequantization());
+          if(gpuCulling)
+            {
+              batch.mesh->drawIndirect(commandBuffer, drawSlice.buffer,
+                                       drawSlice.offset + batch.firstDraw * sizeof(VkDrawIndexedIndirectCommand),
+                                       batch.mesh->getLodCount(), countSlice.buffer,
+                                       countSlice.offset + batch.countIndex * sizeof(uint32_t));
+            }
+          else { batch.mesh->draw(commandBuffer, batch.instanceCount, batch.firstInstance, batch.lod); }
+        }
+
+      if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to record secondary command buffer!");
+        }
+      return commandBuffer;
+    }
 
   } // namespace Core
 } // namespace GameEngine
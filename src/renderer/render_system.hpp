@@ -1,40 +1,413 @@
 #pragma once
 
+#include "renderer.hpp"
+#include "../graphics/compute_pipeline.hpp"
+#include "../graphics/descriptors.hpp"
+#include "../graphics/frame_ring.hpp"
 #include "../graphics/graphics_pipeline.hpp"
+#include "../graphics/pipeline_library.hpp"
+#include "../graphics/render_target.hpp"
 #include "../graphics/vulkan_device.hpp"
-#include "../core/game_object.hpp"
+#include "../core/components.hpp"
+#include "../core/frustum_culler.hpp"
+#include "../core/job_system.hpp"
+#include "../core/registry.hpp"
+#include "../core/transform_system.hpp"
 
 // std
+#include <array>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace GameEngine
 {
   namespace Core
   {
+    /**
+     * @brief Draws entities, batching every entity that shares a Mesh into one instanced draw.
+     *
+     * Each frame the entities are grouped by mesh and their transforms and colors are written into the frame slot's
+     * FrameRing, bound at binding 1 with VK_VERTEX_INPUT_RATE_INSTANCE. Recording cost then scales with the number of
+     * unique meshes instead of the number of objects.
+     *
+     * Data shared by every draw (GlobalUbo) is written once per frame into the same ring and read through set 0,
+     * binding 0, a dynamic uniform buffer. There is one descriptor set per frame slot, pointing at that slot's ring
+     * buffer, and the ring offset is passed as the dynamic offset, so no descriptor is written on the hot path.
+     *
+     * Entities whose mesh bounds fall outside the view frustum are culled before grouping, so they are never copied
+     * into the instance buffer and cost no vertex work.
+     *
+     * The draws are recorded into secondary command buffers that the primary executes. Past MIN_DRAWS_PER_JOB
+     * draws the recording is split across JobSystem threads, each filling its own secondary from its own pool.
+     *
+     * With GPU culling the entities live in a persistent DEVICE_LOCAL buffer of CullObjects, one slot each. A frame
+     * only rewrites the slots of entities whose matrix TransformSystem reports changed, copied in from the ring at the
+     * start of the frame. Adding or removing mesh or color components makes the next frame walk the mesh pool once to
+     * find the entities that came or went, so a frame's CPU work is that plus the per mesh and per level records.
+     * cull.comp tests every object, selects its level and counts each level's survivors in a first pass, then packs
+     * the survivors into their mesh's instance range and the non-empty levels' commands to the front of the mesh's
+     * draws. Each mesh is one vkCmdDrawIndexedIndirectCount over its levels. Visible counts are read back from the
+     * slot's previous frame.
+     *
+     * Meshes with a LOD chain are drawn at the coarsest level whose error projects to at most LOD_ERROR_PIXELS on
+     * screen, chosen per entity on the CPU, or in cull.comp with GPU culling. Entities only move to a coarser level
+     * once its error drops LOD_HYSTERESIS below the limit, so objects hovering at a threshold do not switch every
+     * frame. With CPU culling every (mesh, level) pair is its own draw.
+     *
+     * Meshes are drawn in one VertexFormat, picked at construction, and the pipelines' vertex input is built for it.
+     * Each draw pushes its mesh's Mesh::Dequantization, which the vertex shader applies to the stored positions.
+     *
+     * The pipeline comes from a PipelineLibrary. A plain vertex color variant is compiled up front and draws the
+     * first frames while the full variant compiles in the background. The same happens when the swap chain's
+     * formats change and setRenderPass is called with the new pass.
+     */
     class RenderSystem
     {
     public:
-      RenderSystem(Graphics::VulkanDevice& device, VkRenderPass renderPass);
+      static constexpr uint32_t INSTANCE_BINDING = 1;
+      static constexpr uint32_t GLOBAL_SET = 0;
+      static constexpr uint32_t GLOBAL_UBO_BINDING = 0;
+
+      // Below this many draws recording a range costs less than scheduling it on another thread
+      static constexpr size_t MIN_DRAWS_PER_JOB = 512;
+
+      // constant_id of the vertex shader's USE_INSTANCE_COLOR specialization constant
+      static constexpr uint32_t USE_INSTANCE_COLOR_CONSTANT = 0;
+
+      // Bindings of cull.comp's set 0, its local_size_x and its two passes
+      static constexpr uint32_t CULL_OBJECTS_BINDING = 0;
+      static constexpr uint32_t CULL_MESHES_BINDING = 1;
+      static constexpr uint32_t CULL_LODS_BINDING = 2;
+      static constexpr uint32_t CULL_VISIBILITY_BINDING = 3;
+      static constexpr uint32_t CULL_DRAWS_BINDING = 4;
+      static constexpr uint32_t CULL_COUNTS_BINDING = 5;
+      static constexpr uint32_t CULL_INSTANCES_BINDING = 6;
+      static constexpr uint32_t CULL_BINDING_COUNT = 7;
+      static constexpr uint32_t CULL_GROUP_SIZE = 64;
+      static constexpr uint32_t CULL_PASS_CULL = 0;
+      static constexpr uint32_t CULL_PASS_WRITE = 1;
+
+      // Largest on screen error, in pixels, of the level an entity is drawn at, and the fraction below it the next
+      // coarser level's error has to be before an entity switches to it
+      static constexpr float LOD_ERROR_PIXELS = 1.0f;
+      static constexpr float LOD_HYSTERESIS = 0.25f;
+
+      /**
+       * @brief Per frame data shared by every draw, matches GlobalUbo in the shaders (std140).
+       */
+      struct GlobalUbo
+      {
+        glm::mat4 viewProjection{1.0f};
+      };
+
+      /**
+       * @brief Per instance vertex input, locations 2-5 hold the model matrix columns and 6 the color.
+       */
+      struct InstanceData
+      {
+        glm::mat4 transform{1.0f};
+        glm::vec4 color{1.0f}; // Multiplied with the vertex colors
+
+        static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+        static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+      };
+
+      /**
+       * @brief One entity's slot in the persistent object buffer, as cull.comp reads it (std430).
+       */
+      struct CullObject
+      {
+        glm::mat4 transform{1.0f};
+        glm::vec4 color{1.0f};
+        glm::vec4 sphere{0.0f}; // Local bounding sphere, xyz center and w radius
+        uint32_t mesh = 0;      // Index of the entity's CullMesh
+        uint32_t lod = 0;       // Level drawn last frame, only cull.comp writes it after the slot is first filled
+        uint32_t padding[2]{};
+      };
+
+      /**
+       * @brief One unique mesh as cull.comp reads it (std430), rewritten every frame.
+       */
+      struct CullMesh
+      {
+        uint32_t firstLod = 0;      // Its CullLods and its indirect commands start here
+        uint32_t lodCount = 0;
+        uint32_t firstInstance = 0; // Its range of the instance buffer, one instance per entity drawing it
+        uint32_t padding = 0;
+      };
+
+      /**
+       * @brief One level of a mesh as cull.comp reads it (std430). The first pass counts survivors into the command.
+       */
+      struct CullLod
+      {
+        VkDrawIndexedIndirectCommand command{};
+        float error = 0.0f;
+        uint32_t padding[2]{};
+      };
+
+      /**
+       * @brief Push constants of cull.comp.
+       */
+      struct CullConstants
+      {
+        std::array<glm::vec4, 6> planes{};
+        glm::vec4 depthRow{0.0f}; // Row of viewProjection giving clip space w, the view depth
+        uint32_t objectCount = 0;
+        uint32_t meshCount = 0;
+        uint32_t pass = CULL_PASS_CULL;
+        float pixelsAtUnitDepth = 0.0f; // Pixels a length of one spans at a view depth of one
+      };
+
+      /**
+       * @param renderPassFormats Attachment formats of renderPass, pipelines are shared with compatible passes.
+       * @param gpuCulling Cull and fill indirect draws in a compute pass. Ignored with a warning on devices without
+       * drawIndirectFirstInstance.
+       * @param vertexFormat Format of every mesh this system draws.
+       */
+      RenderSystem(Graphics::VulkanDevice& device, Graphics::PipelineLibrary& pipelineLibrary, VkRenderPass renderPass,
+                   Graphics::RenderPassFormats renderPassFormats, bool gpuCulling = false,
+                   Graphics::VertexFormat vertexFormat = Graphics::VertexFormat::Float32);
       ~RenderSystem();
 
       // Copy constructors (Because the app is now managing vulkan objects we need to delete copy constructors)
       RenderSystem(const RenderSystem&) = delete;
       RenderSystem& operator=(const RenderSystem&) = delete;
 
-      void renderGameObjects(VkCommandBuffer commandBuffer, std::vector<Core::GameObject>& gameObjects);
+      /**
+       * @brief Culls entities against the frustum and writes this frame's instance data and draws.
+       *
+       * With GPU culling this records the object buffer updates and the compute pass into the frame's primary command
+       * buffer, so call it before the main render pass begins.
+       * @param renderer Renderer with a frame in progress. The frame slot's previous use of the ring has completed.
+       * @param registry Entities with a MeshComponent are drawn, ColorComponent is optional. CPU culling updates each
+       * MeshComponent's lod. GPU culling only notices a changed mesh or color when the component is emplaced again.
+       * @param transforms Model matrices, already updated for this frame. Entities without a transform are skipped.
+       * GPU culling consumes its changes.
+       * @param viewProjection Matrix the shaders apply after the model matrix, the frustum is taken from it.
+       */
+      void cullEntities(Renderer::Renderer& renderer, Registry& registry, TransformSystem& transforms,
+                        const glm::mat4& viewProjection);
+
+      /**
+       * @brief Records the draws left by cullEntities, one per unique mesh and level, or one per mesh with GPU culling.
+       * @param renderer The same frame, inside a main render pass begun for secondary command buffers.
+       */
+      void renderEntities(Renderer::Renderer& renderer);
+
+      /**
+       * @brief Rebuilds both pipeline variants for a new, incompatible render pass. Call outside of a frame.
+       */
+      void setRenderPass(VkRenderPass renderPass, Graphics::RenderPassFormats renderPassFormats)
+      {
+        createPipelines(renderPass, renderPassFormats);
+      }
+
+      bool isGpuCulling() const { return gpuCulling; }
+      Graphics::VertexFormat getVertexFormat() const { return vertexFormat; }
+      uint32_t getLastDrawCount() const { return lastDrawCount; }
+      uint32_t getLastVisibleCount() const { return lastVisibleCount; }
+      uint32_t getLastCandidateCount() const { return lastCandidateCount; }
+      uint32_t getLastTriangleCount() const { return lastTriangleCount; } ///< Drawn, after LOD selection.
+      // What the visible entities would have cost at full detail
+      uint32_t getLastFullTriangleCount() const { return lastFullTriangleCount; }
+      // Vertex buffer bytes the last frame's draws referenced, each vertex counted once per instance. A lower bound
+      // on vertex fetch, reached when the post transform cache never misses
+      uint64_t getLastVertexBytes() const { return lastVertexBytes; }
+
+      /**
+       * @brief Level of mesh to draw with an error of pixelsPerUnit pixels per model unit, starting from currentLod.
+       */
+      static uint32_t selectLod(const Graphics::Mesh& mesh, uint32_t currentLod, float pixelsPerUnit);
 
     private:
+      // CPU culling: instances [firstInstance, firstInstance + instanceCount) of the instance buffer all use mesh at
+      // lod. GPU culling: the mesh's indirect commands from firstDraw on, as many as the count at countIndex says
+      struct DrawBatch
+      {
+        Graphics::Mesh* mesh;
+        uint32_t lod;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+        uint32_t firstDraw = 0;
+        uint32_t countIndex = 0;
+      };
+
+      // What entities are grouped by, one draw each
+      struct DrawKey
+      {
+        Graphics::Mesh* mesh;
+        uint32_t lod;
+
+        auto operator<=>(const DrawKey&) const = default;
+      };
+
+      // Per instance cost of one indirect command, multiplied by the instance count read back
+      struct DrawCost
+      {
+        uint32_t fullTriangles; // At full detail
+        uint32_t triangles;     // At the command's level
+        uint32_t vertexBytes;
+      };
+
+      // Where one frame slot's CullLods were written, to read back the instance counts of every level
+      struct CullReadback
+      {
+        VkDeviceSize lodsOffset = 0;
+        std::vector<DrawCost> costs;
+      };
+
+      // An entity's slot in the object buffer, and what its CullObject was built from
+      struct ObjectSlot
+      {
+        Entity entity;
+        uint32_t mesh;      // Index into meshSlots
+        glm::vec4 color;
+        uint32_t seen;      // syncStamp of the last walk that found the entity
+        bool dirty = false; // Listed in dirtySlots
+      };
+
+      // A mesh drawn by at least one slot, or by none since the last walk
+      struct MeshSlot
+      {
+        std::shared_ptr<Graphics::Mesh> mesh;
+        uint32_t objectCount;
+      };
+
+      /**
+       * @brief Bytes of vertex buffer one instance of mesh at lod references.
+       */
+      static uint32_t vertexBytes(const Graphics::Mesh& mesh, uint32_t lod);
+
+      void createDescriptors();
       void createPipelineLayout();
-      void createPipeline(VkRenderPass renderPass);
+      void createPipelines(VkRenderPass renderPass, Graphics::RenderPassFormats renderPassFormats);
+      void createCullPipeline();
+
+      /**
+       * @brief Tests the candidates on this thread, then groups the survivors by mesh into the instance buffer.
+       */
+      void cullOnCpu(int frameIndex, const glm::mat4& viewProjection);
+
+      /**
+       * @brief Brings the object slots up to date with the registry and the transforms' changes.
+       */
+      void syncObjects(Registry& registry, TransformSystem& transforms);
+      uint32_t addObject(Entity entity, const std::shared_ptr<Graphics::Mesh>& mesh, const glm::vec4& color);
+      void removeObject(uint32_t slot);
+      void markObjectDirty(uint32_t slot);
+      uint32_t findOrAddMesh(const std::shared_ptr<Graphics::Mesh>& mesh);
+
+      /**
+       * @brief Drops meshes no slot draws any more and renumbers the rest.
+       */
+      void compactMeshes();
+
+      /**
+       * @brief Grows the object buffer if the slots outgrew it and returns how many objects this frame copies in.
+       */
+      uint32_t collectObjectUploads();
+
+      /**
+       * @brief Writes the objects counted by collectObjectUploads into uploadSlice and records copying them over.
+       */
+      void uploadObjects(VkCommandBuffer commandBuffer, const TransformSystem& transforms,
+                         const Graphics::FrameRing::Slice& uploadSlice);
+
+      /**
+       * @brief Writes the per mesh and per level records and records both cull.comp passes.
+       */
+      void cullOnGpu(Renderer::Renderer& renderer, const TransformSystem& transforms, const glm::mat4& viewProjection,
+                     const glm::vec4& depthRow, float pixelsAtUnitDepth);
+
+      /**
+       * @brief Sums the level instance counts cull.comp wrote the last time frameIndex's slot was used.
+       */
+      void readBackCullStats(int frameIndex);
+
+      /**
+       * @brief Points frameIndex's global set at that slot's ring buffer, after the ring created a new one.
+       */
+      void writeGlobalSet(int frameIndex);
+
+      /**
+       * @brief Records draw batches [begin, end) into a new secondary command buffer, bound for this frame.
+       */
+      VkCommandBuffer recordBatches(Renderer::Renderer& renderer, Graphics::GraphicsPipeline& pipeline, size_t begin,
+                                    size_t end);
 
       Graphics::VulkanDevice& vulkanDevice;
 
-      // Reason for using smart pointer is so we dont have to call new and delete for every pipeline
-      // (https://www.learncpp.com/cpp-tutorial/introduction-to-smart-pointers-move-semantics/)
-      std::unique_ptr<Graphics::GraphicsPipeline> pipeline;
+      Graphics::PipelineLibrary& pipelines;
+      Graphics::PipelineLibrary::Key pipeline = 0;         // Full variant, compiled in the background
+      Graphics::PipelineLibrary::Key fallbackPipeline = 0; // Vertex colors only, compiled up front
 
       VkPipelineLayout pipelineLayout;
+
+      bool gpuCulling;
+      Graphics::VertexFormat vertexFormat;
+      std::unique_ptr<Graphics::ComputePipeline> cullPipeline;
+      VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+      std::unique_ptr<Graphics::DescriptorSetLayout> cullSetLayout;
+      // Rewritten every frame, the slices move around the ring with the object count
+      std::array<VkDescriptorSet, Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT> cullSets{};
+      std::array<CullReadback, Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT> cullReadbacks{};
+
+      // GPU culling's persistent object buffer. objectBuffer's slot i holds objectSlots[i], slotOfEntity maps an
+      // entity index back to its slot
+      static constexpr uint32_t NO_SLOT = 0xFFFFFFFF;
+      VkBuffer objectBuffer = VK_NULL_HANDLE;
+      Graphics::Allocation objectAllocation{};
+      uint32_t objectCapacity = 0;
+      std::vector<ObjectSlot> objectSlots;
+      std::vector<uint32_t> slotOfEntity;
+      std::vector<uint32_t> dirtySlots; // May name a slot twice or past the end, only dirty slots are uploaded
+      bool uploadAllObjects = false;    // Every slot, as one copy that also resets their levels
+      std::vector<MeshSlot> meshSlots;
+      std::unordered_map<Graphics::Mesh*, uint32_t> meshSlotOf;
+      uint64_t meshPoolVersion = ~0ull;
+      uint64_t colorPoolVersion = ~0ull;
+      uint32_t syncStamp = 0;
+      std::vector<VkBufferCopy> objectCopies;
+
+      Graphics::FrameRing frameRing;
+      std::unique_ptr<Graphics::DescriptorSetLayout> globalSetLayout;
+      std::unique_ptr<Graphics::DescriptorPool> descriptorPool;
+      std::array<VkDescriptorSet, Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT> globalSets{};
+
+      FrustumCuller culler;
+
+      // Kept between frames so culling and grouping don't allocate once the scene size is stable. The scratch
+      // arrays are indexed alike, one element per candidate entity
+      std::vector<std::pair<DrawKey, uint32_t>> drawOrder;
+      std::vector<InstanceData> instanceScratch;
+      std::vector<Graphics::Mesh*> meshScratch;
+      std::vector<uint32_t> lodScratch;
+      std::vector<glm::vec4> sphereScratch;
+      std::vector<uint32_t> visibleScratch;
+      std::vector<DrawBatch> drawBatches; // With GPU culling one per indirect command, in command order
+
+      // Frame data written by cullEntities and bound by renderEntities
+      Graphics::FrameRing::Slice instanceSlice{};
+      Graphics::FrameRing::Slice drawSlice{};  // Indirect commands, GPU culling only
+      Graphics::FrameRing::Slice countSlice{}; // Indirect draw counts per mesh, GPU culling only
+      uint32_t globalOffset = 0;
+
+      // Secondary command buffers of the frame being recorded, keyed by their first batch so the primary executes
+      // them in draw order whichever thread finished first
+      std::mutex secondariesMutex;
+      std::vector<std::pair<size_t, VkCommandBuffer>> secondaries;
+      std::vector<VkCommandBuffer> executeScratch;
+      uint32_t lastDrawCount = 0;
+      uint32_t lastVisibleCount = 0;
+      uint32_t lastCandidateCount = 0;
+      uint32_t lastTriangleCount = 0;
+      uint32_t lastFullTriangleCount = 0;
+      uint64_t lastVertexBytes = 0;
     };
 
   } // namespace Core
@@ -1,7 +1,15 @@
 #include "renderer.hpp"
+#include "../core/job_system.hpp"
+#include "../core/profiler.hpp"
+#include "../graphics/deletion_queue.hpp"
+#include "../graphics/staging_ring.hpp"
+#include "../graphics/timeline.hpp"
 
 // std
+#include <algorithm>
+#include <iostream>
 #include <stdexcept>
+#include <string>
 #include <array>
 
 namespace GameEngine
@@ -9,74 +17,133 @@ namespace GameEngine
   namespace Renderer
   {
 
-    Renderer::Renderer(Platform::VulkanWindow& window, Graphics::VulkanDevice& device)
-        : vulkanWindow{window}, vulkanDevice{device}
+    Renderer::Renderer(Platform::VulkanWindow& window, Graphics::VulkanDevice& device,
+                       const Graphics::PresentationPolicy& policy)
+        : vulkanWindow{&window}, vulkanDevice{device}, policy{validatePolicy(policy)}
     {
-      recreateSwapChain();
+      // The first swap chain has nothing to fall back on, so wait until the window has an area
+      while(!recreateSwapChain()) { glfwWaitEvents(); }
       createCommandBuffers();
+      gpuTimer = std::make_unique<Graphics::GpuTimer>(vulkanDevice, policy.framesInFlight);
+    }
+
+    Renderer::Renderer(Graphics::VulkanDevice& device, VkExtent2D extent, bool enableReadback,
+                       const Graphics::PresentationPolicy& policy)
+        : vulkanWindow{nullptr}, vulkanDevice{device}, policy{validatePolicy(policy)}
+    {
+      offscreenTarget = std::make_unique<Graphics::OffscreenTarget>(vulkanDevice, extent, enableReadback,
+                                                                    this->policy.framesInFlight);
+      renderTarget = offscreenTarget.get();
+      createCommandBuffers();
+      gpuTimer = std::make_unique<Graphics::GpuTimer>(vulkanDevice, policy.framesInFlight);
     }
 
     // Rederer can be destroyed but Engine will continue so command buffers need freed
-    Renderer::~Renderer() { freeCommandBuffers(); }
+    Renderer::~Renderer()
+    {
+      // Shutdown is the one place a full stall is fine, every deferred release can then run
+      vkDeviceWaitIdle(vulkanDevice.device());
+      vulkanDevice.deletionQueue().flush();
+      freeCommandBuffers();
+    }
 
-    void Renderer::recreateSwapChain()
+    bool Renderer::recreateSwapChain()
     {
-      auto extent = vulkanWindow.getExtent();
-      while(extent.width == 0 || extent.height == 0)
+      assert(!isHeadless() && "Offscreen targets never need to be recreated");
+
+      // A minimized window has no area to present to, so the frame is skipped until it gets one back
+      auto extent = vulkanWindow->getExtent();
+      if(extent.width == 0 || extent.height == 0)
         {
-          extent = vulkanWindow.getExtent();
-          glfwWaitEvents();
+          swapChainOutOfDate = true;
+          return false;
         }
-      vkDeviceWaitIdle(vulkanDevice.device());
+      swapChainOutOfDate = false;
 
-      if(swapChain == nullptr) { swapChain = std::make_unique<Graphics::SwapChain>(vulkanDevice, extent); }
-      else
+      if(swapChain == nullptr)
         {
-          std::shared_ptr<Graphics::SwapChain> oldSwapChain = std::move(swapChain);
-          swapChain = std::make_unique<Graphics::SwapChain>(vulkanDevice, extent, oldSwapChain);
-          if(!oldSwapChain->compareSwapFormats(*swapChain.get()))
+          swapChain = std::make_unique<Graphics::SwapChain>(vulkanDevice, extent, policy);
+          renderTarget = swapChain.get();
+          return true;
+        }
+
+      std::shared_ptr<Graphics::SwapChain> oldSwapChain = std::move(swapChain);
+      swapChain = std::make_unique<Graphics::SwapChain>(vulkanDevice, extent, policy, oldSwapChain);
+      renderTarget = swapChain.get();
+      bool formatsChanged = !oldSwapChain->compareSwapFormats(*swapChain);
+
+      // No vkDeviceWaitIdle: frames already submitted still render into the old images, depth buffers and
+      // framebuffers, so those are destroyed once the graphics timeline says the GPU is done with them
+      deferRelease([retired = std::move(oldSwapChain)]() mutable { retired.reset(); });
+
+      if(formatsChanged)
+        {
+          // The new swap chain is already in place, so without a callback rendering goes on with the new pass and
+          // only pipelines built against the old one need attention
+          if(renderPassChanged) { renderPassChanged(swapChain->getRenderPass(), swapChain->getRenderPassFormats()); }
+          else
             {
-              throw std::runtime_error("Swap chain image(or depth) format has changed!");
-              /* Apparently it might be better to setup a callback function notifying the app that a new incompatable
-               * renderpass has been created
-               */
+              std::cerr << "renderer: swap chain formats changed, continuing with the new render pass" << std::endl;
             }
         }
+      return true;
     }
 
-    void Renderer::createCommandBuffers()
+    Graphics::PresentationPolicy Renderer::validatePolicy(const Graphics::PresentationPolicy& policy)
     {
-      commandBuffers.resize(Graphics::SwapChain::MAX_FRAMES_IN_FLIGHT);
+      if(policy.framesInFlight == 0 || policy.framesInFlight > Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT)
+        {
+          throw std::invalid_argument("frames in flight must be between 1 and " +
+                                      std::to_string(Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT));
+        }
+      return policy;
+    }
 
-      VkCommandBufferAllocateInfo allocInfo{};
-      allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-      allocInfo.commandPool = vulkanDevice.getCommandPool();
-      allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    void Renderer::createCommandBuffers()
+    {
+      // One pool per thread that can record, indexed the way JobSystem::currentThreadIndex numbers them
+      commandPools =
+        std::make_unique<Graphics::FrameCommandPools>(vulkanDevice, Core::JobSystem::get().threadCount());
 
-      if(vkAllocateCommandBuffers(vulkanDevice.device(), &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+      commandBuffers.resize(Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT);
+      for(int i = 0; i < Graphics::RenderTarget::MAX_FRAMES_IN_FLIGHT; i++)
         {
-          throw std::runtime_error("failed to allocate command buffers!");
+          commandBuffers[i] = commandPools->getPrimary(i);
         }
     }
 
     void Renderer::freeCommandBuffers()
     {
-      vkFreeCommandBuffers(vulkanDevice.device(), vulkanDevice.getCommandPool(),
-                           static_cast<float>(commandBuffers.size()), commandBuffers.data());
+      // The primaries belong to the pools and go with them
       commandBuffers.clear();
+      commandPools.reset();
     }
 
     VkCommandBuffer Renderer::beginFrame()
     {
       assert(!isFrameStarted && "Can't call beginFrame while beginFrame is already in progress");
+      PROFILE_SCOPE("Renderer::beginFrame");
+
+      // Put off while minimized, nothing is drawn until the window is restored
+      if(swapChainOutOfDate && !recreateSwapChain()) { return nullptr; }
+
+      VkResult result;
+      {
+        PROFILE_SCOPE("Renderer::acquireNextImage");
+        result = renderTarget->acquireNextImage(&currentImageIndex);
+      }
 
-      auto result = swapChain->acquireNextImage(&currentImageIndex);
+      // The failed acquire left the semaphore unsignaled and the slot's last frame waited on, so the frame goes
+      // ahead on the new swap chain instead of being dropped
+      if(result == VK_ERROR_OUT_OF_DATE_KHR && recreateSwapChain())
+        {
+          PROFILE_SCOPE("Renderer::acquireNextImage");
+          result = renderTarget->acquireNextImage(&currentImageIndex);
+        }
 
-      // If window is resized check if compatible with swapchain. If not then recreate swapchain
       if(result == VK_ERROR_OUT_OF_DATE_KHR)
         {
-          recreateSwapChain();
+          swapChainOutOfDate = true;
           return nullptr; // Frame has not successfully started
         }
 
@@ -87,6 +154,15 @@ namespace GameEngine
 
       isFrameStarted = true;
 
+      // Acquiring just waited for this slot's last frame, one query covers it and whatever finished since
+      vulkanDevice.deletionQueue().collect(vulkanDevice.graphicsTimeline().getCompleted());
+
+      // If the previous frame is still executing we are recording this one in parallel with it
+      if(submittedFrameCount > 0 && renderTarget->isPreviousFrameInFlight()) { overlappedFrames++; }
+
+      // Nothing recorded from this slot's pools is in use anymore, so they are recycled in one call each
+      commandPools->reset(currentFrameIndex);
+
       // Begin command Buffer
       auto commandBuffer = getCurrentCommandBuffer();
       VkCommandBufferBeginInfo beginInfo{};
@@ -96,44 +172,113 @@ namespace GameEngine
         {
           throw std::runtime_error("failed to begin recording command buffer!");
         }
+
+      // The slot's last frame was waited on by acquireNextImage so its previous timestamps are ready to read
+      gpuTimer->beginFrame(commandBuffer, currentFrameIndex);
+      frameScope = gpuTimer->beginScope(commandBuffer, "GPU frame");
       return commandBuffer;
     };
 
     void Renderer::endFrame()
     {
       assert(isFrameStarted && "Can't call endFrame when frame is not in progress");
+      PROFILE_SCOPE("Renderer::endFrame");
+
       auto commandBuffer = getCurrentCommandBuffer();
+      gpuTimer->endScope(commandBuffer, frameScope);
       if(vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         {
           throw std::runtime_error("Failes to record command buffer");
         }
 
-      auto result = swapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+      // Uploads queued since the last frame go first so queue order makes them visible to this frame
+      vulkanDevice.stagingRing().flush();
+
+      VkResult result;
+      {
+        PROFILE_SCOPE("Renderer::submit");
+        result = renderTarget->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+      }
+
+      isFrameStarted = false;
+      submittedFrameCount++;
+      vulkanDevice.deletionQueue().endFrame(vulkanDevice.graphicsTimeline().getLastSubmitted());
+      currentFrameIndex = (currentFrameIndex + 1) % policy.framesInFlight;
+
+      auto frameEnd = std::chrono::steady_clock::now();
+      if(inputSampleTime != std::chrono::steady_clock::time_point{})
+        {
+          double latencyMs = std::chrono::duration<double, std::milli>(frameEnd - inputSampleTime).count();
+          statsAccumulator.avgInputLatencyMs += latencyMs;
+          statsAccumulator.maxInputLatencyMs = std::max(statsAccumulator.maxInputLatencyMs, latencyMs);
+          inputLatencySamples++;
+          inputSampleTime = {};
+        }
+      if(lastFrameEnd != std::chrono::steady_clock::time_point{})
+        {
+          double frameMs = std::chrono::duration<double, std::milli>(frameEnd - lastFrameEnd).count();
+          double waitMs = renderTarget->getFenceWaitMs();
+          statsAccumulator.frameCount++;
+          statsAccumulator.avgFrameMs += frameMs;
+          statsAccumulator.avgFenceWaitMs += waitMs;
+          statsAccumulator.avgCpuMs += frameMs - waitMs;
+        }
+      lastFrameEnd = frameEnd;
+
       // A swapchain no longer matches the surface(device) exactly but can still be used to present surface
-      if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || vulkanWindow.wasVulkanWindowResized())
+      if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+         (vulkanWindow != nullptr && vulkanWindow->wasVulkanWindowResized()))
         {
-          vulkanWindow.resetVulkanWindowResizedFlag();
+          vulkanWindow->resetVulkanWindowResizedFlag();
           recreateSwapChain();
         }
       else if(result != VK_SUCCESS) { throw std::runtime_error("failed to present swap chain image!"); }
-
-      isFrameStarted = false;
-      currentFrameIndex = (currentImageIndex + 1) % Graphics::SwapChain::MAX_FRAMES_IN_FLIGHT;
     };
 
-    void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer)
+    void Renderer::deferRelease(std::function<void()> release)
+    {
+      vulkanDevice.deletionQueue().release(std::move(release));
+    }
+
+    FrameStats Renderer::consumeFrameStats()
+    {
+      FrameStats stats = statsAccumulator;
+      if(stats.frameCount > 0)
+        {
+          stats.avgFrameMs /= stats.frameCount;
+          stats.avgCpuMs /= stats.frameCount;
+          stats.avgFenceWaitMs /= stats.frameCount;
+          stats.overlapRatio = static_cast<float>(overlappedFrames) / static_cast<float>(stats.frameCount);
+        }
+      if(inputLatencySamples > 0) { stats.avgInputLatencyMs /= inputLatencySamples; }
+
+      statsAccumulator = {};
+      overlappedFrames = 0;
+      inputLatencySamples = 0;
+      return stats;
+    }
+
+    bool Renderer::readbackLastFrame(std::vector<uint8_t>& pixels)
+    {
+      if(offscreenTarget == nullptr) { return false; }
+      return offscreenTarget->readbackLastFrame(pixels);
+    }
+
+    void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
     {
       assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
       assert(commandBuffer == getCurrentCommandBuffer() &&
              "Can't begine render pass on command buffer from a different frame");
 
+      mainPassScope = gpuTimer->beginScope(commandBuffer, "Main pass");
+
       VkRenderPassBeginInfo renderPassInfo{};
       renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-      renderPassInfo.renderPass = swapChain->getRenderPass();
-      renderPassInfo.framebuffer = swapChain->getFrameBuffer(currentImageIndex);
+      renderPassInfo.renderPass = renderTarget->getRenderPass();
+      renderPassInfo.framebuffer = renderTarget->getFrameBuffer(currentImageIndex);
 
       renderPassInfo.renderArea.offset = {0, 0};
-      renderPassInfo.renderArea.extent = swapChain->getSwapChainExtent();
+      renderPassInfo.renderArea.extent = renderTarget->getSwapChainExtent();
 
       std::array<VkClearValue, 2> clearValues{};
       clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
@@ -141,20 +286,54 @@ namespace GameEngine
       renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
       renderPassInfo.pClearValues = clearValues.data();
 
-      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+      vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+      // Dynamic state is not inherited by secondary command buffers, those set their own
+      if(contents == VK_SUBPASS_CONTENTS_INLINE) { setViewportAndScissor(commandBuffer); }
+    };
 
+    VkCommandBuffer Renderer::beginSecondaryCommandBuffer()
+    {
+      assert(isFrameStarted && "Can't begin a secondary command buffer if frame is not in progress");
+
+      VkCommandBuffer commandBuffer =
+        commandPools->acquireSecondary(currentFrameIndex, Core::JobSystem::get().currentThreadIndex());
+
+      VkCommandBufferInheritanceInfo inheritanceInfo{};
+      inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+      inheritanceInfo.renderPass = renderTarget->getRenderPass();
+      inheritanceInfo.subpass = 0;
+      inheritanceInfo.framebuffer = renderTarget->getFrameBuffer(currentImageIndex);
+
+      VkCommandBufferBeginInfo beginInfo{};
+      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+      if(vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        {
+          throw std::runtime_error("failed to begin recording secondary command buffer!");
+        }
+
+      setViewportAndScissor(commandBuffer);
+      return commandBuffer;
+    }
+
+    void Renderer::setViewportAndScissor(VkCommandBuffer commandBuffer) const
+    {
       // Setup viewport scissor with swapchain dimensions
       VkViewport viewport{};
       viewport.x = 0.0f;
       viewport.y = 0.0f;
-      viewport.width = static_cast<float>(swapChain->getSwapChainExtent().width);
-      viewport.height = static_cast<float>(swapChain->getSwapChainExtent().height);
+      viewport.width = static_cast<float>(renderTarget->getSwapChainExtent().width);
+      viewport.height = static_cast<float>(renderTarget->getSwapChainExtent().height);
       viewport.minDepth = 0.0f;
       viewport.maxDepth = 1.0f;
-      VkRect2D scissor{{0, 0}, swapChain->getSwapChainExtent()};
+      VkRect2D scissor{{0, 0}, renderTarget->getSwapChainExtent()};
       vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
       vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-    };
+    }
+
     void Renderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer)
     {
       assert(isFrameStarted && "Can't call endSwapChainRenderPass if frame is not in progress");
@@ -163,6 +342,7 @@ namespace GameEngine
 
       // Finish recording
       vkCmdEndRenderPass(commandBuffer);
+      gpuTimer->endScope(commandBuffer, mainPassScope);
     };
 
   } // namespace Renderer
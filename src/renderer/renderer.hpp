@@ -2,29 +2,88 @@
 
 #include "../platform/Window.hpp"
 #include "../graphics/vulkan_device.hpp"
+#include "../graphics/frame_command_pools.hpp"
+#include "../graphics/gpu_timer.hpp"
+#include "../graphics/offscreen_target.hpp"
+#include "../graphics/presentation_policy.hpp"
 #include "../graphics/swap_chain.hpp"
 
 // std
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <vector>
-#include <cassert>
 
 namespace GameEngine
 {
   namespace Renderer
   {
+    /**
+     * @brief Frame pacing statistics accumulated between two calls to Renderer::consumeFrameStats.
+     */
+    struct FrameStats
+    {
+      uint32_t frameCount = 0;
+      double avgFrameMs = 0.0;     ///< Wall time between consecutive endFrame calls.
+      double avgCpuMs = 0.0;       ///< Frame time minus the time spent blocked waiting for a frame slot.
+      double avgFenceWaitMs = 0.0; ///< Time the CPU was stalled waiting on the GPU.
+      float overlapRatio = 0.0f;   ///< Fraction of frames recorded while the previous frame was still on the GPU.
+
+      /// From the input sample marked with Renderer::markInputSampled to the frame being queued for present. A lower
+      /// bound of what the user sees, the frames already queued and scan out come on top. 0 without input samples.
+      double avgInputLatencyMs = 0.0;
+      double maxInputLatencyMs = 0.0;
+    };
+
     class Renderer
     {
     public:
-      Renderer(Platform::VulkanWindow& window, Graphics::VulkanDevice& device);
+      /**
+       * @brief Called when a recreated swap chain needed a new render pass because its formats changed.
+       *
+       * Pipelines built against the previous pass are no longer compatible and must be rebuilt for the new one.
+       */
+      using RenderPassChangedCallback = std::function<void(VkRenderPass, Graphics::RenderPassFormats)>;
+
+      /**
+       * @throws std::invalid_argument if policy.framesInFlight is 0 or above RenderTarget::MAX_FRAMES_IN_FLIGHT.
+       */
+      Renderer(Platform::VulkanWindow& window, Graphics::VulkanDevice& device,
+               const Graphics::PresentationPolicy& policy = {});
+
+      /**
+       * @brief Creates a headless renderer that draws into an OffscreenTarget instead of a swap chain.
+       * @param device Device created without a window.
+       * @param extent Size of the offscreen images.
+       * @param enableReadback Keep a host copy of every frame so readbackLastFrame can be used.
+       * @param policy Only framesInFlight applies, nothing is presented.
+       */
+      Renderer(Graphics::VulkanDevice& device, VkExtent2D extent, bool enableReadback,
+               const Graphics::PresentationPolicy& policy = {});
       ~Renderer();
 
       // Copy constructors (Because the app is now managing vulkan objects we need to delete copy constructors)
       Renderer(const Platform::VulkanWindow&) = delete;
       Renderer& operator=(const Renderer&) = delete;
 
-      VkRenderPass getSwapChainRenderPass() const { return swapChain->getRenderPass(); };
+      VkRenderPass getSwapChainRenderPass() const { return renderTarget->getRenderPass(); };
+      Graphics::RenderPassFormats getSwapChainRenderPassFormats() const { return renderTarget->getRenderPassFormats(); }
+      VkExtent2D getExtent() const { return renderTarget->getSwapChainExtent(); }
       bool isFrameInProgress() const { return isFrameStarted; };
+      bool isHeadless() const { return vulkanWindow == nullptr; }
+      uint32_t getFramesInFlight() const { return policy.framesInFlight; }
+      size_t getImageCount() const { return renderTarget->imageCount(); }
+
+      /**
+       * @brief Present mode the swap chain ended up with, which may differ from the one the policy asked for.
+       */
+      VkPresentModeKHR getPresentMode() const
+      {
+        assert(!isHeadless() && "Headless renderers do not present");
+        return swapChain->getPresentMode();
+      }
 
       VkCommandBuffer getCurrentCommandBuffer() const
       {
@@ -35,28 +94,107 @@ namespace GameEngine
       int getFrameIndex() const
       {
         assert(isFrameStarted && " Cannot get frame index when frame is not in progress");
-        return currentImageIndex;
+        return currentFrameIndex;
       }
 
+      /**
+       * @brief Acquires the next image and begins the frame's primary command buffer.
+       * @return nullptr when there is nothing to draw into, while the window is minimized.
+       */
       VkCommandBuffer beginFrame();
       void endFrame();
-      void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+
+      /**
+       * @brief Begins the main render pass on the frame's primary command buffer.
+       * @param contents SECONDARY_COMMAND_BUFFERS (the default) when the pass is recorded into secondary command
+       * buffers from beginSecondaryCommandBuffer, INLINE to record straight into the primary.
+       */
+      void beginSwapChainRenderPass(VkCommandBuffer commandBuffer,
+                                    VkSubpassContents contents = VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
       void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+      /**
+       * @brief Begins a secondary command buffer that continues the main render pass, with viewport and scissor set.
+       *
+       * Safe to call from any JobSystem::get() thread while a frame is in progress, each thread allocates from its own
+       * per frame pool. End it with vkEndCommandBuffer and hand it to vkCmdExecuteCommands on the primary.
+       */
+      VkCommandBuffer beginSecondaryCommandBuffer();
+
+      /**
+       * @brief Defers a release until the GPU has finished every frame that could still reference the resource.
+       *
+       * Shorthand for the device's DeletionQueue, which also takes buffers, images and pipelines directly. The
+       * release is tagged with the next frame to be submitted and runs once the graphics timeline has passed that
+       * frame, so resources can be dropped mid-frame without a vkDeviceWaitIdle.
+       * @param release Callback destroying the resource.
+       */
+      void deferRelease(std::function<void()> release);
+
+      /**
+       * @brief Records when input for the next frame was sampled, its input to present latency is measured from here.
+       */
+      void markInputSampled() { inputSampleTime = std::chrono::steady_clock::now(); }
+
+      /**
+       * @brief Sets the callback run when the swap chain's formats change. Without one the change is only logged.
+       */
+      void setRenderPassChangedCallback(RenderPassChangedCallback callback) { renderPassChanged = std::move(callback); }
+
+      /**
+       * @brief Returns the frame statistics gathered since the previous call and resets the accumulators.
+       */
+      FrameStats consumeFrameStats();
+
+      /**
+       * @brief Reads back the last submitted frame of a headless renderer as tightly packed RGBA8 pixels.
+       * @return false when rendering to a window or when readback was not enabled.
+       */
+      bool readbackLastFrame(std::vector<uint8_t>& pixels);
+
     private:
       void createCommandBuffers();
       void freeCommandBuffers();
-      void recreateSwapChain();
+      /**
+       * @brief Replaces the swap chain without waiting on the GPU, the old one is retired through deferRelease.
+       * @return false if the window is minimized, the swap chain is then left as it is and marked out of date.
+       */
+      bool recreateSwapChain();
+      void setViewportAndScissor(VkCommandBuffer commandBuffer) const;
+      static Graphics::PresentationPolicy validatePolicy(const Graphics::PresentationPolicy& policy);
 
-      Platform::VulkanWindow& vulkanWindow;
+      Platform::VulkanWindow* vulkanWindow; // nullptr when rendering headless
       Graphics::VulkanDevice& vulkanDevice;
+      Graphics::PresentationPolicy policy;
 
+      // Exactly one of these exists, renderTarget points at whichever one it is
       std::unique_ptr<Graphics::SwapChain> swapChain;
+      std::unique_ptr<Graphics::OffscreenTarget> offscreenTarget;
+      Graphics::RenderTarget* renderTarget = nullptr;
+      bool swapChainOutOfDate = false; // Recreation was put off while the window was minimized
+      RenderPassChangedCallback renderPassChanged;
+
+      // GPU timestamps for the whole frame and the main render pass
+      std::unique_ptr<Graphics::GpuTimer> gpuTimer;
+      uint32_t frameScope = Graphics::GpuTimer::INVALID_SCOPE;
+      uint32_t mainPassScope = Graphics::GpuTimer::INVALID_SCOPE;
+
+      // Per frame, per thread pools reset once a frame. commandBuffers holds each slot's primary
+      std::unique_ptr<Graphics::FrameCommandPools> commandPools;
       std::vector<VkCommandBuffer> commandBuffers;
 
       uint32_t currentImageIndex;
-      int currentFrameIndex = 0; // Keep track of frames from 0 to MAX_FRAMES_IN_FLIGHT
+      int currentFrameIndex = 0; // Keep track of frames from 0 to policy.framesInFlight
       bool isFrameStarted = false;
+
+      uint64_t submittedFrameCount = 0; // Monotonic count of frames handed to the GPU
+
+      // Frame pacing accumulators, reset by consumeFrameStats()
+      std::chrono::steady_clock::time_point lastFrameEnd{};
+      FrameStats statsAccumulator{};
+      uint32_t overlappedFrames = 0;
+      std::chrono::steady_clock::time_point inputSampleTime{}; // Cleared once the frame using it is presented
+      uint32_t inputLatencySamples = 0;
     };
 
   } // namespace Renderer